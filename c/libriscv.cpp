@@ -32,6 +32,8 @@ struct UserData {
 	uint64_t arena_total_size = 0;
 	size_t max_owned_pages = 0;
 	size_t owned_page_count = 0;
+	// The arena of a fork as it was created, restored on every reset
+	std::unique_ptr<Arena> fork_arena;
 };
 
 static void setup_printer(Machine<RISCV_ARCH>* m)
@@ -91,6 +93,17 @@ static ParentPageInfo get_parent_page_readonly(
 	return {Page::cow_page().m_page.get(), Page::cow_page().attr};
 }
 
+// Install a page that refers to a fork's own private (copy-on-write) arena view,
+// with the same attributes as the parent page.
+static Page& install_private_arena_page(
+	Memory<RISCV_ARCH>& mem, const UserData& ud, uint64_t pageno)
+{
+	auto info = get_parent_page_readonly(*ud.fork_parent, pageno);
+	info.attr.is_cow = false;
+	auto* arena = static_cast<PageData*>(mem.memory_arena_ptr());
+	return mem.allocate_page(pageno, info.attr, &arena[pageno]);
+}
+
 extern "C"
 void libriscv_set_defaults(RISCVOptions *options)
 {
@@ -111,6 +124,7 @@ void libriscv_set_defaults(RISCVOptions *options)
 	options->protect_segments = mo.protect_segments ? 1 : 0;
 	options->native_syscall_base = 0;
 	options->arena_size = 8ULL << 20;
+	options->forkable_memory_arena = mo.use_forkable_memory_arena ? 1 : 0;
 }
 
 extern "C"
@@ -122,6 +136,7 @@ RISCVMachine *libriscv_new(const void *elf_prog, unsigned elf_length, const RISC
 		.load_program = (bool)options->load_program,
 		.protect_segments = (bool)options->protect_segments,
 		.use_memory_arena = (bool)options->use_memory_arena,
+		.use_forkable_memory_arena = (bool)options->forkable_memory_arena,
 		.use_shared_execute_segments = (bool)options->use_shared_execute_segments,
 		.default_exit_function = "fast_exit",
 	};
@@ -533,6 +548,34 @@ int libriscv_load_binary_file(const char *filename, char **data)
 
 /*** Fast-fork API ***/
 
+static void setup_fork_arena(Machine<RISCV_ARCH>* m, const Machine<RISCV_ARCH>* pm)
+{
+	if (pm->has_arena()) {
+		const auto& parent_ud = *pm->template get_userdata<UserData>();
+		const auto watermark = pm->arena().high_watermark();
+		const auto arena_base = pm->memory.heap_address();
+		const auto total_size = parent_ud.arena_total_size;
+		const auto syscall_base = parent_ud.arena_syscall_base;
+		if (total_size > 0 && syscall_base > 0) {
+			const auto remaining = total_size - (watermark - arena_base);
+			m->setup_native_heap(syscall_base, watermark, remaining);
+
+			// Chunks below the watermark belong to the parent
+			m->arena().on_unknown_free(
+				[](auto, auto*) -> int { return 0; });
+
+			const Arena* src_arena = &pm->arena();
+			m->arena().on_unknown_realloc(
+				[src_arena, m](auto ptr, auto newsize) -> Arena::ReallocResult {
+					const size_t old_len = src_arena->size(ptr);
+					const auto new_ptr = m->arena().malloc(newsize);
+					return {new_ptr, old_len};
+				});
+			USERDATA(m).fork_arena.reset(new Arena(m->arena()));
+		}
+	}
+}
+
 extern "C"
 RISCVMachine *libriscv_fast_fork(const RISCVMachine *parent, RISCVOptions *opts)
 {
@@ -541,14 +584,16 @@ RISCVMachine *libriscv_fast_fork(const RISCVMachine *parent, RISCVOptions *opts)
 	try {
 		const uint64_t fork_memory_max = (opts && opts->max_memory > 0)
 			? opts->max_memory : pm->memory.memory_arena_size();
+		// A memfd-backed parent arena can be mapped privately (copy-on-write)
+		const bool cow_arena = pm->memory.uses_forkable_memory_arena();
 		auto* m = new Machine<RISCV_ARCH>(*pm, MachineOptions<RISCV_ARCH>{
 			.memory_max = fork_memory_max,
 			.minimal_fork = true,
-			.use_memory_arena = false,
+			.use_memory_arena = cow_arena,
 			.default_exit_function = "fast_exit",
 #ifdef RISCV_BINARY_TRANSLATION
 			.translate_enabled = true,
-			.translation_use_arena = false,
+			.translation_use_arena = cow_arena,
 #endif
 		});
 
@@ -567,6 +612,10 @@ RISCVMachine *libriscv_fast_fork(const RISCVMachine *parent, RISCVOptions *opts)
 		m->memory.set_page_fault_handler(
 			[](auto& mem, size_t pageno, bool init) -> Page& {
 				auto& ud = USERDATA((&mem.machine()));
+				// Pages inside a private arena view are already copy-on-write
+				if (mem.has_private_arena_mapping()
+					&& pageno < mem.memory_arena_size() / Page::size())
+					return install_private_arena_page(mem, ud, pageno);
 				if (ud.max_owned_pages > 0
 					&& ud.owned_page_count >= ud.max_owned_pages)
 					throw MachineException(OUT_OF_MEMORY,
@@ -580,6 +629,10 @@ RISCVMachine *libriscv_fast_fork(const RISCVMachine *parent, RISCVOptions *opts)
 		m->memory.set_page_readf_handler(
 			[](const Memory<RISCV_ARCH>& mem, auto pageno) -> const Page& {
 				auto* ud = mem.machine().template get_userdata<UserData>();
+				if (mem.has_private_arena_mapping()
+					&& pageno < mem.memory_arena_size() / Page::size())
+					return install_private_arena_page(
+						const_cast<Memory<RISCV_ARCH>&>(mem), *ud, pageno);
 				auto info = get_parent_page_readonly(*ud->fork_parent, pageno);
 				info.attr.non_owning = true;
 				info.attr.is_cow = info.attr.write;
@@ -601,36 +654,7 @@ RISCVMachine *libriscv_fast_fork(const RISCVMachine *parent, RISCVOptions *opts)
 			});
 
 		// Set up arena at parent's high watermark
-		if (pm->has_arena()) {
-			const auto& parent_ud = *pm->template get_userdata<UserData>();
-			const auto watermark = pm->arena().high_watermark();
-			const auto arena_base = pm->memory.heap_address();
-			const auto total_size = parent_ud.arena_total_size;
-			const auto syscall_base = parent_ud.arena_syscall_base;
-			if (total_size > 0 && syscall_base > 0) {
-				const auto remaining = total_size - (watermark - arena_base);
-				m->setup_native_heap(syscall_base, watermark, remaining);
-
-				m->arena().on_unknown_free(
-					[](auto, auto*) -> int { return 0; });
-
-				const Arena* src_arena = &pm->arena();
-				m->arena().on_unknown_realloc(
-					[src_arena](auto ptr, auto newsize) -> Arena::ReallocResult {
-						const size_t old_len = src_arena->size(ptr);
-						return {0, old_len}; // Caller must malloc separately
-					});
-				// Fix: the on_unknown_realloc needs access to the fork's arena
-				// Re-install with a lambda that captures the fork machine
-				auto* fork_machine = m;
-				m->arena().on_unknown_realloc(
-					[src_arena, fork_machine](auto ptr, auto newsize) -> Arena::ReallocResult {
-						const size_t old_len = src_arena->size(ptr);
-						const auto new_ptr = fork_machine->arena().malloc(newsize);
-						return {new_ptr, old_len};
-					});
-			}
-		}
+		setup_fork_arena(m, pm);
 
 		return (RISCVMachine *)m;
 	}
@@ -650,6 +674,33 @@ RISCVMachine *libriscv_fast_fork(const RISCVMachine *parent, RISCVOptions *opts)
 	}
 }
 
+extern "C"
+int libriscv_reset_to(RISCVMachine *m, const RISCVMachine *parent)
+{
+	auto* machine = MACHINE(m);
+	auto* pm = CONST_MACHINE(parent);
+	try {
+		// Keep the (aligned) initial stack of the fork
+		const auto stack_initial = machine->memory.stack_initial();
+		machine->reset_to(*pm);
+		machine->memory.set_stack_initial(stack_initial);
+
+		// Pages written by the fork have been dropped again
+		auto& ud = USERDATA(machine);
+		ud.owned_page_count = machine->memory.owned_pages_active();
+		// Start over from the arena of the fork, not that of the parent
+		if (ud.fork_arena)
+			ud.fork_arena->transfer(machine->arena());
+		return 0;
+	} catch (const MachineException& me) {
+		ERROR_CALLBACK(machine, RISCV_ERROR_TYPE_MACHINE_EXCEPTION, me.what(), me.data());
+		return RISCV_ERROR_TYPE_MACHINE_EXCEPTION;
+	} catch (const std::exception& e) {
+		ERROR_CALLBACK(machine, RISCV_ERROR_TYPE_GENERAL_EXCEPTION, e.what(), 0);
+		return RISCV_ERROR_TYPE_GENERAL_EXCEPTION;
+	}
+}
+
 extern "C"
 int libriscv_is_forked(const RISCVMachine *m)
 {
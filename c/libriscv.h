@@ -40,6 +40,7 @@ typedef struct {
 	int      protect_segments;            /* Apply ELF segment protections (default: 1) */
 	unsigned native_syscall_base;         /* If non-zero, install native heap+memory syscalls at this base (needs 10 slots) */
 	uint64_t arena_size;                  /* Arena size in bytes (default: 8 MiB, ignored if native_syscall_base == 0) */
+	int      forkable_memory_arena;       /* Back memory arena with a memfd, giving fast forks a private CoW arena (Linux, default: 0) */
 } RISCVOptions;
 
 /* Fill out default values. */
@@ -194,9 +195,18 @@ typedef struct {
 
 /* Create a fast fork of a parent machine. Installs default CoW page handlers and
    arena at the parent's high watermark. The parent must outlive all its forks.
+   When the parent was created with forkable_memory_arena, the fork maps a private
+   copy-on-write view of the parent's memory arena instead of paging it in.
    Uses opts only for error, stdout, and opaque. Returns NULL on failure. */
 LIBRISCVAPI RISCVMachine *libriscv_fast_fork(const RISCVMachine *parent, RISCVOptions *opts);
 
+/* Reset a fork back to the state of its parent, so that it can be reused for
+   another request instead of creating a new fork. Only the pages the fork has
+   touched are rolled back, together with registers, heap and mmap state.
+   The parent must not have been modified since the fork was created.
+   Returns 0 on success, or a RISCV_ERROR_TYPE_* code on failure. */
+LIBRISCVAPI int libriscv_reset_to(RISCVMachine *m, const RISCVMachine *parent);
+
 /* Returns non-zero if the machine is a fork. */
 LIBRISCVAPI int libriscv_is_forked(const RISCVMachine *m);
 
@@ -42,6 +42,8 @@ function usage()
      --no-tailcall-dispatch disable tailcall dispatch
      -b, --bintr          enable binary translation using system compiler
      --no-bintr           disable binary translation
+     --block-profile      enable recording block profiles (-H) for translation
+     --no-block-profile   disable recording block profiles
      -t, --jit            jit-compile using tcc
      --no-jit             disable jit-compile using tcc
      -x, --expr           enable experimental features (eg. unbounded 32-bit addressing)
@@ -93,6 +95,8 @@ while [[ "$#" -gt 0 ]]; do
 		--no-tailcall-dispatch) OPTS="$OPTS -DRISCV_TAILCALL_DISPATCH=OFF" ;;
         -b|--bintr) OPTS="$OPTS -DRISCV_BINARY_TRANSLATION=ON -DRISCV_LIBTCC=OFF" ;;
 		--no-bintr) OPTS="$OPTS -DRISCV_BINARY_TRANSLATION=OFF" ;;
+		--block-profile) OPTS="$OPTS -DRISCV_BLOCK_PROFILE=ON" ;;
+		--no-block-profile) OPTS="$OPTS -DRISCV_BLOCK_PROFILE=OFF" ;;
 		--jit|--tcc  ) OPTS="$OPTS -DRISCV_BINARY_TRANSLATION=ON -DRISCV_LIBTCC=ON" ;;
 		--no-jit|--no-tcc) OPTS="$OPTS -DRISCV_LIBTCC=OFF" ;;
         -x|--expr ) OPTS="$OPTS -DRISCV_EXPERIMENTAL=ON -DRISCV_ENCOMPASSING_ARENA=ON" ;;
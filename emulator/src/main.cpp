@@ -37,13 +37,18 @@ struct Arguments {
 	bool execute_only = false;
 	bool ignore_text = false;
 	bool background = riscv::libtcc_enabled; // Run binary translation in background thread
+	bool tiered = false; // Recompile libtcc translations with the system compiler in background
+	bool native = false; // Emit x86-64 machine code directly instead of compiling C
+	bool guard_arena = false; // Mask translated loads into a guard-paged arena (64-bit)
 	bool proxy_mode = false;  // Proxy mode for system calls
+	bool pair_stats = false;  // Print instruction pair frequencies and quit
 	uint64_t fuel = 30'000'000'000ULL; // Default: Timeout after ~30bn instructions
 	uint64_t max_memory = 0;
 	std::vector<std::string> allowed_files;
 	std::string output_file;
 	std::string call_function;
 	std::string jump_hints_file;
+	std::string block_profile_file;
 };
 
 #ifdef HAVE_GETOPT_LONG
@@ -67,8 +72,13 @@ static const struct option long_options[] = {
 	{"translate-regcache", no_argument, 0, 'R'},
 	{"no-translate-regcache", no_argument, 0, 1000},
 	{"jump-hints", required_argument, 0, 'J'},
+	{"block-profile", required_argument, 0, 'H'},
 	{"background", no_argument, 0, 'B'},
 	{"no-background", no_argument, 0, 1001},
+	{"tiered", no_argument, 0, 1003},
+	{"native", no_argument, 0, 1004},
+	{"guard-arena", no_argument, 0, 1005},
+	{"pair-stats", no_argument, 0, 1006},
 	{"mingw", no_argument, 0, 'M'},
 	{"output", required_argument, 0, 'o'},
 	{"from-start", no_argument, 0, 'F'},
@@ -104,8 +114,13 @@ static void print_help(const char* name)
 		"      --no-translate-regcache Disable register caching in binary translator\n"
 		"      --no-virtual   Constrain binary translator to arena (disable virtual paging)\n"
 		"  -J, --jump-hints file  Load jump location hints from file, unless empty then record instead\n"
+		"  -H, --block-profile file  Translate the hottest blocks from a block profile, unless empty then record one (interpreted)\n"
 		"  -B  --background   Run binary translation in background w/live-patching\n"
 		"      --no-background Disable background binary translation\n"
+		"      --tiered       Run libtcc translation first, then swap in system compiler output (implies -B)\n"
+		"      --native       Emit x86-64 machine code in-process instead of compiling C\n"
+		"      --guard-arena  Replace load bounds-checks with a guard-paged arena (64-bit only)\n"
+		"      --pair-stats   Print the most common instruction pairs in the program and quit\n"
 		"  -M, --mingw        Cross-compile for Windows (MinGW)\n"
 		"  -o, --output file  Output embeddable binary translated code (C99)\n"
 		"  -F, --from-start   Start debugger from the beginning (_start)\n"
@@ -164,7 +179,7 @@ static void print_help(const char* name)
 static int parse_arguments(int argc, const char** argv, Arguments& args)
 {
 	int c;
-	while ((c = getopt_long(argc, (char**)argv, "hvQad1f:m:gstTnNRJ:BMo:FSPA:XIc:", long_options, nullptr)) != -1)
+	while ((c = getopt_long(argc, (char**)argv, "hvQad1f:m:gstTnNRJ:H:BMo:FSPA:XIc:", long_options, nullptr)) != -1)
 	{
 		switch (c)
 		{
@@ -183,6 +198,7 @@ static int parse_arguments(int argc, const char** argv, Arguments& args)
 			case 'N': args.translate_future = false; break;
 			case 'R': args.translate_regcache = true; break;
 			case 'J': break;
+			case 'H': break;
 			case 'B': args.background = true; break;
 			case 'M': args.mingw = true; break;
 			case 'o': break;
@@ -195,6 +211,10 @@ static int parse_arguments(int argc, const char** argv, Arguments& args)
 			case 1000: args.translate_regcache = false; break;
 			case 1001: args.background = false; break;
 			case 1002: args.full_virtual = false; break;
+			case 1003: args.tiered = true; args.background = true; break;
+			case 1004: args.native = true; break;
+			case 1005: args.guard_arena = true; break;
+			case 1006: args.pair_stats = true; break;
 			case 'm': // --memory
 				if (optarg) {
 					char* endptr;
@@ -246,6 +266,11 @@ static int parse_arguments(int argc, const char** argv, Arguments& args)
 			if (args.verbose) {
 				printf("* Jump hints file: %s\n", args.jump_hints_file.c_str());
 			}
+		} else if (c == 'H') {
+			args.block_profile_file = optarg;
+			if (args.verbose) {
+				printf("* Block profile file: %s\n", args.block_profile_file.c_str());
+			}
 		}
 	}
 
@@ -282,6 +307,10 @@ static void run_program(
 		cc.push_back(riscv::MachineTranslationEmbeddableCodeOptions{cli_args.output_file});
 	}
 
+	auto block_profile = load_block_profile<W>(cli_args.block_profile_file, cli_args.verbose);
+	// Block profiles are recorded by the interpreter
+	const bool record_block_profile = !cli_args.block_profile_file.empty() && block_profile.empty();
+
 	auto options = std::make_shared<riscv::MachineOptions<W>>(riscv::MachineOptions<W>{
 		.memory_max = cli_args.max_memory ? cli_args.max_memory : MAX_MEMORY,
 		.enforce_exec_only = cli_args.execute_only,
@@ -294,27 +323,32 @@ static void run_program(
 		},
 #endif
 #ifdef RISCV_BINARY_TRANSLATION
-		.translate_enabled = !cli_args.no_translate,
+		.translate_enabled = !cli_args.no_translate && !record_block_profile && !cli_args.pair_stats,
 		.translate_future_segments = cli_args.translate_future,
 		.translate_trace = cli_args.trace,
 		.translate_timing = cli_args.timing,
 		.translate_ignore_instruction_limit = !cli_args.accurate, // Press Ctrl+C to stop
 		.translate_use_register_caching = cli_args.translate_regcache,
 		.translate_automatic_nbit_address_space = false,
+		.translate_guard_paged_arena = cli_args.guard_arena,
 		.translate_use_virtual_paging_fallback = cli_args.full_virtual,
 		.translate_unsafe_remove_checks = cli_args.proxy_mode, // Proxy mode disables sandboxing
 		.record_slowpaths_to_jump_hints = !cli_args.jump_hints_file.empty(),
+		.record_block_profile = record_block_profile,
 #ifdef _WIN32
 		.translation_prefix = "translations/rvbintr-",
 		.translation_suffix = ".dll",
 #else
 		.translator_jump_hints = load_jump_hints<W>(cli_args.jump_hints_file, cli_args.verbose),
+		.translator_block_profile = std::move(block_profile),
 		.translate_background_callback = cli_args.background ?
 			[] (auto& compilation_step) {
 				std::thread([compilation_step = std::move(compilation_step)] {
 					compilation_step();
 				}).detach();
 			} : std::function<void(std::function<void()>&)>(nullptr),
+		.translate_tiered = cli_args.tiered,
+		.translate_native = cli_args.native,
 		.cross_compile = std::move(cc),
 #endif
 #endif
@@ -333,6 +367,15 @@ static void run_program(
 	// operations that need to know the options. This is optional.
 	machine.set_options(std::move(options));
 
+	if (cli_args.pair_stats) { // Superinstruction candidates
+		const auto pairs = machine.memory.gather_instruction_pairs();
+		printf("%-24s %10s %10s\n", "Pair", "Count", "Fused");
+		for (size_t i = 0; i < pairs.size() && i < 40; i++) {
+			printf("%-24s %10u %10u\n",
+				pairs[i].name.c_str(), pairs[i].count, pairs[i].fused);
+		}
+		return;
+	}
 	if (cli_args.quit) { // Quit after instantiating the machine
 		return;
 	}
@@ -666,6 +709,13 @@ static void run_program(
 					jump_hints.size(), cli_args.jump_hints_file.c_str());
 		}
 	}
+	if (machine.options().record_block_profile) {
+		const auto profile = machine.memory.gather_block_profile();
+		store_block_profile<W>(cli_args.block_profile_file, profile);
+		if (cli_args.verbose)
+			printf("%zu profiled blocks were saved to %s\n",
+				profile.size(), cli_args.block_profile_file.c_str());
+	}
 #endif
 }
 
@@ -863,3 +913,42 @@ void store_jump_hints(const std::string& filename, const std::vector<riscv::addr
 		file << "0x" << std::hex << addr << std::endl;
 	}
 }
+
+template <int W>
+std::vector<std::pair<riscv::address_type<W>, uint32_t>> load_block_profile(const std::string& filename, bool verbose)
+{
+	std::vector<std::pair<riscv::address_type<W>, uint32_t>> profile;
+	if (filename.empty())
+		return profile;
+
+	std::ifstream file(filename);
+	if (!file.is_open()) {
+		if (verbose)
+			fprintf(stderr, "Could not open block profile file: %s\n", filename.c_str());
+		return profile;
+	}
+
+	std::string line;
+	while (std::getline(file, line)) {
+		if (line.empty() || line[0] == '#') continue;
+		// Parse hex address and decimal count from line
+		size_t end = 0;
+		const auto addr = std::stoull(line, &end, 16);
+		profile.emplace_back(addr, std::stoul(line.substr(end)));
+	}
+	return profile;
+}
+
+template <int W>
+void store_block_profile(const std::string& filename, const std::vector<std::pair<riscv::address_type<W>, uint32_t>>& profile)
+{
+	std::ofstream file(filename);
+	if (!file.is_open()) {
+		fprintf(stderr, "Could not open block profile file for writing: %s\n", filename.c_str());
+		return;
+	}
+
+	for (auto& entry : profile) {
+		file << "0x" << std::hex << entry.first << std::dec << " " << entry.second << std::endl;
+	}
+}
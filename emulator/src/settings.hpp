@@ -5,6 +5,10 @@ template <int W>
 static std::vector<riscv::address_type<W>> load_jump_hints(const std::string& filename, bool verbose = false);
 template <int W>
 static void store_jump_hints(const std::string& filename, const std::vector<riscv::address_type<W>>& hints);
+template <int W>
+static std::vector<std::pair<riscv::address_type<W>, uint32_t>> load_block_profile(const std::string& filename, bool verbose = false);
+template <int W>
+static void store_block_profile(const std::string& filename, const std::vector<std::pair<riscv::address_type<W>, uint32_t>>& profile);
 
 #if defined(EMULATOR_MODE_LINUX)
 	static constexpr bool full_linux_guest = true;
@@ -238,6 +238,9 @@ int main(int argc, char **argv)
 	master_opts.strict_sandbox     = 1;
 	master_opts.native_syscall_base = NATIVE_SYSCALL_BASE;
 	master_opts.arena_size         = 8ULL << 20; /* 8 MiB heap */
+	/* Back the memory arena with a memfd, so that every fork gets its own
+	   private copy-on-write view of it, keeping direct arena accesses. */
+	master_opts.forkable_memory_arena = 1;
 
 	/* Minimal argv so the Linux CRT starts up correctly. */
 	const char *guest_argv[] = { "handler", NULL };
@@ -0,0 +1,871 @@
+#include "../machine.hpp"
+#include "../decoder_cache.hpp"
+#include "../instruction_list.hpp"
+#include "../internal_common.hpp"
+#include "../safe_instr_loader.hpp"
+#include "../threaded_bytecodes.hpp"
+#include "../tr_types.hpp"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <optional>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#if defined(__x86_64__) && !defined(_WIN32)
+#include <sys/mman.h>
+#endif
+
+// The native backend emits x86-64 machine code for execute segments of
+// 64-bit programs, without going through C and a compiler. Each function
+// starts at a block head (branch target, return address, segment start)
+// and runs straight-line code until a jump or an instruction it does not
+// cover, branching internally when the target is within the same function.
+// Functions use the bintr_block_func ABI, so they are activated just like
+// a shared object, with RV32I_BC_TRANSLATOR entries in the decoder cache.
+
+namespace riscv
+{
+#if defined(__x86_64__) && !defined(_WIN32)
+	static constexpr size_t NATIVE_FUNCTION_MAX_INSTRUCTIONS = 128;
+	static constexpr int NATIVE_CACHED_REGISTERS = 4;
+	static constexpr unsigned NATIVE_CACHED_REGISTER_MIN_USES = 3;
+
+	enum : int { RAX = 0, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11, R12, R13, R14, R15 };
+	enum : uint8_t { CC_B = 0x2, CC_AE = 0x3, CC_E = 0x4, CC_NE = 0x5, CC_L = 0xC, CC_GE = 0xD };
+	enum : int { ALU_ADD = 0, ALU_OR = 1, ALU_AND = 4, ALU_SUB = 5, ALU_XOR = 6, ALU_CMP = 7 };
+	enum : int { SHIFT_SHL = 4, SHIFT_SHR = 5, SHIFT_SAR = 7 };
+
+	// A minimal x86-64 encoder for the instruction forms used by the backend.
+	// Opcodes above 0xFF are two-byte opcodes with a 0x0F escape.
+	struct X86Assembler
+	{
+		std::vector<uint8_t> code;
+
+		size_t size() const noexcept { return code.size(); }
+		void byte(uint8_t b) { code.push_back(b); }
+		void imm32(int32_t v) { append(&v, sizeof(v)); }
+		void imm64(int64_t v) { append(&v, sizeof(v)); }
+		void append(const void* data, size_t len) {
+			auto* p = (const uint8_t *)data;
+			code.insert(code.end(), p, p + len);
+		}
+		void opcode(unsigned op) {
+			if (op > 0xFF) byte(op >> 8);
+			byte(op & 0xFF);
+		}
+		void rex(bool w, int reg, int index, int base) {
+			const uint8_t r = 0x40 | (w << 3) | ((reg >> 3) << 2) | ((index >> 3) << 1) | (base >> 3);
+			if (r != 0x40) byte(r);
+		}
+		// op reg, rm (register-direct)
+		void rr(unsigned op, bool w, int reg, int rm) {
+			rex(w, reg, 0, rm);
+			opcode(op);
+			byte(0xC0 | ((reg & 7) << 3) | (rm & 7));
+		}
+		// op reg, [base + disp]
+		void rm(unsigned op, bool w, int reg, int base, int32_t disp) {
+			rex(w, reg, 0, base);
+			opcode(op);
+			const bool disp8 = disp >= -128 && disp < 128;
+			byte((disp8 ? 0x40 : 0x80) | ((reg & 7) << 3) | (base & 7));
+			if ((base & 7) == RSP) byte(0x24);
+			if (disp8) byte(uint8_t(disp));
+			else imm32(disp);
+		}
+		// op reg, [base + index]
+		void rsib(unsigned op, bool w, int reg, int base, int index) {
+			rex(w, reg, index, base);
+			opcode(op);
+			byte(0x44 | ((reg & 7) << 3));
+			byte(((index & 7) << 3) | (base & 7));
+			byte(0);
+		}
+
+		void mov(int dst, int src) { if (dst != src) rr(0x89, true, src, dst); }
+		void load(int dst, int base, int32_t disp) { rm(0x8B, true, dst, base, disp); }
+		void store(int base, int32_t disp, int src) { rm(0x89, true, src, base, disp); }
+		void mov_imm(int dst, int64_t imm) {
+			if (imm == int32_t(imm)) {
+				rr(0xC7, true, 0, dst);
+				imm32(imm);
+			} else if (uint64_t(imm) <= UINT32_MAX) {
+				rex(false, 0, 0, dst);
+				byte(0xB8 + (dst & 7));
+				imm32(imm);
+			} else {
+				rex(true, 0, 0, dst);
+				byte(0xB8 + (dst & 7));
+				imm64(imm);
+			}
+		}
+		void mov_abs(int dst, uintptr_t imm) {
+			rex(true, 0, 0, dst);
+			byte(0xB8 + (dst & 7));
+			imm64(imm);
+		}
+		void zero(int dst) { rr(0x31, false, dst, dst); }
+		// ALU_* dst, src
+		void alu(int ext, int dst, int src, bool w = true) { rr(0x01 + 8 * ext, w, src, dst); }
+		// ALU_* dst, imm
+		void alu_imm(int ext, int dst, int32_t imm, bool w = true) {
+			if (imm >= -128 && imm < 128) {
+				rr(0x83, w, ext, dst);
+				byte(uint8_t(imm));
+			} else {
+				rr(0x81, w, ext, dst);
+				imm32(imm);
+			}
+		}
+		// ALU_* dst, [base + disp]
+		void alu_mem(int ext, int dst, int base, int32_t disp) { rm(0x03 + 8 * ext, true, dst, base, disp); }
+		// ALU_* qword [base + disp], imm
+		void alu_mem_imm(int ext, int base, int32_t disp, int32_t imm) {
+			if (imm >= -128 && imm < 128) {
+				rm(0x83, true, ext, base, disp);
+				byte(uint8_t(imm));
+			} else {
+				rm(0x81, true, ext, base, disp);
+				imm32(imm);
+			}
+		}
+		void shift_imm(int ext, int dst, uint8_t imm, bool w = true) { rr(0xC1, w, ext, dst); byte(imm); }
+		void shift_cl(int ext, int dst, bool w = true) { rr(0xD3, w, ext, dst); }
+		void imul(int dst, int src, bool w = true) { rr(0x0FAF, w, dst, src); }
+		void movsxd(int dst, int src) { rr(0x63, true, dst, src); }
+		// dst = condition ? 1 : 0, using only the low byte of RAX
+		void setcc_rax(uint8_t cc) {
+			byte(0x0F); byte(0x90 | cc); byte(0xC0);
+			rr(0x0FB6, false, RAX, RAX);
+		}
+		size_t jcc(uint8_t cc) {
+			byte(0x0F); byte(0x80 | cc); imm32(0);
+			return size() - 4;
+		}
+		size_t jmp() {
+			byte(0xE9); imm32(0);
+			return size() - 4;
+		}
+		void patch(size_t at, size_t target) {
+			const int32_t rel = int32_t(int64_t(target) - int64_t(at + 4));
+			std::memcpy(&code[at], &rel, sizeof(rel));
+		}
+		void call(uintptr_t func) {
+			mov_abs(RAX, func);
+			rr(0xFF, false, 2, RAX);
+		}
+		void push(int r) { rex(false, 0, 0, r); byte(0x50 + (r & 7)); }
+		void pop(int r) { rex(false, 0, 0, r); byte(0x58 + (r & 7)); }
+		void ret() { byte(0xC3); }
+	};
+
+	// Byte offsets from the CPU to everything the generated code touches
+	struct NativeLayout {
+		int32_t regs;
+		int32_t pc;
+		int32_t exception;
+		int32_t arena;
+		int32_t dirty;
+		int32_t read_boundary;
+		int32_t write_boundary;
+		int32_t rodata_end;
+	};
+
+	template <int W>
+	struct NativeInstr {
+		address_type<W> pc;
+		unsigned length;
+		rv32i_instruction instr; // Expanded from compressed, if needed
+	};
+
+	// Slow paths for memory accesses outside of the flat arena. Exceptions
+	// cannot unwind through generated code, so they are stored in the CPU
+	// and the generated code returns to the dispatch, which rethrows.
+	template <int W, typename T>
+	static uint64_t native_load(CPU<W>& cpu, address_type<W> addr) noexcept
+	{
+		try {
+			using U = std::make_unsigned_t<T>;
+			return uint64_t(int64_t(T(cpu.machine().memory.template read<U>(addr))));
+		} catch (...) {
+			cpu.set_current_exception(std::current_exception());
+			return 0;
+		}
+	}
+	template <int W, typename T>
+	static void native_store(CPU<W>& cpu, address_type<W> addr, uint64_t value) noexcept
+	{
+		try {
+			cpu.machine().memory.template write<T>(addr, T(value));
+		} catch (...) {
+			cpu.set_current_exception(std::current_exception());
+		}
+	}
+
+	template <int W>
+	static bool is_native_instruction(rv32i_instruction instr)
+	{
+		if (instr.is_compressed())
+			return false;
+		switch (instr.opcode()) {
+		case RV32I_LUI:
+		case RV32I_AUIPC:
+		case RV32I_JAL:
+			return true;
+		case RV32I_JALR:
+			return instr.Itype.funct3 == 0;
+		case RV32I_BRANCH:
+			return instr.Btype.funct3 != 2 && instr.Btype.funct3 != 3;
+		case RV32I_LOAD:
+			return instr.Itype.funct3 != 7;
+		case RV32I_STORE:
+			return instr.Stype.funct3 < 4;
+		case RV32I_FENCE:
+			return instr.Itype.funct3 == 0;
+		case RV32I_OP_IMM:
+			switch (instr.Itype.funct3) {
+			case 1: return instr.Itype.high_bits() == 0;
+			case 5: return instr.Itype.high_bits() == 0 || instr.Itype.is_srai();
+			default: return true;
+			}
+		case RV32I_OP:
+			if (instr.Rtype.funct7 == 0)
+				return true;
+			if (instr.Rtype.is_f7())
+				return instr.Rtype.funct3 == 0 || instr.Rtype.funct3 == 5;
+			if (instr.Rtype.is_32M()) // MUL, MULH and MULHU
+				return instr.Rtype.funct3 == 0 || instr.Rtype.funct3 == 1 || instr.Rtype.funct3 == 3;
+			return false;
+		case RV64I_OP_IMM32:
+			switch (instr.Itype.funct3) {
+			case 0: return true;
+			case 1: return (instr.Itype.imm >> 5) == 0;
+			case 5: return (instr.Itype.imm >> 5) == 0 || (instr.Itype.imm >> 5) == 0x20;
+			default: return false;
+			}
+		case RV64I_OP32:
+			if (instr.Rtype.funct7 == 0)
+				return instr.Rtype.funct3 == 0 || instr.Rtype.funct3 == 1 || instr.Rtype.funct3 == 5;
+			if (instr.Rtype.is_f7())
+				return instr.Rtype.funct3 == 0 || instr.Rtype.funct3 == 5;
+			if (instr.Rtype.is_32M()) // MULW
+				return instr.Rtype.funct3 == 0;
+			return false;
+		default:
+			return false;
+		}
+	}
+
+	template <int W>
+	static rv32i_instruction native_read(const DecodedExecuteSegment<W>& exec, address_type<W> pc)
+	{
+		rv32i_instruction instr = read_instruction(exec.exec_data(), pc, exec.exec_end());
+#ifdef RISCV_EXT_C
+		if (instr.is_compressed())
+			instr = rvc_expand<W>(instr);
+#endif
+		return instr;
+	}
+
+	template <int W>
+	struct NativeEmitter
+	{
+		using address_t = address_type<W>;
+
+		NativeEmitter(X86Assembler& a, const NativeLayout& layout, const std::vector<NativeInstr<W>>& region)
+			: a(a), layout(layout), region(region)
+		{
+			m_cached.fill(-1);
+			m_written.fill(false);
+			std::array<unsigned, 32> uses {};
+			for (auto& ni : region) {
+				const auto instr = ni.instr;
+				switch (instr.opcode()) {
+				case RV32I_LUI:
+				case RV32I_AUIPC:
+				case RV32I_JAL:
+					uses[instr.Utype.rd]++;
+					m_written[instr.Utype.rd] = true;
+					break;
+				case RV32I_BRANCH:
+				case RV32I_STORE:
+					uses[instr.Stype.rs1]++;
+					uses[instr.Stype.rs2]++;
+					break;
+				case RV32I_OP:
+				case RV64I_OP32:
+					uses[instr.Rtype.rs2]++;
+					[[fallthrough]];
+				default:
+					uses[instr.Itype.rs1]++;
+					uses[instr.Itype.rd]++;
+					m_written[instr.Itype.rd] = true;
+				}
+			}
+			uses[0] = 0;
+			// The most used registers live in callee-saved host registers
+			static constexpr int hosts[NATIVE_CACHED_REGISTERS] = { R12, R13, R14, R15 };
+			for (int i = 0; i < NATIVE_CACHED_REGISTERS; i++) {
+				unsigned best = 0;
+				for (unsigned r = 1; r < 32; r++) {
+					if (uses[r] > uses[best])
+						best = r;
+				}
+				if (uses[best] < NATIVE_CACHED_REGISTER_MIN_USES)
+					break;
+				m_cached[best] = hosts[i];
+				uses[best] = 0;
+			}
+		}
+
+		void emit()
+		{
+			// Internal jump targets, which begin with a synchronized counter
+			for (auto& ni : region) {
+				if (auto target = static_target(ni)) {
+					auto it = std::lower_bound(region.begin(), region.end(), *target,
+						[] (const NativeInstr<W>& other, address_t pc) { return other.pc < pc; });
+					if (it != region.end() && it->pc == *target)
+						m_labels.emplace(*target, SIZE_MAX);
+				}
+			}
+			prologue();
+			for (auto& ni : region) {
+				auto it = m_labels.find(ni.pc);
+				if (it != m_labels.end()) {
+					sync_counter();
+					it->second = a.size();
+				}
+				emit_instruction(ni);
+			}
+			const auto& last = region.back();
+			const auto op = last.instr.opcode();
+			if (op != RV32I_JAL && op != RV32I_JALR) {
+				exit_to(last.pc + last.length, m_pending);
+			}
+			for (auto& fixup : m_fixups) {
+				a.patch(fixup.first, m_labels.at(fixup.second));
+			}
+			if (!m_exception_exits.empty()) {
+				// Exception exits set PC and the instruction count (in RCX)
+				// and then share the return to the dispatch
+				std::vector<size_t> to_common;
+				for (auto& ee : m_exception_exits) {
+					a.patch(ee.jump, a.size());
+					a.mov_imm(RAX, ee.pc);
+					a.mov_imm(RCX, ee.count);
+					to_common.push_back(a.jmp());
+				}
+				for (auto jump : to_common)
+					a.patch(jump, a.size());
+				writeback();
+				a.store(RBX, layout.pc, RAX);
+				a.load(RAX, RSP, 0);
+				a.alu(ALU_ADD, RAX, RCX);
+				a.zero(RDX);
+				epilogue();
+			}
+		}
+
+	private:
+		static std::optional<address_t> static_target(const NativeInstr<W>& ni) {
+			if (ni.instr.opcode() == RV32I_BRANCH)
+				return ni.pc + ni.instr.Btype.signed_imm();
+			if (ni.instr.opcode() == RV32I_JAL)
+				return ni.pc + ni.instr.Jtype.jump_offset();
+			return std::nullopt;
+		}
+		int32_t reg_offset(unsigned reg) const noexcept { return layout.regs + reg * sizeof(address_t); }
+
+		void prologue() {
+			a.push(RBX); a.push(RBP);
+			a.push(R12); a.push(R13); a.push(R14); a.push(R15);
+			// [rsp] = instruction counter, [rsp+8] = max instructions
+			a.alu_imm(ALU_SUB, RSP, 24);
+			a.mov(RBX, RDI);
+			a.store(RSP, 0, RSI);
+			a.store(RSP, 8, RDX);
+			a.load(RBP, RBX, layout.arena);
+			for (unsigned r = 1; r < 32; r++) {
+				if (m_cached[r] >= 0)
+					a.load(m_cached[r], RBX, reg_offset(r));
+			}
+		}
+		void epilogue() {
+			a.alu_imm(ALU_ADD, RSP, 24);
+			a.pop(R15); a.pop(R14); a.pop(R13); a.pop(R12);
+			a.pop(RBP); a.pop(RBX);
+			a.ret();
+		}
+		void writeback() {
+			for (unsigned r = 1; r < 32; r++) {
+				if (m_cached[r] >= 0 && m_written[r])
+					a.store(RBX, reg_offset(r), m_cached[r]);
+			}
+		}
+		void sync_counter() {
+			if (m_pending != 0)
+				a.alu_mem_imm(ALU_ADD, RSP, 0, m_pending);
+			m_pending = 0;
+		}
+
+		void get(int dst, unsigned reg) {
+			if (reg == 0)
+				a.zero(dst);
+			else if (m_cached[reg] >= 0)
+				a.mov(dst, m_cached[reg]);
+			else
+				a.load(dst, RBX, reg_offset(reg));
+		}
+		void set(unsigned reg, int src) {
+			if (reg == 0)
+				return;
+			if (m_cached[reg] >= 0)
+				a.mov(m_cached[reg], src);
+			else
+				a.store(RBX, reg_offset(reg), src);
+		}
+
+		// Return to the dispatch with PC in RAX
+		void exit_rax(unsigned count) {
+			writeback();
+			a.store(RBX, layout.pc, RAX);
+			a.load(RAX, RSP, 0);
+			if (count != 0)
+				a.alu_imm(ALU_ADD, RAX, count);
+			a.load(RDX, RSP, 8);
+			epilogue();
+		}
+		void exit_to(address_t pc, unsigned count) {
+			a.mov_imm(RAX, pc);
+			exit_rax(count);
+		}
+		// Continue at target, after counting instructions
+		void jump_to(address_t target, unsigned count) {
+			auto it = m_labels.find(target);
+			if (it == m_labels.end()) {
+				exit_to(target, count);
+				return;
+			}
+			if (count != 0)
+				a.alu_mem_imm(ALU_ADD, RSP, 0, count);
+			a.load(RAX, RSP, 0);
+			a.alu_mem(ALU_CMP, RAX, RSP, 8);
+			const size_t jb = a.jcc(CC_B);
+			if (it->second != SIZE_MAX)
+				a.patch(jb, it->second);
+			else
+				m_fixups.emplace_back(jb, target);
+			exit_to(target, 0);
+		}
+		// After a slow path call, leave if the call produced an exception
+		void check_exception(address_t pc) {
+			a.alu_mem_imm(ALU_CMP, RBX, layout.exception, 0);
+			m_exception_exits.push_back({a.jcc(CC_NE), pc, m_pending});
+		}
+
+		template <typename T>
+		void emit_load(const NativeInstr<W>& ni, unsigned op) {
+			const auto instr = ni.instr;
+			get(RCX, instr.Itype.rs1);
+			if (instr.Itype.signed_imm() != 0)
+				a.alu_imm(ALU_ADD, RCX, instr.Itype.signed_imm());
+			size_t done = 0;
+			if constexpr (flat_readwrite_arena && !encompassing_Nbit_arena) {
+				// Same bounds check as Memory::read(): address - RWREAD_BEGIN < read_boundary
+				a.mov(RAX, RCX);
+				a.alu_imm(ALU_SUB, RAX, Memory<W>::RWREAD_BEGIN);
+				a.alu_mem(ALU_CMP, RAX, RBX, layout.read_boundary);
+				const size_t slow = a.jcc(CC_AE);
+				a.rsib(op, sizeof(T) == 8 || std::is_signed_v<T>, RDX, RBP, RCX);
+				done = a.jmp();
+				a.patch(slow, a.size());
+			}
+			writeback();
+			a.mov(RDI, RBX);
+			a.mov(RSI, RCX);
+			a.call(uintptr_t(&native_load<W, T>));
+			a.mov(RDX, RAX);
+			check_exception(ni.pc);
+			if (done != 0)
+				a.patch(done, a.size());
+			set(instr.Itype.rd, RDX);
+		}
+		template <typename T>
+		void emit_store(const NativeInstr<W>& ni) {
+			const auto instr = ni.instr;
+			get(RCX, instr.Stype.rs1);
+			if (instr.Stype.signed_imm() != 0)
+				a.alu_imm(ALU_ADD, RCX, instr.Stype.signed_imm());
+			get(RDX, instr.Stype.rs2);
+			size_t done = 0;
+			if constexpr (flat_readwrite_arena && !encompassing_Nbit_arena) {
+				// Same bounds check as Memory::write(), and only when pages are not tracked
+				a.mov(RAX, RCX);
+				a.alu_mem(ALU_SUB, RAX, RBX, layout.rodata_end);
+				a.alu_mem(ALU_CMP, RAX, RBX, layout.write_boundary);
+				const size_t slow1 = a.jcc(CC_AE);
+				a.alu_mem_imm(ALU_CMP, RBX, layout.dirty, 0);
+				const size_t slow2 = a.jcc(CC_NE);
+				if constexpr (sizeof(T) == 2) a.byte(0x66);
+				a.rsib(sizeof(T) == 1 ? 0x88 : 0x89, sizeof(T) == 8, RDX, RBP, RCX);
+				done = a.jmp();
+				a.patch(slow1, a.size());
+				a.patch(slow2, a.size());
+			}
+			writeback();
+			a.mov(RDI, RBX);
+			a.mov(RSI, RCX);
+			a.call(uintptr_t(&native_store<W, T>));
+			check_exception(ni.pc);
+			if (done != 0)
+				a.patch(done, a.size());
+		}
+
+		void emit_instruction(const NativeInstr<W>& ni)
+		{
+			const auto instr = ni.instr;
+			switch (instr.opcode()) {
+			case RV32I_LUI:
+				if (instr.Utype.rd != 0) {
+					a.mov_imm(RAX, int64_t(instr.Utype.upper_imm()));
+					set(instr.Utype.rd, RAX);
+				}
+				break;
+			case RV32I_AUIPC:
+				if (instr.Utype.rd != 0) {
+					a.mov_imm(RAX, int64_t(ni.pc + address_t(int64_t(instr.Utype.upper_imm()))));
+					set(instr.Utype.rd, RAX);
+				}
+				break;
+			case RV32I_FENCE:
+				break;
+			case RV32I_OP_IMM: {
+				const unsigned rd = instr.Itype.rd;
+				const int32_t imm = instr.Itype.signed_imm();
+				if (rd == 0)
+					break;
+				get(RAX, instr.Itype.rs1);
+				switch (instr.Itype.funct3) {
+				case 0: // ADDI
+					if (imm != 0) a.alu_imm(ALU_ADD, RAX, imm);
+					break;
+				case 1: // SLLI
+					a.shift_imm(SHIFT_SHL, RAX, instr.Itype.shift64_imm());
+					break;
+				case 2: // SLTI
+					a.alu_imm(ALU_CMP, RAX, imm);
+					a.setcc_rax(CC_L);
+					break;
+				case 3: // SLTIU
+					a.alu_imm(ALU_CMP, RAX, imm);
+					a.setcc_rax(CC_B);
+					break;
+				case 4: // XORI
+					a.alu_imm(ALU_XOR, RAX, imm);
+					break;
+				case 5: // SRLI, SRAI
+					a.shift_imm(instr.Itype.is_srai() ? SHIFT_SAR : SHIFT_SHR, RAX, instr.Itype.shift64_imm());
+					break;
+				case 6: // ORI
+					a.alu_imm(ALU_OR, RAX, imm);
+					break;
+				case 7: // ANDI
+					a.alu_imm(ALU_AND, RAX, imm);
+					break;
+				}
+				set(rd, RAX);
+				break;
+			}
+			case RV32I_OP: {
+				const unsigned rd = instr.Rtype.rd;
+				if (rd == 0)
+					break;
+				get(RAX, instr.Rtype.rs1);
+				get(RCX, instr.Rtype.rs2);
+				if (instr.Rtype.is_32M()) {
+					if (instr.Rtype.funct3 == 0) { // MUL
+						a.imul(RAX, RCX);
+					} else { // MULH, MULHU: RDX:RAX = RAX * RCX
+						a.rr(0xF7, true, instr.Rtype.funct3 == 1 ? 5 : 4, RCX);
+						a.mov(RAX, RDX);
+					}
+					set(rd, RAX);
+					break;
+				}
+				switch (instr.Rtype.funct3) {
+				case 0: a.alu(instr.Rtype.is_f7() ? ALU_SUB : ALU_ADD, RAX, RCX); break;
+				case 1: a.shift_cl(SHIFT_SHL, RAX); break;
+				case 2: a.alu(ALU_CMP, RAX, RCX); a.setcc_rax(CC_L); break;
+				case 3: a.alu(ALU_CMP, RAX, RCX); a.setcc_rax(CC_B); break;
+				case 4: a.alu(ALU_XOR, RAX, RCX); break;
+				case 5: a.shift_cl(instr.Rtype.is_f7() ? SHIFT_SAR : SHIFT_SHR, RAX); break;
+				case 6: a.alu(ALU_OR, RAX, RCX); break;
+				case 7: a.alu(ALU_AND, RAX, RCX); break;
+				}
+				set(rd, RAX);
+				break;
+			}
+			case RV64I_OP_IMM32: {
+				const unsigned rd = instr.Itype.rd;
+				if (rd == 0)
+					break;
+				get(RAX, instr.Itype.rs1);
+				switch (instr.Itype.funct3) {
+				case 0: // ADDIW
+					if (instr.Itype.signed_imm() != 0)
+						a.alu_imm(ALU_ADD, RAX, instr.Itype.signed_imm(), false);
+					break;
+				case 1: // SLLIW
+					a.shift_imm(SHIFT_SHL, RAX, instr.Itype.shift_imm(), false);
+					break;
+				case 5: // SRLIW, SRAIW
+					a.shift_imm((instr.Itype.imm >> 5) ? SHIFT_SAR : SHIFT_SHR, RAX, instr.Itype.shift_imm(), false);
+					break;
+				}
+				a.movsxd(RAX, RAX);
+				set(rd, RAX);
+				break;
+			}
+			case RV64I_OP32: {
+				const unsigned rd = instr.Rtype.rd;
+				if (rd == 0)
+					break;
+				get(RAX, instr.Rtype.rs1);
+				get(RCX, instr.Rtype.rs2);
+				if (instr.Rtype.is_32M()) { // MULW
+					a.imul(RAX, RCX, false);
+				} else {
+					switch (instr.Rtype.funct3) {
+					case 0: a.alu(instr.Rtype.is_f7() ? ALU_SUB : ALU_ADD, RAX, RCX, false); break;
+					case 1: a.shift_cl(SHIFT_SHL, RAX, false); break;
+					case 5: a.shift_cl(instr.Rtype.is_f7() ? SHIFT_SAR : SHIFT_SHR, RAX, false); break;
+					}
+				}
+				a.movsxd(RAX, RAX);
+				set(rd, RAX);
+				break;
+			}
+			case RV32I_LOAD:
+				switch (instr.Itype.funct3) {
+				case 0: emit_load<int8_t>(ni, 0x0FBE); break;   // MOVSX r64, byte
+				case 1: emit_load<int16_t>(ni, 0x0FBF); break;  // MOVSX r64, word
+				case 2: emit_load<int32_t>(ni, 0x63); break;    // MOVSXD r64, dword
+				case 3: emit_load<int64_t>(ni, 0x8B); break;    // MOV r64, qword
+				case 4: emit_load<uint8_t>(ni, 0x0FB6); break;  // MOVZX r32, byte
+				case 5: emit_load<uint16_t>(ni, 0x0FB7); break; // MOVZX r32, word
+				case 6: emit_load<uint32_t>(ni, 0x8B); break;   // MOV r32, dword
+				}
+				break;
+			case RV32I_STORE:
+				switch (instr.Stype.funct3) {
+				case 0: emit_store<uint8_t>(ni); break;
+				case 1: emit_store<uint16_t>(ni); break;
+				case 2: emit_store<uint32_t>(ni); break;
+				case 3: emit_store<uint64_t>(ni); break;
+				}
+				break;
+			case RV32I_BRANCH: {
+				static constexpr uint8_t conditions[8] = { CC_E, CC_NE, 0, 0, CC_L, CC_GE, CC_B, CC_AE };
+				get(RAX, instr.Btype.rs1);
+				get(RCX, instr.Btype.rs2);
+				a.alu(ALU_CMP, RAX, RCX);
+				const size_t not_taken = a.jcc(conditions[instr.Btype.funct3] ^ 1);
+				jump_to(ni.pc + instr.Btype.signed_imm(), m_pending + 1);
+				a.patch(not_taken, a.size());
+				break;
+			}
+			case RV32I_JAL:
+				if (instr.Jtype.rd != 0) {
+					a.mov_imm(RAX, ni.pc + ni.length);
+					set(instr.Jtype.rd, RAX);
+				}
+				jump_to(ni.pc + instr.Jtype.jump_offset(), m_pending + 1);
+				return;
+			case RV32I_JALR:
+				get(RAX, instr.Itype.rs1);
+				if (instr.Itype.signed_imm() != 0)
+					a.alu_imm(ALU_ADD, RAX, instr.Itype.signed_imm());
+				a.alu_imm(ALU_AND, RAX, -2);
+				if (instr.Itype.rd != 0) {
+					a.mov_imm(RCX, ni.pc + ni.length);
+					set(instr.Itype.rd, RCX);
+				}
+				exit_rax(m_pending + 1);
+				return;
+			}
+			m_pending++;
+		}
+
+		X86Assembler& a;
+		const NativeLayout& layout;
+		const std::vector<NativeInstr<W>>& region;
+		std::array<int, 32> m_cached;
+		std::array<bool, 32> m_written;
+		std::unordered_map<address_t, size_t> m_labels;
+		std::vector<std::pair<size_t, address_t>> m_fixups;
+		struct ExceptionExit {
+			size_t jump;
+			address_t pc;
+			unsigned count;
+		};
+		std::vector<ExceptionExit> m_exception_exits;
+		unsigned m_pending = 0;
+	};
+#endif // __x86_64__
+
+template <int W>
+bool CPU<W>::native_translate(const MachineOptions<W>& options, DecodedExecuteSegment<W>& exec, const Machine<W>& machine)
+{
+#if defined(__x86_64__) && !defined(_WIN32)
+	if constexpr (W == 8)
+	{
+		const auto t0 = std::chrono::high_resolution_clock::now();
+		const address_t begin = exec.exec_begin();
+		const address_t end   = exec.exec_end();
+		if (begin >= end || (begin & 1))
+			return false;
+
+		std::unordered_set<address_t> ebreak_locations;
+		for (auto& loc : options.ebreak_locations) {
+			if (std::holds_alternative<address_t>(loc))
+				ebreak_locations.insert(std::get<address_t>(loc));
+			else
+				ebreak_locations.insert(machine.address_of(std::get<std::string>(loc)));
+		}
+
+		// Find instruction boundaries and block heads: the segment start,
+		// the program entry, branch and jump targets and the instructions
+		// following jumps and instructions left to the interpreter.
+		const size_t slots = (end - begin) / 2 + 1;
+		std::vector<uint8_t> boundary(slots), head(slots);
+		std::vector<address_t> targets;
+		bool after_stop = true;
+		for (address_t pc = begin; pc < end; ) {
+			const auto raw = read_instruction(exec.exec_data(), pc, end);
+			const unsigned length = (compressed_enabled && raw.is_compressed()) ? 2 : 4;
+			boundary[(pc - begin) / 2] = 1;
+			if (after_stop)
+				head[(pc - begin) / 2] = 1;
+			const auto instr = native_read(exec, pc);
+			const bool supported = is_native_instruction<W>(instr);
+			if (supported && instr.opcode() == RV32I_BRANCH)
+				targets.push_back(pc + instr.Btype.signed_imm());
+			else if (supported && instr.opcode() == RV32I_JAL)
+				targets.push_back(pc + instr.Jtype.jump_offset());
+			after_stop = !supported || instr.opcode() == RV32I_JAL || instr.opcode() == RV32I_JALR;
+			pc += length;
+		}
+		targets.push_back(machine.memory.start_address());
+		for (auto target : targets) {
+			if (target >= begin && target < end && boundary[(target - begin) / 2] && !(target & 1))
+				head[(target - begin) / 2] = 1;
+		}
+
+		Machine<W>& m = const_cast<Machine<W>&> (machine);
+		NativeLayout layout;
+		layout.regs  = uintptr_t(&m.cpu.registers().get()[0]) - uintptr_t(&m.cpu);
+		layout.pc    = uintptr_t(&m.cpu.registers().pc) - uintptr_t(&m.cpu);
+		layout.exception = uintptr_t(&m.cpu.m_current_exception) - uintptr_t(&m.cpu);
+		layout.arena = uintptr_t(&m.memory.memory_arena_ptr_ref()) - uintptr_t(&m.cpu);
+		layout.dirty = layout.arena + Memory<W>::memory_arena_dirty_offset();
+		layout.read_boundary  = layout.arena + Memory<W>::memory_arena_read_boundary_offset();
+		layout.write_boundary = layout.arena + Memory<W>::memory_arena_write_boundary_offset();
+		layout.rodata_end     = layout.arena + Memory<W>::initial_rodata_end_offset();
+		static_assert(sizeof(std::exception_ptr) == sizeof(void*), "Generated code tests the exception pointer");
+
+		// Emit one function for each head, until the instruction budget runs out
+		X86Assembler a;
+		std::vector<std::pair<address_t, size_t>> functions;
+		std::vector<NativeInstr<W>> region;
+		size_t total_instructions = 0;
+		for (size_t slot = 0; slot < slots && total_instructions < options.translate_instr_max; slot++) {
+			if (!head[slot])
+				continue;
+			const address_t headpc = begin + slot * 2;
+			if (ebreak_locations.count(headpc))
+				continue;
+			region.clear();
+			for (address_t pc = headpc; pc < end && region.size() < NATIVE_FUNCTION_MAX_INSTRUCTIONS; ) {
+				if (ebreak_locations.count(pc))
+					break;
+				const auto raw = read_instruction(exec.exec_data(), pc, end);
+				const unsigned length = (compressed_enabled && raw.is_compressed()) ? 2 : 4;
+				if (pc + length > end)
+					break;
+				const auto instr = native_read(exec, pc);
+				if (!is_native_instruction<W>(instr))
+					break;
+				region.push_back({pc, length, instr});
+				pc += length;
+				if (instr.opcode() == RV32I_JAL || instr.opcode() == RV32I_JALR)
+					break;
+			}
+			if (region.empty())
+				continue;
+			total_instructions += region.size();
+
+			functions.emplace_back(headpc, a.size());
+			NativeEmitter<W> emitter(a, layout, region);
+			emitter.emit();
+			// Keep functions 16-byte aligned
+			while (a.size() % 16) a.byte(0xCC);
+		}
+		if (functions.empty())
+			return false;
+
+		// Copy the code into executable memory, owned by the execute segment
+		const size_t code_size = (a.size() + 4095) & ~size_t(4095);
+		void* area = mmap(nullptr, code_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (area == MAP_FAILED)
+			return false;
+		std::memcpy(area, a.code.data(), a.size());
+		if (mprotect(area, code_size, PROT_READ | PROT_EXEC) != 0) {
+			munmap(area, code_size);
+			return false;
+		}
+		exec.set_native_code(std::shared_ptr<void>(area, [code_size] (void* p) { munmap(p, code_size); }));
+
+		// Create N+1 mappings, where the last one is a catch-all for invalid mappings
+		auto& mappings = exec.create_mappings(functions.size() + 1);
+		for (size_t i = 0; i < functions.size(); i++) {
+			mappings[i] = (bintr_block_func<W>)((const uint8_t *)area + functions[i].second);
+
+			auto& entry = exec.decoder_cache()[functions[i].first / DecoderData<W>::DIVISOR];
+			entry.set_bytecode(RV32I_BC_TRANSLATOR);
+			entry.set_invalid_handler();
+			entry.instr = i;
+		}
+		exec.set_mapping(functions.size(), [] (CPU<W>&, uint64_t, uint64_t, address_t) -> bintr_block_returns<W> {
+			throw MachineException(INVALID_PROGRAM, "Translation mapping outside execute area");
+		});
+
+		if (options.translate_timing) {
+			const auto t1 = std::chrono::high_resolution_clock::now();
+			printf(">> Native code generation took %ld ns\n",
+				long(std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count()));
+		}
+		if (options.verbose_loader) {
+			printf("libriscv: Activated native binary translation, %zu functions, %zu instructions, %zu bytes\n",
+				functions.size(), total_instructions, a.size());
+		}
+		return true;
+	}
+#endif
+	(void)options; (void)exec; (void)machine;
+	return false;
+}
+
+#ifdef RISCV_32I
+template bool CPU<4>::native_translate(const MachineOptions<4>&, DecodedExecuteSegment<4>&, const Machine<4>&);
+#endif
+#ifdef RISCV_64I
+template bool CPU<8>::native_translate(const MachineOptions<8>&, DecodedExecuteSegment<8>&, const Machine<8>&);
+#endif
+#ifdef RISCV_128I
+template bool CPU<16>::native_translate(const MachineOptions<16>&, DecodedExecuteSegment<16>&, const Machine<16>&);
+#endif
+} // riscv
@@ -822,6 +822,181 @@ INSTRUCTION(RV32V_BC_VFMUL_VF, rv32v_vfmul_vf) {
 }
 #endif // RISCV_EXT_VECTOR
 
+/**
+ * Superinstructions: The first instruction of a common pair executes
+ * both, stepping onto the second before executing it. The second entry
+ * is left untouched, so it can still be jumped to directly.
+*/
+
+INSTRUCTION(RV32I_BC_FUSED_LUI_ADDI, rv32i_fused_lui_addi) {
+	VIEW_INSTR_AS(hi, FasterJtype);
+	REG(hi.rd) = hi.upper_imm();
+	STEP_INSTR();
+	VIEW_INSTR_AS(fi, FasterItype);
+	REG(fi.get_rs1()) = REG(fi.get_rs2()) + fi.signed_imm();
+	NEXT_INSTR();
+}
+INSTRUCTION(RV32I_BC_FUSED_AUIPC_ADDI, rv32i_fused_auipc_addi) {
+	VIEW_INSTR_AS(hi, FasterJtype);
+	REG(hi.rd) = (pc - DECODER().block_bytes()) + hi.upper_imm();
+	STEP_INSTR();
+	VIEW_INSTR_AS(fi, FasterItype);
+	REG(fi.get_rs1()) = REG(fi.get_rs2()) + fi.signed_imm();
+	NEXT_INSTR();
+}
+INSTRUCTION(RV32I_BC_FUSED_AUIPC_JALR, rv32i_fused_auipc_jalr) {
+	VIEW_INSTR_AS(hi, FasterJtype);
+	REG(hi.rd) = (pc - DECODER().block_bytes()) + hi.upper_imm();
+	STEP_INSTR();
+	VIEW_INSTR_AS(fi, FasterItype);
+	const auto address = REG(fi.rs2) + fi.signed_imm();
+	if (fi.rs1 != 0) {
+		REG(fi.rs1) = pc + 4;
+	}
+	if constexpr (VERBOSE_JUMPS) {
+		fprintf(stderr, "AUIPC+JALR x%d + %d => rd=%d   PC 0x%lX => 0x%lX\n",
+			fi.rs2, fi.signed_imm(), fi.rs1, long(pc), long(address));
+	}
+	static constexpr addr_t ALIGN_MASK = (compressed_enabled) ? 0x1 : 0x3;
+	pc = address & ~ALIGN_MASK;
+	OVERFLOW_CHECKED_JUMP();
+}
+INSTRUCTION(RV32I_BC_FUSED_MV_MV, rv32i_fused_mv_mv) {
+	VIEW_INSTR_AS(mv, FasterMove);
+	REG(mv.get_rd()) = REG(mv.get_rs1());
+	STEP_INSTR();
+	VIEW_INSTR_AS(fi, FasterMove);
+	REG(fi.get_rd()) = REG(fi.get_rs1());
+	NEXT_INSTR();
+}
+INSTRUCTION(RV32I_BC_FUSED_LI_BEQ, rv32i_fused_li_beq) {
+	VIEW_INSTR_AS(li, FasterImmediate);
+	REG(li.get_rd()) = li.signed_imm();
+	STEP_INSTR();
+	VIEW_INSTR_AS(fi, FasterItype);
+	if (REG(fi.get_rs1()) == REG(fi.get_rs2())) {
+		PERFORM_BRANCH();
+	}
+	NEXT_BLOCK(4, false);
+}
+INSTRUCTION(RV32I_BC_FUSED_LI_BNE, rv32i_fused_li_bne) {
+	VIEW_INSTR_AS(li, FasterImmediate);
+	REG(li.get_rd()) = li.signed_imm();
+	STEP_INSTR();
+	VIEW_INSTR_AS(fi, FasterItype);
+	if (REG(fi.get_rs1()) != REG(fi.get_rs2())) {
+		PERFORM_BRANCH();
+	}
+	NEXT_BLOCK(4, false);
+}
+INSTRUCTION(RV32I_BC_FUSED_ADDI_BNE, rv32i_fused_addi_bne) {
+	VIEW_INSTR_AS(addi, FasterItype);
+	REG(addi.get_rs1()) = REG(addi.get_rs2()) + addi.signed_imm();
+	STEP_INSTR();
+	VIEW_INSTR_AS(fi, FasterItype);
+	if (REG(fi.get_rs1()) != REG(fi.get_rs2())) {
+		PERFORM_BRANCH();
+	}
+	NEXT_BLOCK(4, false);
+}
+INSTRUCTION(RV32I_BC_FUSED_LDW_ADD, rv32i_fused_ldw_add) {
+	VIEW_INSTR_AS(ld, FasterItype);
+	REG(ld.get_rs1()) = (int32_t)CPU().memory().template read<uint32_t>(
+		REG(ld.get_rs2()) + ld.signed_imm());
+	STEP_INSTR();
+	VIEW_INSTR_AS(fi, FasterOpType);
+	REG(fi.get_rd()) = REG(fi.get_rs1()) + REG(fi.get_rs2());
+	NEXT_INSTR();
+}
+INSTRUCTION(RV32I_BC_FUSED_LDW_LDW, rv32i_fused_ldw_ldw) {
+	VIEW_INSTR_AS(ld, FasterItype);
+	REG(ld.get_rs1()) = (int32_t)CPU().memory().template read<uint32_t>(
+		REG(ld.get_rs2()) + ld.signed_imm());
+	STEP_INSTR();
+	VIEW_INSTR_AS(fi, FasterItype);
+	REG(fi.get_rs1()) = (int32_t)CPU().memory().template read<uint32_t>(
+		REG(fi.get_rs2()) + fi.signed_imm());
+	NEXT_INSTR();
+}
+INSTRUCTION(RV32I_BC_FUSED_STW_STW, rv32i_fused_stw_stw) {
+	VIEW_INSTR_AS(st, FasterItype);
+	CPU().memory().template write<uint32_t>(
+		REG(st.get_rs1()) + st.signed_imm(), REG(st.get_rs2()));
+	STEP_INSTR();
+	VIEW_INSTR_AS(fi, FasterItype);
+	CPU().memory().template write<uint32_t>(
+		REG(fi.get_rs1()) + fi.signed_imm(), REG(fi.get_rs2()));
+	NEXT_INSTR();
+}
+#ifdef RISCV_64I
+INSTRUCTION(RV64I_BC_FUSED_LDD_ADD, rv64i_fused_ldd_add) {
+	if constexpr (W >= 8) {
+		VIEW_INSTR_AS(ld, FasterItype);
+		REG(ld.get_rs1()) = (int64_t)CPU().memory().template read<uint64_t>(
+			REG(ld.get_rs2()) + ld.signed_imm());
+		STEP_INSTR();
+		VIEW_INSTR_AS(fi, FasterOpType);
+		REG(fi.get_rd()) = REG(fi.get_rs1()) + REG(fi.get_rs2());
+		NEXT_INSTR();
+	}
+	else UNUSED_FUNCTION();
+}
+INSTRUCTION(RV64I_BC_FUSED_LDD_LDD, rv64i_fused_ldd_ldd) {
+	if constexpr (W >= 8) {
+		VIEW_INSTR_AS(ld, FasterItype);
+		REG(ld.get_rs1()) = (int64_t)CPU().memory().template read<uint64_t>(
+			REG(ld.get_rs2()) + ld.signed_imm());
+		STEP_INSTR();
+		VIEW_INSTR_AS(fi, FasterItype);
+		REG(fi.get_rs1()) = (int64_t)CPU().memory().template read<uint64_t>(
+			REG(fi.get_rs2()) + fi.signed_imm());
+		NEXT_INSTR();
+	}
+	else UNUSED_FUNCTION();
+}
+INSTRUCTION(RV64I_BC_FUSED_STD_STD, rv64i_fused_std_std) {
+	if constexpr (W >= 8) {
+		VIEW_INSTR_AS(st, FasterItype);
+		CPU().memory().template write<uint64_t>(
+			REG(st.get_rs1()) + st.signed_imm(), REG(st.get_rs2()));
+		STEP_INSTR();
+		VIEW_INSTR_AS(fi, FasterItype);
+		CPU().memory().template write<uint64_t>(
+			REG(fi.get_rs1()) + fi.signed_imm(), REG(fi.get_rs2()));
+		NEXT_INSTR();
+	}
+	else UNUSED_FUNCTION();
+}
+#endif // RISCV_64I
+#ifdef RISCV_EXT_COMPRESSED
+INSTRUCTION(RV32C_BC_FUSED_LDD_LDD, rv32c_fused_ldd_ldd) {
+	if constexpr (W >= 8) {
+		VIEW_INSTR_AS(ld, FasterItype);
+		REG(ld.get_rs1()) = (int64_t)CPU().memory().template read<uint64_t>(
+			REG(ld.get_rs2()) + ld.signed_imm());
+		STEP_C_INSTR();
+		VIEW_INSTR_AS(fi, FasterItype);
+		REG(fi.get_rs1()) = (int64_t)CPU().memory().template read<uint64_t>(
+			REG(fi.get_rs2()) + fi.signed_imm());
+		NEXT_C_INSTR();
+	}
+	else UNUSED_FUNCTION();
+}
+INSTRUCTION(RV32C_BC_FUSED_STD_STD, rv32c_fused_std_std) {
+	if constexpr (W >= 8) {
+		VIEW_INSTR_AS(st, FasterItype);
+		CPU().memory().template write<uint64_t>(
+			REG(st.get_rs1()) + st.signed_imm(), REG(st.get_rs2()));
+		STEP_C_INSTR();
+		VIEW_INSTR_AS(fi, FasterItype);
+		CPU().memory().template write<uint64_t>(
+			REG(fi.get_rs1()) + fi.signed_imm(), REG(fi.get_rs2()));
+		NEXT_C_INSTR();
+	}
+	else UNUSED_FUNCTION();
+}
+#endif // RISCV_EXT_COMPRESSED
+
 INSTRUCTION(RV32I_BC_LIVEPATCH, execute_livepatch) {
 	switch (DECODER().m_handler) {
 	case 0: { // Live-patch binary translation
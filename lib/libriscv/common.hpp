@@ -126,6 +126,23 @@ namespace riscv
 		/// locality and also enables read-write arena if the CMake option is ON.
 		bool use_memory_arena = true;
 
+		/// @brief Back the memory arena with an anonymous file (memfd), so that
+		/// forks of this machine can map a private copy-on-write view of the arena.
+		/// @details Without this, forks that use the memory arena will share (and
+		/// write directly into) the arena of the main machine. With it, each fork
+		/// gets kernel-level copy-on-write of the whole arena, keeping direct arena
+		/// accesses while isolating fork state. Only available on Linux, and it is
+		/// silently ignored elsewhere. Costs one file descriptor per main machine.
+		bool use_forkable_memory_arena = false;
+
+		/// @brief Keep a bitmap of the memory arena pages written by the guest.
+		/// @details Writes from the interpreter, system calls and binary translated
+		/// code all mark the pages they touch. The pages can be enumerated and
+		/// cleared with memory.for_each_dirty_page() and memory.clear_dirty_pages(),
+		/// so that resets and snapshots only need to visit the working set. Arena
+		/// writes become slightly slower, as they also update the bitmap.
+		bool track_dirty_pages = false;
+
 		/// @brief Enable sharing of execute segments between machines.
 		/// @details This will allow multiple machines to share the same execute
 		/// segment, reducing memory usage and increasing performance.
@@ -133,6 +150,38 @@ namespace riscv
 		/// translated code between machines. (Prevents some optimizations)
 		bool use_shared_execute_segments = true;
 
+		/// @brief Decode each page of an execute segment the first time it is executed.
+		/// @details The decoder cache is 4x the size of the execute segment with
+		/// compressed instructions (2x without), and is normally filled in when the
+		/// segment is created. With this option it is instead mapped as untouched
+		/// anonymous memory, so that only pages of code that actually run become
+		/// resident. Blocks end at page boundaries, and execute segments with a
+		/// compact decoder cache are never binary translated.
+		bool compact_decoder_cache = false;
+
+		/// @brief Execute segments of at least this many bytes also get a compact
+		/// decoder cache, so that large programs start without decoding first.
+		/// @details Unlike with compact_decoder_cache, these segments may still be
+		/// binary translated, in which case they are fully decoded up front.
+		/// Set to zero to always decode execute segments up front.
+		uint64_t compact_decoder_cache_threshold = 8ull << 20; // 8MB
+
+		/// @brief Decode execute segments up front on this many threads.
+		/// @details 0 selects a count from the segment size and the number of
+		/// hardware threads, and 1 decodes on the calling thread. The decoder
+		/// cache is the same regardless of the number of threads.
+		unsigned decoder_cache_threads = 0;
+
+		/// @brief Store decoder caches in files that begin with this prefix, and map
+		/// them from there instead of decoding when the same program is loaded again.
+		/// @details The files are keyed on the CRC32-C and address of the execute segment,
+		/// the library version and the build settings. They are mapped copy-on-write, so
+		/// that processes running the same program share the pages of the decoder cache.
+		/// Execute segments that are binary translated or likely JIT-compiled are always
+		/// decoded. Like translations, the files must be trusted. Only on Linux and FreeBSD.
+		/// Empty disables the decoder cache files.
+		std::string decoder_cache_prefix {};
+
 		/// @brief Override a default-injected exit function with another function
 		/// that is found by looking up the provided symbol name in the current program.
 		/// Eg. if default_exit_function is "fast_exit", then the ELF binary must have
@@ -171,6 +220,11 @@ namespace riscv
 		/// Translated shared objects will be stored in a file and can be re-used later.
 		/// @details When TCC is enabled, the translation cache will be disabled.
 		bool translation_cache = true;
+		/// @brief Maximum total size of the translation cache in bytes, or 0 for no limit.
+		/// @details Whenever a translation is added to the cache, the least recently used
+		/// shared objects with the same translation prefix and suffix are evicted until
+		/// the cache fits. Loading a translation from the cache counts as a use.
+		uint64_t translation_cache_max_bytes = 0;
 		/// @brief Enable the use of the memory arena for the binary translator.
 		/// @details If disabled, remote machines will be able to make remote
 		/// calls to this machine. In most cases, this is not needed.
@@ -195,6 +249,17 @@ namespace riscv
 		/// @details This will allow the binary translator to use and-masked addresses
 		/// for all memory accesses, which can drastically improve performance.
 		bool translate_automatic_nbit_address_space = false;
+		/// @brief Place the memory arena of 64-bit guests in a guard-paged host reservation,
+		/// so that loads in binary translated code need no bounds-check branch.
+		/// @details The reservation is the arena rounded up to a power of two, plus one page,
+		/// and everything past the end of the arena is inaccessible. Translated loads and-mask
+		/// their address into the reservation, so addresses alias at the power-of-two boundary
+		/// and the zero page reads as zeroes. Loads past the end of the arena fault on the host,
+		/// and are raised as a guest protection fault with imprecise register state.
+		/// Only used when translate_use_virtual_paging_fallback is disabled. Stores keep their
+		/// read-only segment check. Requires Linux or FreeBSD, and is not combined with
+		/// use_forkable_memory_arena.
+		bool translate_guard_paged_arena = false;
 		/// @brief Enable access to virtual pages outside of the arena in the binary translator.
 		/// @details Disabling this will simplifiy memory accesses, allowing up to 8 nearby
 		/// accesses to use only a single bounds-check. However, accessing virtual pages
@@ -214,6 +279,15 @@ namespace riscv
 		/// @details This will record slowpaths to the MachineOptions jump hints vector.
 		/// From there the CLI can save the jump hints to a file after the program has run.
 		bool record_slowpaths_to_jump_hints = false;
+		/// @brief Count how many times each block is entered by the interpreter.
+		/// @details The counts are kept in a side table next to the decoder cache, and
+		/// can be retrieved with Memory::gather_block_profile(). Blocks running as
+		/// binary translated code are not counted, so profiling runs should disable
+		/// translation. Counting is not synchronized between machines that share
+		/// execute segments, which may lose some counts.
+		/// @note Requires building with RISCV_BLOCK_PROFILE, otherwise the
+		/// machine constructor throws FEATURE_DISABLED.
+		bool record_block_profile = false;
 		/// @brief Enable live-patching a running instruction stream after background compilation.
 		/// @details This will allow the binary translator to patch the running instruction stream
 		/// with the newly compiled code, which allows it to switch to the newly compiled code
@@ -231,9 +305,21 @@ namespace riscv
 		/// either of these limits. The limits are per shared object.
 		unsigned translate_blocks_max = 1024;
 		unsigned translate_instr_max = 500'000;
+		/// @brief Split the translation into this many translation units, which are
+		/// compiled concurrently by the system compiler and linked into one shared object.
+		/// @details 0 selects a count from the size of the generated code and the number
+		/// of hardware threads, and 1 produces a single translation unit. The split does
+		/// not apply to libtcc, nor to embeddable and cross-compiled code.
+		unsigned translate_compile_units = 0;
 		/// @brief Jump location hints for the binary translator.
 		/// @details These hints can improve performance of the binary translation.
 		std::vector<address_type<W>> translator_jump_hints {};
+		/// @brief Block execution counts for profile-guided binary translation.
+		/// @details When not empty, only the blocks that were executed according to the
+		/// profile are translated, hottest first, until translate_blocks_max or
+		/// translate_instr_max is reached. Cold code is left to the interpreter.
+		/// The profile is produced by Memory::gather_block_profile().
+		std::vector<std::pair<address_type<W>, uint32_t>> translator_block_profile {};
 		/// @brief Enable background compilation of shared objects. The compilation step
 		/// will be executed from a user-provided callback, and will be applied to the machine
 		/// when ready. Applying the translation is thread-safe and will take effect on all
@@ -241,6 +327,19 @@ namespace riscv
 		/// For short-lived programs, this feature should be disabled, as it often takes more
 		/// time to translate and compile than to execute the program.
 		std::function<void(std::function<void()>& compilation_step)> translate_background_callback = nullptr;
+		/// @brief Tiered binary translation with libtcc. The libtcc translation goes live
+		/// immediately, while the same code is compiled with the system compiler (-O2) from
+		/// translate_background_callback. When ready, the optimized functions are swapped in,
+		/// even while machines are executing the segment.
+		/// @details Requires libtcc and a translate_background_callback. With translation_cache
+		/// enabled the optimized shared object is kept, and will be loaded directly next time.
+		bool translate_tiered = false;
+		/// @brief Emit x86-64 machine code for the execute segment directly into
+		/// executable memory, instead of generating C and invoking a compiler.
+		/// @details Available on x86-64 hosts for 64-bit programs, otherwise the regular
+		/// translator is used. Instructions without a native encoding (eg. system calls,
+		/// floating-point and division) stay with the interpreter.
+		bool translate_native = false;
 		/// @brief Allow the production of a secondary dependency-free DLL that can be
 		/// transferred to and loaded on Windows (or other) machines. It will be used
 		/// to greatly accelerate the emulation of the RISC-V program.
@@ -261,15 +360,42 @@ namespace riscv
 		/// @endcode
 		/// @note The hash is a CRC32-C of the execute segment + emulator settings.
 		/// @note The hash can be found with machine.current_execute_segment().translation_hash()
+		/// @note Shared objects from the system compiler are cached under this hash combined
+		/// with the compiler command line, so a different CC or CFLAGS does not load them.
 		static std::string translation_filename(const std::string& prefix, uint32_t hash, const std::string& suffix);
 
 #ifdef RISCV_LIBTCC
 		/// @brief Provide a custom libtcc1 location for the binary translator.
 		std::string libtcc1_location {};
+		/// @brief The number of libtcc translations kept alive in a process-wide cache,
+		/// shared by all machines, even after their execute segments have been destroyed.
+		/// @details The cache is keyed on the translation hash, the execute segment range
+		/// and the translation limits. The least recently used translations are released
+		/// first, but remain alive for as long as an execute segment is using them.
+		/// 0 disables the cache.
+		unsigned libtcc_code_cache_size = 32;
 #endif
 #endif
 	};
 
+#ifdef RISCV_BINARY_TRANSLATION
+	/// @brief Process-wide statistics of the binary translation cache.
+	struct TranslationCacheStats
+	{
+		uint64_t hits = 0;            // Translations loaded from the cache
+		uint64_t misses = 0;          // Translations that had to be compiled
+		uint64_t compile_time_ns = 0; // Time spent compiling misses
+		uint64_t evicted_files = 0;
+		uint64_t evicted_bytes = 0;
+	};
+	/// @brief Retrieve the translation cache statistics of this process.
+	/// @details A translation that another process published while this process
+	/// was waiting to compile it counts as a hit.
+	TranslationCacheStats translation_cache_stats() noexcept;
+	/// @brief Reset the translation cache statistics of this process.
+	void reset_translation_cache_stats() noexcept;
+#endif
+
 	static constexpr int SYSCALL_EBREAK = RISCV_SYSCALL_EBREAK_NR;
 
 	static constexpr size_t PageSize = RISCV_PAGE_SIZE;
@@ -362,7 +488,9 @@ namespace riscv
 
 
 	template <int W> struct MultiThreading;
+	template <int W> struct Multiprocessing;
 	template <int W> struct SerializedMachine;
+	template <int W> struct SerializedDelta;
 	struct Arena;
 
 	template <typename T>
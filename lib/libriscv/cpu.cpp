@@ -381,10 +381,13 @@ restart_precise_sim:
 				"Breakpoint address is not within the execute segment", addr);
 		}
 
+		// The block can only be found once its page is decoded
+		exec.decode_page(addr);
 		auto* exec_decoder = exec.decoder_cache();
 		auto* decoder_begin = &exec_decoder[exec.exec_begin() / DecoderData<W>::DIVISOR];
 
 		auto& cache_entry = exec_decoder[addr / DecoderData<W>::DIVISOR];
+		DecoderData<W>::unfuse_at(exec_decoder, exec.exec_begin(), addr);
 
 		// The last instruction will be the current entry
 		// Later instructions will work as normal
@@ -474,6 +477,7 @@ restart_precise_sim:
 		const address_t current_end = exec.exec_end();
 		while (block_pc < current_end)
 		{
+			exec.decode_page(block_pc);
 			// Move to the end of the block
 			block_pc += cache_entry->block_bytes();
 			cache_entry += cache_entry->block_bytes() / DecoderData<W>::DIVISOR;
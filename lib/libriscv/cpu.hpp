@@ -41,6 +41,13 @@ namespace riscv
 		/// @param pc The starting address
 		void simulate_inaccurate(address_t pc);
 
+#ifdef RISCV_BINARY_TRANSLATION
+		/// @brief Executes like simulate(), but turns host faults in a guard-paged
+		/// memory arena into guest protection faults.
+		/// @see MachineOptions::translate_guard_paged_arena
+		bool simulate_guarded(address_t pc, uint64_t icounter, uint64_t maxcounter);
+#endif
+
 		// Step precisely one instruction forward from current PC.
 		void step_one(bool use_instruction_counter = true);
 
@@ -62,7 +69,10 @@ namespace riscv
 		/// @return Current register state
 		RISCV_ALWAYS_INLINE const auto& registers() const noexcept { return this->m_regs; }
 
-		int cpu_id() const noexcept { return 0; }
+		/// @brief The hart ID, which is 0 except for harts started by
+		/// Machine::multiprocess(). Also readable by the guest as mhartid.
+		int cpu_id() const noexcept { return m_cpuid; }
+		void set_cpu_id(int id) noexcept { m_cpuid = id; }
 
 		auto& reg(uint32_t idx) noexcept { return registers().get(idx); }
 		const auto& reg(uint32_t idx) const noexcept { return registers().get(idx); }
@@ -193,7 +203,9 @@ namespace riscv
 		// Guard against no-progress execute-segment rebuild loops
 		address_t m_stale_restart_pc = ~address_t(0);
 
-		// The current exception (used by eg. TCC which doesn't create unwinding tables)
+		int m_cpuid = 0;
+
+		// The current exception (used by eg. TCC and native code, which have no unwinding tables)
 		std::exception_ptr m_current_exception = nullptr;
 
 		// The default execute fault simply triggers the exception
@@ -210,7 +222,10 @@ namespace riscv
 		static std::vector<TransMapping<W>> emit(std::string& code, const TransInfo<W>&);
 		void binary_translate(const MachineOptions<W>&, DecodedExecuteSegment<W>&, TransOutput<W>&) const;
 		static void activate_dylib(const MachineOptions<W>&, DecodedExecuteSegment<W>&, void*, const Machine<W>&, bool, bool) RISCV_INTERNAL;
-		static bool initialize_translated_segment(DecodedExecuteSegment<W>&, void*, const Machine<W>&, bool) RISCV_INTERNAL;
+		static TransOffsets translation_offsets(const Machine<W>&) RISCV_INTERNAL;
+		static bool initialize_translated_segment(DecodedExecuteSegment<W>&, void*, const TransOffsets&, bool) RISCV_INTERNAL;
+		static bool swap_in_dylib(DecodedExecuteSegment<W>&, void*, const TransOffsets&) RISCV_INTERNAL;
+		static bool native_translate(const MachineOptions<W>&, DecodedExecuteSegment<W>&, const Machine<W>&) RISCV_INTERNAL;
 		static void produce_embeddable_code(const MachineOptions<W>&, DecodedExecuteSegment<W>&, const TransOutput<W>&, const MachineTranslationEmbeddableCodeOptions&) RISCV_INTERNAL;
 #endif
 		static_assert((W == 4 || W == 8 || W == 16), "Must be either 32-bit, 64-bit or 128-bit ISA");
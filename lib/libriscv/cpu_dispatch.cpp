@@ -33,6 +33,21 @@ namespace riscv
 #define NEXT_C_INSTR() \
 	decoder += 1;      \
 	EXECUTE_INSTR();
+// Superinstructions step onto their second half without dispatching
+#define STEP_INSTR() \
+	decoder += (compressed_enabled ? 2 : 1);
+#define STEP_C_INSTR() \
+	decoder += 1;
+
+#ifdef RISCV_BLOCK_PROFILE
+#define PROFILE_BLOCK()                                          \
+	if (UNLIKELY(block_counters != nullptr)) {                   \
+		auto& block_count = block_counters[decoder - exec_decoder]; \
+		block_count += (block_count != UINT32_MAX);              \
+	}
+#else
+#define PROFILE_BLOCK() /* */
+#endif
 
 #define NEXT_BLOCK(len, OF)                 \
 	pc += len;                              \
@@ -43,6 +58,7 @@ namespace riscv
 		if (UNLIKELY(counter.overflowed())) \
 			goto check_jump;				\
 	}										\
+	PROFILE_BLOCK();                                         \
 	pc += decoder->block_bytes();                            \
 	counter.increment_counter(decoder->instruction_count()); \
 	EXECUTE_INSTR();
@@ -54,6 +70,7 @@ namespace riscv
 
 #define NEXT_SEGMENT()                                       \
 	decoder = &exec_decoder[pc >> DecoderData<W>::SHIFT];  \
+	PROFILE_BLOCK();                                         \
 	pc += decoder->block_bytes();                            \
 	counter.increment_counter(decoder->instruction_count()); \
 	EXECUTE_INSTR();
@@ -91,6 +108,10 @@ bool CPU<W>::simulate(address_t pc, uint64_t inscounter, uint64_t maxcounter)
 
 	DecoderData<W>* exec_decoder = exec->decoder_cache();
 	DecoderData<W>* decoder;
+#ifdef RISCV_BLOCK_PROFILE
+	// Block execution counters, when recording a block profile
+	uint32_t* block_counters = exec->block_counters();
+#endif
 
 	InstrCounter counter{inscounter, maxcounter};
 
@@ -107,6 +128,7 @@ bool CPU<W>::simulate(address_t pc, uint64_t inscounter, uint64_t maxcounter)
 
 continue_segment:
 	decoder = &exec_decoder[pc >> DecoderData<W>::SHIFT];
+	PROFILE_BLOCK();
 
 	pc += decoder->block_bytes();
 	counter.increment_counter(decoder->instruction_count());
@@ -226,7 +248,7 @@ check_jump:
 		goto new_execute_segment;
 
 counter_overflow:
-#ifdef RISCV_LIBTCC
+#ifdef RISCV_BINARY_TRANSLATION
 	// We need to check if we have a current exception
 	if (UNLIKELY(CPU().has_current_exception()))
 		goto handle_rethrow_exception;
@@ -246,12 +268,24 @@ new_execute_segment: {
 		current_begin = exec->exec_begin();
 		current_end   = exec->exec_end();
 		exec_decoder  = exec->decoder_cache();
+#ifdef RISCV_BLOCK_PROFILE
+		block_counters = exec->block_counters();
+#endif
 	}
 	goto continue_segment;
 
 execute_invalid:
 	// Calculate the current PC from the decoder pointer
 	pc = (decoder - exec_decoder) << DecoderData<W>::SHIFT;
+	// Compact decoder caches decode each page on first execution
+	if (exec->is_compact()) {
+		exec->decode_page(pc);
+		if (decoder->get_bytecode() != RV32I_BC_INVALID) {
+			// Undo the count of the undecoded entry and resume
+			counter.increment_counter(-uint64_t(DecoderData<W>{}.instruction_count()));
+			goto continue_segment;
+		}
+	}
 	// Check if the instruction is still invalid
 	try {
 		if (decoder->instr == 0 && MACHINE().memory.template read<uint16_t>(pc) != 0) {
@@ -263,7 +297,7 @@ execute_invalid:
 	registers().pc = pc;
 	trigger_exception(ILLEGAL_OPCODE, decoder->instr);
 
-#ifdef RISCV_LIBTCC
+#ifdef RISCV_BINARY_TRANSLATION
 handle_rethrow_exception:
 	// We have an exception, so we need to rethrow it
 	const auto except = CPU().current_exception();
@@ -23,14 +23,27 @@ namespace riscv
 #undef VIEW_INSTR_AS
 #undef NEXT_INSTR
 #undef NEXT_C_INSTR
+#undef STEP_INSTR
+#undef STEP_C_INSTR
 #undef NEXT_BLOCK
 #undef SAFE_INSTR_NEXT
 #undef NEXT_SEGMENT
 #undef PERFORM_BRANCH
 #undef PERFORM_FORWARD_BRANCH
 #undef OVERFLOW_CHECKED_JUMP
+#undef PROFILE_BLOCK
 #define INACCURATE_DISPATCH
 
+#ifdef RISCV_BLOCK_PROFILE
+#define PROFILE_BLOCK()                                             \
+	if (UNLIKELY(block_counters != nullptr)) {                      \
+		auto& block_count = block_counters[decoder - exec_decoder]; \
+		block_count += (block_count != UINT32_MAX);                 \
+	}
+#else
+#define PROFILE_BLOCK() /* */
+#endif
+
 #define VIEW_INSTR() \
 	auto instr = *(rv32i_instruction *)&decoder->instr;
 #define VIEW_INSTR_AS(name, x) \
@@ -44,12 +57,17 @@ namespace riscv
 #define NEXT_C_INSTR() \
 	decoder += 1;      \
 	EXECUTE_INSTR();
+#define STEP_INSTR() \
+	decoder += (compressed_enabled ? 2 : 1);
+#define STEP_C_INSTR() \
+	decoder += 1;
 
 #define NEXT_BLOCK(len, OF)                                    \
 	pc += len;                                                 \
 	decoder += len >> DecoderData<W>::SHIFT;                  \
 	if constexpr (FUZZING) /* Give OOB-aid to ASAN */          \
 		decoder = &exec_decoder[pc >> DecoderData<W>::SHIFT]; \
+	PROFILE_BLOCK();                                           \
 	pc += decoder->block_bytes();                              \
 	EXECUTE_INSTR();
 
@@ -59,6 +77,7 @@ namespace riscv
 
 #define NEXT_SEGMENT()                                       \
 	decoder = &exec_decoder[pc >> DecoderData<W>::SHIFT];   \
+	PROFILE_BLOCK();                                         \
 	pc += decoder->block_bytes();                            \
 	EXECUTE_INSTR();
 
@@ -92,6 +111,10 @@ namespace riscv
 		DecodedExecuteSegment<W> *exec = this->m_exec;
 		DecoderData<W> *exec_decoder = exec->decoder_cache();
 		DecoderData<W> *decoder;
+#ifdef RISCV_BLOCK_PROFILE
+		// Block execution counters, when recording a block profile
+		uint32_t* block_counters = exec->block_counters();
+#endif
 
 		// We need an execute segment matching current PC
 		if (UNLIKELY(!(pc >= exec->exec_begin() && pc < exec->exec_end())))
@@ -106,6 +129,7 @@ namespace riscv
 
 	continue_segment:
 		decoder = &exec_decoder[pc >> DecoderData<W>::SHIFT];
+		PROFILE_BLOCK();
 
 		pc += decoder->block_bytes();
 
@@ -160,7 +184,7 @@ retry_translated_function:
 	auto bintr_results =
 		exec->unchecked_mapping_at(decoder->instr)(*this, 0, ~0ULL, pc);
 	if (bintr_results.max_counter == 0) {
-#ifdef RISCV_LIBTCC
+#ifdef RISCV_BINARY_TRANSLATION
 		// We need to check if we have a current exception
 		if (UNLIKELY(CPU().has_current_exception()))
 			goto handle_rethrow_exception;
@@ -233,12 +257,21 @@ INSTRUCTION(RV32I_BC_STOP, rv32i_stop)
 		exec = new_values.exec;
 		pc = new_values.pc;
 		exec_decoder = exec->decoder_cache();
+#ifdef RISCV_BLOCK_PROFILE
+		block_counters = exec->block_counters();
+#endif
 	}
 		goto continue_segment;
 
 	execute_invalid:
 		// Calculate the current PC from the decoder pointer
 		pc = (decoder - exec_decoder) << DecoderData<W>::SHIFT;
+		// Compact decoder caches decode each page on first execution
+		if (exec->is_compact()) {
+			exec->decode_page(pc);
+			if (decoder->get_bytecode() != RV32I_BC_INVALID)
+				goto continue_segment;
+		}
 		// Check if the instruction is still invalid
 		try {
 			if (decoder->instr == 0 && MACHINE().memory.template read<uint16_t>(pc) != 0) {
@@ -249,7 +282,7 @@ INSTRUCTION(RV32I_BC_STOP, rv32i_stop)
 		registers().pc = pc;
 		trigger_exception(ILLEGAL_OPCODE, decoder->instr);
 
-#if defined(RISCV_BINARY_TRANSLATION) && defined(RISCV_LIBTCC)
+#ifdef RISCV_BINARY_TRANSLATION
 	handle_rethrow_exception:
 		// We have an exception, so we need to rethrow it
 		const auto except = CPU().current_exception();
@@ -8,6 +8,7 @@
 namespace riscv
 {
 	template<int W> struct DecoderData;
+	template<int W> struct CompactDecoderCache;
 
 	// A fully decoded execute segment
 	template <int W>
@@ -36,7 +37,7 @@ namespace riscv
 
 		auto* decoder_cache() noexcept { return m_exec_decoder; }
 		auto* decoder_cache() const noexcept { return m_exec_decoder; }
-		auto* decoder_cache_base() const noexcept { return m_decoder_cache.get(); }
+		auto* decoder_cache_base() const noexcept { return m_decoder_cache ? m_decoder_cache.get() : m_mapped_decoder_cache.get(); }
 		size_t decoder_cache_size() const noexcept { return m_decoder_cache_size; }
 
 		auto* create_decoder_cache(DecoderData<W>* cache, size_t size) {
@@ -44,8 +45,26 @@ namespace riscv
 			m_decoder_cache_size = size;
 			return m_decoder_cache.get();
 		}
+		// Use a decoder cache that was mapped from a file instead
+		auto* create_mapped_decoder_cache(std::shared_ptr<DecoderData<W>> cache, size_t size) {
+			m_decoder_cache.reset();
+			m_compact.reset();
+			m_mapped_decoder_cache = std::move(cache);
+			m_decoder_cache_size = size;
+			return m_mapped_decoder_cache.get();
+		}
+		bool is_decoder_cache_mapped() const noexcept { return m_mapped_decoder_cache != nullptr; }
 		void set_decoder(DecoderData<W>* dec) { m_exec_decoder = dec; }
 
+		// A compact decoder cache is mapped without being touched, and each
+		// page of the segment is decoded the first time it is executed.
+		bool is_compact() const noexcept { return m_compact != nullptr; }
+		DecoderData<W>* create_compact_decoder_cache(size_t size);
+		// Decode the page that contains addr, unless it already is
+		void decode_page(address_t addr);
+		void set_all_pages_decoded();
+		size_t decoded_pages() const noexcept;
+
 		size_t size_bytes() const noexcept {
 			return sizeof(*this) + (m_vaddr_end - m_vaddr_begin) + m_decoder_cache_size * 4;
 		}
@@ -57,6 +76,9 @@ namespace riscv
 		~DecodedExecuteSegment();
 
 		size_t threaded_rewrite(size_t bytecode, address_t pc, rv32i_instruction& instr);
+		// Turn common instruction pairs inside blocks into superinstructions
+		size_t threaded_fuse();
+		size_t threaded_fuse(DecoderData<W>* exec_decoder, address_t begin, address_t end);
 
 		uint32_t crc32c_hash() const noexcept { return m_crc32c_hash; }
 		void set_crc32c_hash(uint32_t hash) { m_crc32c_hash = hash; }
@@ -66,6 +88,15 @@ namespace riscv
 		bool is_libtcc() const noexcept { return m_is_libtcc; }
 		void* binary_translation_so() const { return m_bintr_dl; }
 		void set_binary_translated(void* dl, bool is_libtcc) const { m_bintr_dl = dl; m_is_libtcc = is_libtcc; }
+		// A translation shared with other segments is closed by its last owner
+		bool is_translation_shared(const void* dl) const noexcept { return dl != nullptr && m_bintr_shared.get() == dl; }
+		void set_shared_translation(std::shared_ptr<void> dl) { m_bintr_shared = std::move(dl); }
+		// The optimized (second tier) translation that replaced the libtcc handlers
+		void* tiered_translation_so() const { return m_bintr_tiered_dl; }
+		void set_tiered_translation(void* dl) { m_bintr_tiered_dl = dl; }
+		// Machine code emitted in-process by the native backend, freed with the segment
+		bool is_native_translated() const noexcept { return m_native_code != nullptr; }
+		void set_native_code(std::shared_ptr<void> code) { m_native_code = std::move(code); }
 		uint32_t translation_hash() const { return m_bintr_hash; }
 		void set_translation_hash(uint32_t hash) { m_bintr_hash = hash; }
 		auto& create_mappings(size_t mappings) { m_translator_mappings.resize(mappings); return m_translator_mappings; }
@@ -79,6 +110,13 @@ namespace riscv
 
 		void set_record_slowpaths(bool do_record) { m_do_record_slowpaths = do_record; }
 		bool is_recording_slowpaths() const noexcept { return m_do_record_slowpaths; }
+		// Block execution counters for profile-guided translation, indexed like the decoder cache
+		uint32_t* block_counters() const noexcept { return m_exec_block_counters; }
+		const uint32_t* block_counters_base() const noexcept { return m_block_counters.get(); }
+		void create_block_counters(size_t entries, size_t bias) {
+			m_block_counters.reset(new uint32_t[entries] {});
+			m_exec_block_counters = m_block_counters.get() - bias;
+		}
 		void wait_for_compilation_complete() {
 			std::unique_lock<std::mutex> lock(m_background_compilation_mutex);
 			m_background_compilation_cv.wait(lock, [this]{ return !m_is_background_compiling; });
@@ -123,12 +161,19 @@ namespace riscv
 		// Decoder cache is used to run bytecode simulation at a high speed
 		size_t          m_decoder_cache_size = 0;
 		std::unique_ptr<DecoderData<W>[]> m_decoder_cache = nullptr;
+		std::shared_ptr<CompactDecoderCache<W>> m_compact = nullptr;
+		std::shared_ptr<DecoderData<W>> m_mapped_decoder_cache = nullptr;
 
 #ifdef RISCV_BINARY_TRANSLATION
 		std::vector<bintr_block_func<W>> m_translator_mappings;
 		std::unique_ptr<DecoderData<W>[]> m_patched_decoder_cache = nullptr;
 		DecoderData<W>* m_patched_exec_decoder = nullptr;
+		std::unique_ptr<uint32_t[]> m_block_counters = nullptr;
+		uint32_t* m_exec_block_counters = nullptr;
 		mutable void* m_bintr_dl = nullptr;
+		std::shared_ptr<void> m_bintr_shared = nullptr;
+		void* m_bintr_tiered_dl = nullptr;
+		std::shared_ptr<void> m_native_code = nullptr;
 #ifdef RISCV_DEBUG
 		std::unordered_set<address_t> m_slowpath_addresses;
 #endif
@@ -173,15 +218,23 @@ namespace riscv
 
 		m_decoder_cache_size = other.m_decoder_cache_size;
 		m_decoder_cache = std::move(other.m_decoder_cache);
+		m_compact = std::move(other.m_compact);
+		m_mapped_decoder_cache = std::move(other.m_mapped_decoder_cache);
 
 #ifdef RISCV_BINARY_TRANSLATION
 		m_translator_mappings = std::move(other.m_translator_mappings);
 		m_bintr_dl = other.m_bintr_dl;
 		other.m_bintr_dl = nullptr;
+		m_bintr_shared = std::move(other.m_bintr_shared);
+		m_bintr_tiered_dl = other.m_bintr_tiered_dl;
+		other.m_bintr_tiered_dl = nullptr;
+		m_native_code = std::move(other.m_native_code);
 		m_bintr_hash = other.m_bintr_hash;
 		m_is_libtcc = other.m_is_libtcc;
 		m_patched_decoder_cache = std::move(other.m_patched_decoder_cache);
 		m_patched_exec_decoder = other.m_patched_exec_decoder;
+		m_block_counters = std::move(other.m_block_counters);
+		m_exec_block_counters = other.m_exec_block_counters;
 #endif
 	}
 
@@ -190,11 +243,15 @@ namespace riscv
 	{
 #ifdef RISCV_BINARY_TRANSLATION
 		extern void  dylib_close(void* dylib, bool is_libtcc);
-		if (m_bintr_dl)
+		if (m_bintr_dl && !is_translation_shared(m_bintr_dl))
 			dylib_close(m_bintr_dl, m_is_libtcc);
 		m_bintr_dl = nullptr;
 		// Wait for any background compilation to finish
 		wait_for_compilation_complete();
+		// Close the optimized (second tier) translation, if any
+		if (m_bintr_tiered_dl)
+			dylib_close(m_bintr_tiered_dl, false);
+		m_bintr_tiered_dl = nullptr;
 #endif
 	}
 
@@ -7,36 +7,57 @@
 #include "threaded_rewriter.cpp"
 #include "threaded_bytecodes.hpp"
 #include "util/crc32.hpp"
+#include "util/threadpool.h"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
 #include <inttypes.h>
 #include <mutex>
+#include <tuple>
 #include <unordered_set>
+#if defined(__linux__) || defined(__FreeBSD__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifndef MAP_NORESERVE
+#define MAP_NORESERVE 0
+#endif
+#define RISCV_DECODER_CACHE_FILES
+#endif
 //#define ENABLE_TIMINGS
 struct SegmentKey {
 	uint64_t pc;
 	uint32_t crc;
 	uint64_t arena_size = 0;
+	// Translated code for a guard-paged arena has no load bounds-checks,
+	// so it must never be shared with machines that have a regular arena
+	bool guarded_arena = false;
 
 	template <int W>
-	static SegmentKey from(const riscv::DecodedExecuteSegment<W>& segment, uint64_t arena_size) {
+	static SegmentKey from(const riscv::DecodedExecuteSegment<W>& segment, uint64_t arena_size, bool guarded_arena) {
 		SegmentKey key;
 		key.pc = uint64_t(segment.exec_begin());
 		key.crc = segment.crc32c_hash();
 		key.arena_size = arena_size;
+		key.guarded_arena = guarded_arena;
 		return key;
 	}
 
 	bool operator==(const SegmentKey& other) const {
-		return pc == other.pc && crc == other.crc;
+		return pc == other.pc && crc == other.crc
+			&& arena_size == other.arena_size && guarded_arena == other.guarded_arena;
 	}
 	bool operator<(const SegmentKey& other) const {
-		return pc < other.pc || (pc == other.pc && crc < other.crc);
+		return std::tie(pc, crc, arena_size, guarded_arena)
+			< std::tie(other.pc, other.crc, other.arena_size, other.guarded_arena);
 	}
 };
 namespace std {
 	template <>
 	struct hash<SegmentKey> {
 		size_t operator()(const SegmentKey& key) const {
-			return key.pc ^ key.crc ^ key.arena_size;
+			return key.pc ^ key.crc ^ key.arena_size ^ size_t(key.guarded_arena);
 		}
 	};
 }
@@ -44,6 +65,8 @@ namespace std {
 namespace riscv
 {
 	static constexpr bool VERBOSE_DECODER = false;
+	// Smaller execute segments are decoded faster than threads start
+	static constexpr size_t DECODER_CHUNK_MIN = 64u << 10;
 	static std::mutex handler_idx_mutex;
 #ifdef ENABLE_TIMINGS
 	static inline timespec time_now();
@@ -167,10 +190,12 @@ namespace riscv
 		}
 	}
 
+	// When split_at_end is set the range ends before the execute segment does,
+	// and the last block must fall through into separately decoded code.
 	template <int W>
 	static void realize_fastsim(
 		address_type<W> base_pc, address_type<W> last_pc,
-		const uint8_t* exec_segment, DecoderData<W>* exec_decoder)
+		const uint8_t* exec_segment, DecoderData<W>* exec_decoder, bool split_at_end = false)
 	{
 #ifdef RISCV_BINARY_TRANSLATION
 		const auto translator_op = RV32I_BC_TRANSLATOR;
@@ -239,6 +264,13 @@ namespace riscv
 					// A last test for the last instruction, which should have been a block-ending
 					// instruction. Since it wasn't we must force-end the block here.
 					if (UNLIKELY(pc >= last_pc)) {
+						if (split_at_end) {
+							rv32i_instruction instruction = read_instruction(exec_segment, pc - length, last_pc);
+							entry->set_bytecode(RV32I_BC_FUNCBLOCK);
+							entry->set_invalid_handler(); // Resolve lazily
+							entry->instr = instruction.whole;
+							break;
+						}
 						entry->m_bytecode = 0; // Invalid instruction
 						entry->m_handler = 0;
 						break;
@@ -290,9 +322,11 @@ namespace riscv
 					|| opcode == RV32I_JAL || opcode == RV32I_JALR)
 					idxend = 0;
 			#ifdef RISCV_BINARY_TRANSLATION
-				if (entry.get_bytecode() == translator_op)
+				else if (entry.get_bytecode() == translator_op)
 					idxend = 0;
 			#endif
+				else if (split_at_end && pc == last_pc - 4)
+					idxend = 65535; // Fall through into the next range
 				if (UNLIKELY(idxend == 65535)) {
 					// It's a long sequence of instructions, so end block here.
 					entry.set_bytecode(RV32I_BC_FUNCBLOCK);
@@ -311,6 +345,442 @@ namespace riscv
 		}
 	}
 
+	// Decode instructions from begin, which must be the start of an
+	// instruction, until end. The last instruction may cross end, but
+	// never the execute segment. Returns the address after it.
+	template <int W>
+	static address_type<W> decode_instructions(DecodedExecuteSegment<W>& exec,
+		DecoderData<W>* exec_decoder, address_type<W> begin, address_type<W> end)
+	{
+		// When compressed instructions are enabled, many decoder
+		// entries are illegal because they are between instructions.
+		bool was_full_instruction = true;
+
+		auto* exec_segment = exec.exec_data();
+		const address_type<W> end_addr = exec.exec_end();
+		address_type<W> dst = begin;
+		address_type<W> last = end;
+		for (; dst < end;)
+		{
+			auto& entry = exec_decoder[dst / DecoderData<W>::DIVISOR];
+			entry.m_handler = 0;
+			entry.idxend = 0;
+
+			// Load unaligned instruction from execute segment
+			const auto instruction = read_instruction(
+				exec_segment, dst, end_addr);
+			rv32i_instruction rewritten = instruction;
+
+#ifdef RISCV_BINARY_TRANSLATION
+			// Translator activation uses a special bytecode
+			// but we must still validate the mapping index.
+			if (entry.get_bytecode() == RV32I_BC_TRANSLATOR && entry.is_invalid_handler() && entry.instr < exec.translator_mappings()) {
+				if constexpr (compressed_enabled) {
+					dst += 2;
+					if (was_full_instruction) {
+						was_full_instruction = (instruction.length() == 2);
+					} else {
+						was_full_instruction = true;
+					}
+				} else
+					dst += 4;
+				continue;
+			}
+#endif // RISCV_BINARY_TRANSLATION
+
+			if (!compressed_enabled || was_full_instruction) {
+				// Cache the (modified) instruction bits
+				auto bytecode = CPU<W>::computed_index_for(instruction);
+				// Threaded rewrites are **always** enabled
+				bytecode = exec.threaded_rewrite(bytecode, dst, rewritten);
+				entry.set_bytecode(bytecode);
+				entry.instr = rewritten.whole;
+				if constexpr (compressed_enabled)
+					last = std::max(last, std::min(address_type<W>(dst + instruction.length()), end_addr));
+			} else {
+				// WARNING: If we don't ignore this instruction,
+				// it will get *wrong* idxend values, and cause *invalid jumps*
+				entry.m_handler = 0;
+				entry.set_bytecode(0);
+				// ^ Must be made invalid, even if technically possible to jump to!
+			}
+			if constexpr (VERBOSE_DECODER) {
+				if (entry.get_bytecode() >= RV32I_BC_BEQ && entry.get_bytecode() <= RV32I_BC_BGEU) {
+					fprintf(stderr, "Detected branch bytecode at 0x%lX\n", dst);
+				}
+				if (entry.get_bytecode() == RV32I_BC_BEQ_FW || entry.get_bytecode() == RV32I_BC_BNE_FW) {
+					fprintf(stderr, "Detected forward branch bytecode at 0x%lX\n", dst);
+				}
+			}
+
+			// Increment PC after everything
+			if constexpr (compressed_enabled) {
+				// With compressed we always step forward 2 bytes at a time
+				dst += 2;
+				if (was_full_instruction) {
+					// For it to be a full instruction again,
+					// the length needs to match.
+					was_full_instruction = (instruction.length() == 2);
+				} else {
+					// If it wasn't a full instruction last time, it
+					// will for sure be one now.
+					was_full_instruction = true;
+				}
+			} else
+				dst += 4;
+		}
+		return last;
+	}
+
+	// Decode the execute segment in chunks on a thread pool. Each range is
+	// realized from the first block that begins in its chunk, which is also
+	// where a block begins when decoding on a single thread, and so the
+	// decoder cache is identical. Returns the address after the last instruction.
+	template <int W>
+	static address_type<W> decode_instructions_threaded(DecodedExecuteSegment<W>& exec,
+		DecoderData<W>* exec_decoder, size_t threads)
+	{
+		using address_t = address_type<W>;
+		const address_t begin = exec.exec_begin();
+		const address_t end   = exec.exec_end();
+		const auto* exec_segment = exec.exec_data();
+		const size_t chunk_size = (((end - begin) / threads) + Page::size() - 1) & ~(Page::size() - 1);
+		const size_t n_chunks = (end - begin + chunk_size - 1) / chunk_size;
+
+		struct Chunk {
+			address_t begin;
+			address_t end;
+			address_t first;   // The first instruction that begins in the chunk
+			address_t last;    // The end of the last instruction decoded
+			address_t split;   // The first block that begins in the chunk, or 0
+			address_t next[2]; // Where the length walk leaves the chunk
+			std::exception_ptr error;
+		};
+		std::vector<Chunk> chunks(n_chunks);
+		for (size_t i = 0; i < n_chunks; i++) {
+			chunks[i].begin = begin + i * chunk_size;
+			chunks[i].end = std::min(address_t(chunks[i].begin + chunk_size), end);
+		}
+		ThreadPool pool(std::min(threads, n_chunks));
+		auto run = [&] (auto&& func) {
+			for (auto& chunk : chunks) {
+				pool.enqueue([&chunk, &func] {
+					try {
+						func(chunk);
+					} catch (...) {
+						chunk.error = std::current_exception();
+					}
+				});
+			}
+			pool.wait_until_nothing_in_flight();
+			for (auto& chunk : chunks) {
+				if (chunk.error)
+					std::rethrow_exception(chunk.error);
+			}
+		};
+
+		if constexpr (compressed_enabled) {
+			// A chunk may begin in the middle of an instruction. Walk the
+			// instruction lengths of each chunk from both of its possible
+			// alignments, and then connect the walks from the first chunk.
+			run([&] (Chunk& chunk) {
+				for (unsigned offset = 0; offset < 2; offset++) {
+					address_t pc = chunk.begin + 2 * offset;
+					while (pc < chunk.end)
+						pc += ((const AlignedLoad16 *)&exec_segment[pc])->length();
+					chunk.next[offset] = pc;
+				}
+			});
+			chunks[0].first = begin;
+			for (size_t i = 1; i < n_chunks; i++) {
+				const auto& prev = chunks[i - 1];
+				chunks[i].first = prev.next[(prev.first - prev.begin) / 2];
+			}
+		} else {
+			for (auto& chunk : chunks)
+				chunk.first = chunk.begin;
+		}
+
+		// Decode each chunk, and find the first block-ending instruction
+		run([&] (Chunk& chunk) {
+			chunk.last = decode_instructions<W>(exec, exec_decoder, chunk.first, chunk.end);
+			chunk.split = 0;
+			for (address_t pc = chunk.first; pc < chunk.end; ) {
+				const auto instruction = read_instruction(exec_segment, pc, end);
+				const unsigned length = compressed_enabled ? instruction.length() : 4;
+				pc += length;
+				const unsigned opcode = instruction.opcode();
+				if (length == 2 ? !is_regular_compressed<W>(instruction.half[0])
+					: (opcode == RV32I_BRANCH || opcode == RV32I_SYSTEM
+					|| opcode == RV32I_JAL || opcode == RV32I_JALR)) {
+					chunk.split = pc;
+					break;
+				}
+			}
+		});
+
+		// Realize the blocks from each split until the next one
+		chunks[0].split = begin;
+		const address_t last = chunks.back().last;
+		run([&] (Chunk& chunk) {
+			if (chunk.split == 0)
+				return;
+			address_t range_end = last;
+			for (auto* next = &chunk + 1; next < chunks.data() + n_chunks; next++) {
+				if (next->split != 0) {
+					range_end = next->split;
+					break;
+				}
+			}
+			if (chunk.split < range_end) {
+				realize_fastsim<W>(chunk.split, range_end, exec_segment, exec_decoder);
+				exec.threaded_fuse(exec_decoder, chunk.split, range_end);
+			}
+		});
+		return last;
+	}
+
+	template <int W>
+	struct CompactDecoderCache
+	{
+		static constexpr uint8_t PAGE_DECODED = 0x1;
+		// With compressed instructions a page may begin with the second half
+		// of an instruction, which is found by walking from an earlier page.
+		static constexpr uint8_t PAGE_START_KNOWN  = 0x2;
+		static constexpr uint8_t PAGE_START_MIDDLE = 0x4;
+
+		DecoderData<W>* cache = nullptr;
+		size_t bytes = 0;
+		bool is_mapped = false;
+		address_type<W> page_base = 0;
+		std::vector<uint8_t> pages;
+		size_t decoded = 0;
+		std::mutex mutex;
+
+		~CompactDecoderCache() {
+#if defined(__linux__) || defined(__FreeBSD__)
+			if (is_mapped) {
+				munmap(cache, bytes);
+				return;
+			}
+#endif
+			std::free(cache);
+		}
+	};
+
+	template <int W>
+	DecoderData<W>* DecodedExecuteSegment<W>::create_compact_decoder_cache(size_t size)
+	{
+		auto compact = std::make_shared<CompactDecoderCache<W>>();
+		compact->bytes = size * sizeof(DecoderData<W>);
+#if defined(__linux__) || defined(__FreeBSD__)
+		// Anonymous memory reads as invalid entries, and only the pages
+		// of the decoder cache that get decoded become resident.
+		void* ptr = mmap(NULL, compact->bytes, PROT_READ | PROT_WRITE,
+			MAP_ANONYMOUS | MAP_PRIVATE | MAP_NORESERVE, -1, 0);
+		if (ptr != MAP_FAILED) {
+			compact->cache = (DecoderData<W> *)ptr;
+			compact->is_mapped = true;
+		}
+#endif
+		if (compact->cache == nullptr) {
+			compact->cache = (DecoderData<W> *)std::calloc(size, sizeof(DecoderData<W>));
+			if (compact->cache == nullptr)
+				throw MachineException(OUT_OF_MEMORY, "Out of memory allocating the decoder cache", compact->bytes);
+		}
+		compact->page_base = m_vaddr_begin & ~address_t(Page::size() - 1);
+		compact->pages.resize((m_vaddr_end - compact->page_base + Page::size() - 1) / Page::size());
+		compact->pages.at(0) = CompactDecoderCache<W>::PAGE_START_KNOWN;
+
+		m_decoder_cache_size = size;
+		m_compact = std::move(compact);
+		return m_compact->cache;
+	}
+
+	template <int W>
+	void DecodedExecuteSegment<W>::decode_page(address_t addr)
+	{
+		static constexpr unsigned DIVISOR = DecoderData<W>::DIVISOR;
+		using Compact = CompactDecoderCache<W>;
+		if (m_compact == nullptr || addr < m_vaddr_begin || addr >= m_vaddr_end)
+			return;
+		auto& cc = *m_compact;
+		std::scoped_lock lock(cc.mutex);
+
+		const size_t page = (addr - cc.page_base) / Page::size();
+		if (cc.pages[page] & Compact::PAGE_DECODED)
+			return;
+		auto page_begin = [&] (size_t p) -> address_t {
+			return std::max(address_t(cc.page_base + p * Page::size()), m_vaddr_begin);
+		};
+		const address_t begin = page_begin(page);
+		const address_t end = std::min(address_t(cc.page_base + (page + 1) * Page::size()), m_vaddr_end);
+		const auto* exec_segment = this->exec_data();
+
+		address_t first = begin;
+		if constexpr (compressed_enabled) {
+			// Measuring instruction lengths is much cheaper than decoding
+			size_t p = page;
+			while (!(cc.pages[p] & Compact::PAGE_START_KNOWN))
+				p--;
+			address_t pc = page_begin(p) + ((cc.pages[p] & Compact::PAGE_START_MIDDLE) ? 2 : 0);
+			for (; p < page; p++) {
+				const address_t next = page_begin(p + 1);
+				while (pc < next)
+					pc += ((const AlignedLoad16 *)&exec_segment[pc])->length();
+				cc.pages[p + 1] |= Compact::PAGE_START_KNOWN
+					| ((pc != next) ? Compact::PAGE_START_MIDDLE : 0);
+			}
+			first = pc;
+		}
+
+		if (first < end) {
+			// Decode into a scratch page first, so that other machines sharing
+			// this segment never observe a page with unfinished blocks.
+			std::vector<DecoderData<W>> scratch((end + 4 - begin) / DIVISOR + 1);
+			auto* scratch_decoder = scratch.data() - begin / DIVISOR;
+			const address_t last = decode_instructions<W>(*this, scratch_decoder, first, end);
+			// Blocks never cross into the next page, which is decoded separately
+			realize_fastsim<W>(first, last, exec_segment, scratch_decoder, last < m_vaddr_end);
+			this->threaded_fuse(scratch_decoder, first, last);
+
+			// Publish back to front, so that the rest of a block
+			// is always visible when its first entry is.
+			auto* exec_decoder = this->decoder_cache();
+			for (size_t i = (end - first + DIVISOR - 1) / DIVISOR; i > 0; i--) {
+				const address_t pc = first + (i - 1) * DIVISOR;
+				exec_decoder[pc / DIVISOR].atomic_overwrite(scratch_decoder[pc / DIVISOR]);
+			}
+		}
+		cc.pages[page] |= Compact::PAGE_DECODED;
+		cc.decoded++;
+	}
+
+	template <int W>
+	void DecodedExecuteSegment<W>::set_all_pages_decoded()
+	{
+		std::scoped_lock lock(m_compact->mutex);
+		for (auto& page : m_compact->pages)
+			page |= CompactDecoderCache<W>::PAGE_DECODED;
+		m_compact->decoded = m_compact->pages.size();
+	}
+
+	template <int W>
+	size_t DecodedExecuteSegment<W>::decoded_pages() const noexcept
+	{
+		if (m_compact == nullptr) {
+			const address_t page_base = m_vaddr_begin & ~address_t(Page::size() - 1);
+			return (m_vaddr_end - page_base + Page::size() - 1) / Page::size();
+		}
+		std::scoped_lock lock(m_compact->mutex);
+		return m_compact->decoded;
+	}
+
+#ifdef RISCV_DECODER_CACHE_FILES
+	// A decoder cache file is this header, padded to a page, followed by the
+	// entries, so that the entries can be mapped directly from the file.
+	struct DecoderCacheFileHeader {
+		char     magic[8];
+		uint32_t library_version;
+		uint32_t build_settings;
+		uint32_t entry_size;
+		uint32_t bytecodes;
+		uint64_t exec_begin;
+		uint64_t exec_end;
+		uint64_t entries;
+		uint32_t exec_crc;
+		uint32_t entries_crc; // Not part of the key
+	};
+	static constexpr size_t DECODER_CACHE_FILE_HEADER = 4096;
+	static_assert(sizeof(DecoderCacheFileHeader) <= DECODER_CACHE_FILE_HEADER);
+
+	template <int W>
+	static DecoderCacheFileHeader decoder_cache_file_header(
+		const DecodedExecuteSegment<W>& exec, size_t entries)
+	{
+		DecoderCacheFileHeader header;
+		std::memset(&header, 0, sizeof(header));
+		std::memcpy(header.magic, "RVDECOD1", sizeof(header.magic));
+		header.library_version = (RISCV_VERSION_MAJOR << 16) | RISCV_VERSION_MINOR;
+		// Bytecodes and the instruction rewrites depend on the build
+		header.build_settings = W
+			| (compressed_enabled << 8)
+			| (atomics_enabled << 9)
+			| (binary_translation_enabled << 10)
+			| (vector_extension << 16);
+#ifdef RISCV_ASM_DISPATCH
+		header.build_settings |= 1u << 11;
+#endif
+		header.entry_size = sizeof(DecoderData<W>);
+		header.bytecodes  = BYTECODES_MAX;
+		header.exec_begin = exec.exec_begin();
+		header.exec_end   = exec.exec_end();
+		header.entries    = entries;
+		header.exec_crc   = exec.crc32c_hash();
+		return header;
+	}
+
+	static std::string decoder_cache_filename(const std::string& prefix, const DecoderCacheFileHeader& header)
+	{
+		const uint32_t key = crc32c(&header, offsetof(DecoderCacheFileHeader, entries_crc));
+		char buffer[16];
+		snprintf(buffer, sizeof(buffer), "%08X", key);
+		return prefix + buffer;
+	}
+
+	template <int W>
+	static std::shared_ptr<DecoderData<W>> map_decoder_cache_file(
+		const std::string& filename, const DecoderCacheFileHeader& expected)
+	{
+		const int fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0)
+			return nullptr;
+		const size_t bytes = DECODER_CACHE_FILE_HEADER + expected.entries * sizeof(DecoderData<W>);
+		void* ptr = MAP_FAILED;
+		struct stat st;
+		if (fstat(fd, &st) == 0 && size_t(st.st_size) == bytes) {
+			// Private file pages are shared with other processes until written to
+			ptr = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+		}
+		close(fd);
+		if (ptr == MAP_FAILED)
+			return nullptr;
+
+		std::shared_ptr<DecoderData<W>> cache(
+			(DecoderData<W> *)((uint8_t *)ptr + DECODER_CACHE_FILE_HEADER),
+			[ptr, bytes] (DecoderData<W> *) { munmap(ptr, bytes); });
+		// A different file with the same name, or a damaged file, is ignored
+		const auto* header = (const DecoderCacheFileHeader *)ptr;
+		if (std::memcmp(header, &expected, offsetof(DecoderCacheFileHeader, entries_crc)) != 0
+			|| crc32c(cache.get(), expected.entries * sizeof(DecoderData<W>)) != header->entries_crc)
+			return nullptr;
+		return cache;
+	}
+
+	template <int W>
+	static void store_decoder_cache_file(const std::string& filename,
+		DecoderCacheFileHeader header, const DecoderData<W>* cache)
+	{
+		static std::atomic<unsigned> counter = 0;
+		header.entries_crc = crc32c(cache, header.entries * sizeof(DecoderData<W>));
+		std::vector<uint8_t> padded_header(DECODER_CACHE_FILE_HEADER);
+		std::memcpy(padded_header.data(), &header, sizeof(header));
+
+		// Written under a temporary name and then renamed into place,
+		// so that other processes never map a partial file.
+		const std::string tmpfile = filename + ".tmp" + std::to_string(getpid())
+			+ "-" + std::to_string(counter++);
+		FILE* f = fopen(tmpfile.c_str(), "wb");
+		if (f == nullptr)
+			return;
+		bool success = fwrite(padded_header.data(), padded_header.size(), 1, f) == 1
+			&& fwrite(cache, sizeof(DecoderData<W>), header.entries, f) == header.entries;
+		success = (fclose(f) == 0) && success;
+		if (!success || rename(tmpfile.c_str(), filename.c_str()) != 0)
+			unlink(tmpfile.c_str());
+	}
+#endif // RISCV_DECODER_CACHE_FILES
+
 	// The decoder cache is a sequential array of DecoderData<W> entries
 	// each of which (currently) serves a dual purpose of enabling
 	// threaded dispatch (m_bytecode) and fallback to callback function
@@ -347,15 +817,31 @@ namespace riscv
 				"Program produced empty decoder cache");
 		}
 		// Allocate the flat decoder cache
-		auto* decoder_cache = exec.create_decoder_cache(
-			new DecoderData<W>[n_entries], n_entries);
-		// Clear the decoder cache! (technically only needed when binary translation is enabled)
-		std::memset(decoder_cache, 0, n_entries * sizeof(DecoderData<W>));
+		DecoderData<W>* decoder_cache = nullptr;
+		const bool is_large = options.compact_decoder_cache_threshold != 0
+			&& len >= options.compact_decoder_cache_threshold;
+		if (options.compact_decoder_cache || is_large) {
+			// Each page is decoded when it is first executed
+			decoder_cache = exec.create_compact_decoder_cache(n_entries);
+		} else {
+			decoder_cache = exec.create_decoder_cache(
+				new DecoderData<W>[n_entries], n_entries);
+			// Clear the decoder cache! (technically only needed when binary translation is enabled)
+			std::memset(decoder_cache, 0, n_entries * sizeof(DecoderData<W>));
+		}
 		// Get a base address relative pointer to the decoder cache
 		// Eg. exec_decoder[addr >> SHIFT] is the first valid entry
 		// so that PC with a simple shift can be used as a direct index.
 		auto* exec_decoder = decoder_cache - addr / DecoderData<W>::DIVISOR;
 		exec.set_decoder(exec_decoder);
+		if (options.record_block_profile && !exec.is_likely_jit()) {
+#ifdef RISCV_BLOCK_PROFILE
+			exec.create_block_counters(n_entries, addr / DecoderData<W>::DIVISOR);
+#else
+			throw MachineException(FEATURE_DISABLED,
+				"Recording a block profile requires building with RISCV_BLOCK_PROFILE");
+#endif
+		}
 
 		DecoderData<W> invalid_op;
 		invalid_op.set_handler(this->machine().cpu.decode({0}));
@@ -371,108 +857,80 @@ namespace riscv
 #ifdef RISCV_BINARY_TRANSLATION
 		// We do not support binary translation for RV128I
 		// Also, avoid binary translation for execute segments that are likely JIT-compiled
+		// Compact decoder caches that were asked for are for the interpreter only.
 		const bool allow_translation = is_initial || options.translate_future_segments;
-		if (allow_translation && !exec.is_likely_jit()) {
+		bool must_translate = false;
+		if (allow_translation && !exec.is_likely_jit() && !options.compact_decoder_cache) {
 			// Attempt to load binary translation
 			// Also, fill out the binary translation SO filename for later
 			std::string bintr_filename;
 			int result = machine().cpu.load_translation(options, &bintr_filename, exec);
-			const bool must_translate = result > 0;
+			must_translate = result > 0;
 			if (must_translate)
 			{
 				machine().cpu.try_translate(
 					options, bintr_filename, shared_segment);
 			}
 		}
+		// Translations and live-patching need every block of the segment decoded
+		const bool decode_on_demand = exec.is_compact() && !must_translate && !exec.is_binary_translated();
+	#else
+		[[maybe_unused]] const bool must_translate = false;
+		const bool decode_on_demand = exec.is_compact();
 	#endif
 
-		// When compressed instructions are enabled, many decoder
-		// entries are illegal because they are between instructions.
-		bool was_full_instruction = true;
-
 		/* Generate all instruction pointers for executable code.
 		   Cannot step outside of this area when pregen is enabled,
 		   so it's fine to leave the boundries alone. */
 		TIME_POINT(t2);
-		address_t dst = addr;
-		const address_t end_addr = addr + len;
-		for (; dst < addr + len;)
-		{
-			auto& entry = exec_decoder[dst / DecoderData<W>::DIVISOR];
-			entry.m_handler = 0;
-			entry.idxend = 0;
-
-			// Load unaligned instruction from execute segment
-			const auto instruction = read_instruction(
-				exec_segment, dst, end_addr);
-			rv32i_instruction rewritten = instruction;
-
-#ifdef RISCV_BINARY_TRANSLATION
-			// Translator activation uses a special bytecode
-			// but we must still validate the mapping index.
-			if (entry.get_bytecode() == RV32I_BC_TRANSLATOR && entry.is_invalid_handler() && entry.instr < exec.translator_mappings()) {
-				if constexpr (compressed_enabled) {
-					dst += 2;
-					if (was_full_instruction) {
-						was_full_instruction = (instruction.length() == 2);
-					} else {
-						was_full_instruction = true;
-					}
-				} else
-					dst += 4;
-				continue;
+		bool decode_now = !decode_on_demand;
+#ifdef RISCV_DECODER_CACHE_FILES
+		// A decoder cache file replaces decoding, and large segments
+		// are decoded up front so that they can be stored.
+		const bool use_cache_file = !options.decoder_cache_prefix.empty()
+			&& !options.compact_decoder_cache && !exec.is_likely_jit()
+			&& !must_translate && !exec.is_binary_translated();
+		DecoderCacheFileHeader file_header;
+		std::string cache_filename;
+		if (use_cache_file) {
+			file_header = decoder_cache_file_header(exec, n_entries);
+			cache_filename = decoder_cache_filename(options.decoder_cache_prefix, file_header);
+			if (auto mapped = map_decoder_cache_file<W>(cache_filename, file_header)) {
+				decoder_cache = exec.create_mapped_decoder_cache(std::move(mapped), n_entries);
+				exec_decoder = decoder_cache - addr / DecoderData<W>::DIVISOR;
+				exec.set_decoder(exec_decoder);
 			}
-#endif // RISCV_BINARY_TRANSLATION
-
-			if (!compressed_enabled || was_full_instruction) {
-				// Cache the (modified) instruction bits
-				auto bytecode = CPU<W>::computed_index_for(instruction);
-				// Threaded rewrites are **always** enabled
-				bytecode = exec.threaded_rewrite(bytecode, dst, rewritten);
-				entry.set_bytecode(bytecode);
-				entry.instr = rewritten.whole;
+			decode_now = !exec.is_decoder_cache_mapped();
+		}
+#endif
+		if (decode_now)
+		{
+			size_t threads = options.decoder_cache_threads;
+			if (threads == 0)
+				threads = std::min<size_t>(std::thread::hardware_concurrency(), len / DECODER_CHUNK_MIN);
+			if (threads > 1) {
+				decode_instructions_threaded<W>(exec, exec_decoder, threads);
 			} else {
-				// WARNING: If we don't ignore this instruction,
-				// it will get *wrong* idxend values, and cause *invalid jumps*
-				entry.m_handler = 0;
-				entry.set_bytecode(0);
-				// ^ Must be made invalid, even if technically possible to jump to!
-			}
-			if constexpr (VERBOSE_DECODER) {
-				if (entry.get_bytecode() >= RV32I_BC_BEQ && entry.get_bytecode() <= RV32I_BC_BGEU) {
-					fprintf(stderr, "Detected branch bytecode at 0x%lX\n", dst);
-				}
-				if (entry.get_bytecode() == RV32I_BC_BEQ_FW || entry.get_bytecode() == RV32I_BC_BNE_FW) {
-					fprintf(stderr, "Detected forward branch bytecode at 0x%lX\n", dst);
-				}
+				const address_t dst = decode_instructions<W>(exec, exec_decoder, addr, addr + len);
+				realize_fastsim<W>(addr, dst, exec_segment, exec_decoder);
+				// Superinstructions need the final block boundaries
+				exec.threaded_fuse();
 			}
-
-			// Increment PC after everything
-			if constexpr (compressed_enabled) {
-				// With compressed we always step forward 2 bytes at a time
-				dst += 2;
-				if (was_full_instruction) {
-					// For it to be a full instruction again,
-					// the length needs to match.
-					was_full_instruction = (instruction.length() == 2);
-				} else {
-					// If it wasn't a full instruction last time, it
-					// will for sure be one now.
-					was_full_instruction = true;
-				}
-			} else
-				dst += 4;
+			// Make sure the last entry is an invalid instruction
+			// This simplifies many other sub-systems
+			auto& entry = exec_decoder[(addr + len) / DecoderData<W>::DIVISOR];
+			entry.set_bytecode(0);
+			entry.m_handler = 0;
+			entry.idxend = 0;
+			if (exec.is_compact())
+				exec.set_all_pages_decoded();
+#ifdef RISCV_DECODER_CACHE_FILES
+			if (use_cache_file)
+				store_decoder_cache_file<W>(cache_filename, file_header, decoder_cache);
+#endif
 		}
-		// Make sure the last entry is an invalid instruction
-		// This simplifies many other sub-systems
-		auto& entry = exec_decoder[(addr + len) / DecoderData<W>::DIVISOR];
-		entry.set_bytecode(0);
-		entry.m_handler = 0;
-		entry.idxend = 0;
 		TIME_POINT(t3);
 
-		realize_fastsim<W>(addr, dst, exec_segment, exec_decoder);
-
 		// Debugging: EBREAK locations
 		for (auto& loc : options.ebreak_locations) {
 			address_t addr = 0;
@@ -566,7 +1024,8 @@ namespace riscv
 		if (options.use_shared_execute_segments)
 		{
 			// We have to key on the base address of the execute segment as well as the hash
-			const SegmentKey key{uint64_t(current_exec->exec_begin()), hash, memory_arena_size()};
+			const SegmentKey key{uint64_t(current_exec->exec_begin()), hash, memory_arena_size(),
+				uses_guard_paged_arena()};
 
 			// In order to prevent others from creating the same execute segment
 			// we need to lock the shared execute segments mutex.
@@ -636,7 +1095,7 @@ namespace riscv
 
 		auto& main_segment = m_main_exec_segment;
 		if (main_segment) {
-			const SegmentKey key = SegmentKey::from(*main_segment, memory_arena_size());
+			const SegmentKey key = SegmentKey::from(*main_segment, memory_arena_size(), uses_guard_paged_arena());
 			main_segment = nullptr;
 			shared_execute_segments<W>.remove_if_unique(key);
 		}
@@ -645,7 +1104,7 @@ namespace riscv
 			try {
 				auto& segment = m_exec.back();
 				if (segment) {
-					const SegmentKey key = SegmentKey::from(*segment, memory_arena_size());
+					const SegmentKey key = SegmentKey::from(*segment, memory_arena_size(), uses_guard_paged_arena());
 					segment = nullptr;
 					shared_execute_segments<W>.remove_if_unique(key);
 				}
@@ -659,7 +1118,7 @@ namespace riscv
 	template <int W>
 	void Memory<W>::evict_execute_segment(DecodedExecuteSegment<W>& segment)
 	{
-		const SegmentKey key = SegmentKey::from(segment, memory_arena_size());
+		const SegmentKey key = SegmentKey::from(segment, memory_arena_size(), uses_guard_paged_arena());
 		for (auto& seg : m_exec) {
 			if (seg.get() == &segment) {
 				seg = nullptr;
@@ -693,8 +1152,87 @@ namespace riscv
 #  endif // RISCV_DEBUG
 		return result;
 	}
+
+	template <int W>
+	std::vector<std::pair<address_type<W>, uint32_t>> Memory<W>::gather_block_profile() const
+	{
+		std::vector<std::pair<address_t, uint32_t>> result;
+		auto gather = [&result] (const DecodedExecuteSegment<W>& segment) {
+			const auto* counters = segment.block_counters_base();
+			if (counters == nullptr)
+				return;
+			const address_t base = segment.exec_begin() / DecoderData<W>::DIVISOR;
+			for (size_t i = 0; i < segment.decoder_cache_size(); i++) {
+				if (counters[i] != 0)
+					result.emplace_back((base + i) * DecoderData<W>::DIVISOR, counters[i]);
+			}
+		};
+		if (m_main_exec_segment)
+			gather(*m_main_exec_segment);
+		for (auto& segment : m_exec) {
+			if (segment)
+				gather(*segment);
+		}
+		// Hottest blocks first
+		std::stable_sort(result.begin(), result.end(),
+			[] (const auto& a, const auto& b) { return a.second > b.second; });
+		return result;
+	}
 #endif
 
+	template <int W>
+	std::vector<typename Memory<W>::InstructionPair> Memory<W>::gather_instruction_pairs() const
+	{
+		std::unordered_map<std::string, InstructionPair> pairs;
+		const auto& cpu = machine().cpu;
+		auto mnemonic = [&cpu] (rv32i_instruction instr) {
+			char buffer[128];
+			const int len = CPU<W>::decode(instr).printer(buffer, sizeof(buffer), cpu, instr);
+			const std::string_view text(buffer, std::max(0, std::min(len, int(sizeof(buffer)) - 1)));
+			return std::string(text.substr(0, text.find(' ')));
+		};
+		auto gather = [&] (const DecodedExecuteSegment<W>& segment) {
+			const auto* exec_decoder = segment.decoder_cache();
+			const auto* exec_data = segment.exec_data();
+			const address_t end = segment.exec_end();
+			address_t pc = segment.exec_begin();
+			while (pc < end) {
+				const auto instr = read_instruction(exec_data, pc, end);
+				const unsigned length = compressed_enabled ? instr.length() : 4;
+				const auto& entry = exec_decoder[pc / DecoderData<W>::DIVISOR];
+				// Only pairs where both instructions are in the same block
+				if (entry.get_bytecode() != RV32I_BC_INVALID && entry.block_bytes() != 0
+					&& pc + length < end)
+				{
+					const auto next = read_instruction(exec_data, pc + length, end);
+					auto& pair = pairs[mnemonic(instr) + "+" + mnemonic(next)];
+					pair.count++;
+					pair.fused += is_fused_bytecode(entry.get_bytecode());
+				}
+				pc += length;
+			}
+		};
+		if (m_main_exec_segment)
+			gather(*m_main_exec_segment);
+		for (auto& segment : m_exec) {
+			if (segment && segment != m_main_exec_segment)
+				gather(*segment);
+		}
+
+		std::vector<InstructionPair> result;
+		result.reserve(pairs.size());
+		for (auto& it : pairs) {
+			it.second.name = it.first;
+			result.push_back(std::move(it.second));
+		}
+		// Most common pairs first
+		std::sort(result.begin(), result.end(),
+			[] (const auto& a, const auto& b) {
+				return a.count > b.count || (a.count == b.count && a.name < b.name);
+			});
+		return result;
+	}
+
 #ifdef ENABLE_TIMINGS
 	timespec time_now()
 	{
@@ -708,6 +1246,18 @@ namespace riscv
 	}
 #endif
 
+#ifdef RISCV_32I
+	template void DecodedExecuteSegment<4>::decode_page(address_type<4>);
+	template size_t DecodedExecuteSegment<4>::decoded_pages() const noexcept;
+#endif
+#ifdef RISCV_64I
+	template void DecodedExecuteSegment<8>::decode_page(address_type<8>);
+	template size_t DecodedExecuteSegment<8>::decoded_pages() const noexcept;
+#endif
+#ifdef RISCV_128I
+	template void DecodedExecuteSegment<16>::decode_page(address_type<16>);
+	template size_t DecodedExecuteSegment<16>::decoded_pages() const noexcept;
+#endif
 	INSTANTIATE_32_IF_ENABLED(DecoderData);
 	INSTANTIATE_32_IF_ENABLED(Memory);
 	INSTANTIATE_64_IF_ENABLED(DecoderData);
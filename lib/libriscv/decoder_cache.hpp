@@ -1,6 +1,7 @@
 #pragma once
 #include "common.hpp"
 #include "types.hpp"
+#include "threaded_bytecodes.hpp"
 #include <unordered_map>
 #include <vector>
 
@@ -72,6 +73,10 @@ struct DecoderData {
 			instr == other.instr;
 	}
 
+	// Superinstructions also execute the following instruction. Undo
+	// any that include the instruction at addr before it gets changed.
+	static void unfuse_at(DecoderData<W>* exec_decoder, address_type<W> exec_begin, address_type<W> addr) noexcept;
+
 	static size_t handler_index_for(Handler new_handler);
 	static Handler* get_handlers() noexcept {
 		return &instr_handlers[0];
@@ -87,4 +92,13 @@ private:
 	static inline std::unordered_map<Handler, size_t> handler_cache;
 };
 
+template <int W>
+inline void DecoderData<W>::unfuse_at(DecoderData<W>* exec_decoder, address_type<W> exec_begin, address_type<W> addr) noexcept
+{
+	for (unsigned back = 0; back <= 4 && addr - exec_begin >= back; back += DIVISOR) {
+		auto& entry = exec_decoder[(addr - back) / DIVISOR];
+		entry.m_bytecode = unfused_bytecode(entry.m_bytecode);
+	}
+}
+
 }
@@ -81,7 +81,8 @@ static void syscall_epoll_pwait(Machine<W>& machine)
 	const auto g_events = machine.sysarg(1);
 	auto maxevents = machine.template sysarg<int>(2);
 	auto timeout = machine.template sysarg<int>(3);
-	if (timeout < 0 || timeout > 1) timeout = 1;
+	const bool async = machine.has_file_descriptors() && machine.fds().async_syscalls;
+	if (!async && (timeout < 0 || timeout > 1)) timeout = 1;
 
 	std::array<struct epoll_event, 4096> events;
 	if (maxevents < 0 || maxevents > (int)events.size()) {
@@ -92,6 +93,15 @@ static void syscall_epoll_pwait(Machine<W>& machine)
 
 	if (machine.has_file_descriptors()) {
 		real_fd = machine.fds().translate(vepoll_fd);
+		if (async) {
+			// The epoll FD itself becomes readable when events are ready
+			struct pollfd pfd { real_fd, POLLIN, 0 };
+			if (real_fd >= 0 && !async_syscall_ready(machine, &pfd, 1, timeout)) {
+				SYSPRINT("SYSCALL epoll_pwait, epoll_fd: %d is pending\n", vepoll_fd);
+				return;
+			}
+			timeout = 0;
+		}
 
 		const int res = epoll_wait(real_fd, events.data(), maxevents, timeout);
 		if (res > 0) {
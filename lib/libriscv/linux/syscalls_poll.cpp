@@ -55,6 +55,17 @@ static void syscall_ppoll(Machine<W>& machine)
 			linux_fds[i].fd = machine.fds().translate(fds[i].fd);
 		}
 
+		if (machine.fds().async_syscalls) {
+			// A NULL timeout waits forever
+			const int64_t timeout_ms = (g_ts != 0) ?
+				int64_t(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000 : -1;
+			if (!async_syscall_ready(machine, linux_fds.data(), nfds, timeout_ms)) {
+				SYSPRINT("SYSCALL ppoll, nfds: %u is pending\n", nfds);
+				return;
+			}
+			ts = {};
+		}
+
 	    const int res = poll_with_timeout(linux_fds.data(), nfds, &ts);
 		// The ppoll system call modifies TS
 		//clock_gettime(CLOCK_MONOTONIC, &ts);
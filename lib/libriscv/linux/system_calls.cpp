@@ -27,6 +27,8 @@ extern "C" int dup3(int oldfd, int newfd, int flags);
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/uio.h>
+#include <poll.h>
+#include <chrono>
 #if __has_include(<termios.h>)
 #include <termios.h>
 #endif
@@ -74,6 +76,46 @@ static int get_time(int clkid, struct timespec *ts)
 }
 #endif
 
+static int64_t async_now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Asynchronous system calls: Returns true when the system call can
+// proceed without blocking, either because one of the FDs is ready, or
+// because the deadline has passed. Otherwise the machine is stopped with
+// a pending wait, and the ECALL is rewound so that it restarts on resume.
+template <int W>
+static bool async_syscall_ready(Machine<W>& machine, struct pollfd* pfds, size_t count, int64_t timeout_ms)
+{
+	auto& wait = machine.fds().pending_wait;
+	const int sysno = machine.cpu.reg(REG_ECALL);
+	const uint64_t pc = machine.cpu.pc();
+	// A restarted system call keeps the deadline it was suspended with
+	int64_t deadline = -1;
+	if (wait.sysno == sysno && wait.pc == pc)
+		deadline = wait.deadline;
+	else if (timeout_ms >= 0)
+		deadline = async_now() + timeout_ms * 1'000'000;
+	machine.fds().clear_pending_wait();
+
+	if (poll(pfds, count, 0) != 0 || (deadline >= 0 && async_now() >= deadline))
+		return true;
+
+	for (size_t i = 0; i < count; i++) {
+		if (pfds[i].fd >= 0)
+			wait.fds.push_back({pfds[i].fd, pfds[i].events});
+	}
+	wait.deadline = deadline;
+	wait.sysno = sysno;
+	wait.pc = pc;
+	// We have to jump to ECALL-4 because we are mid-instruction
+	machine.cpu.jump(pc - 4);
+	machine.stop();
+	return false;
+}
+
 template <int W>
 static void syscall_stub_zero(Machine<W>& machine) {
 	SYSPRINT("SYSCALL stubbed (zero): %d\n", (int)machine.cpu.reg(17));
@@ -223,21 +265,18 @@ static void syscall_read(Machine<W>& machine)
 		vfd, (long)address, len);
 	// We have special stdin handling
 	if (vfd == 0) {
-		// Arbitrary maximum read length
-		if (len > 1024 * 1024 * 16) {
-			machine.set_result(-ENOMEM);
-			return;
-		}
-		// TODO: We can use gather buffers here to avoid the copy
-		auto buffer = std::unique_ptr<char[]> (new char[len]);
-		long result = machine.stdin_read(buffer.get(), len);
-		if (result > 0) {
-			machine.copy_to_guest(address, buffer.get(), result);
-		}
-		machine.set_result_or_error(result);
+		// Stdin is read directly into guest memory
+		machine.set_result_or_error(machine.stdin_read_into(address, len));
 		return;
 	} else if (machine.has_file_descriptors()) {
 		const int real_fd = machine.fds().translate(vfd);
+		if (machine.fds().async_syscalls && real_fd >= 0) {
+			struct pollfd pfd { real_fd, POLLIN, 0 };
+			if (!async_syscall_ready(machine, &pfd, 1, -1)) {
+				SYSPRINT("SYSCALL read, vfd: %d is pending\n", vfd);
+				return;
+			}
+		}
 
 		std::array<riscv::vBuffer, 512> buffers;
 		size_t cnt =
@@ -306,11 +345,9 @@ static void syscall_write(Machine<W>& machine)
 	std::array<riscv::vBuffer, 64> buffers;
 
 	if (vfd == 1 || vfd == 2) {
-		size_t cnt =
+		const size_t cnt =
 			machine.memory.gather_buffers_from_range(buffers.size(), buffers.data(), address, len);
-		for (size_t i = 0; i < cnt; i++) {
-			machine.print(buffers[i].ptr, buffers[i].len);
-		}
+		machine.printv(buffers.data(), cnt);
 		machine.set_result(len);
 	} else if (machine.has_file_descriptors() && machine.fds().permit_write(vfd)) {
 		int real_fd = machine.fds().translate(vfd);
@@ -347,6 +384,13 @@ static void syscall_readv(Machine<W>& machine)
 	if (real_fd < 0) {
 		machine.set_result(-EBADF);
 	} else {
+		if (machine.fds().async_syscalls) {
+			struct pollfd pfd { real_fd, POLLIN, 0 };
+			if (!async_syscall_ready(machine, &pfd, 1, -1)) {
+				SYSPRINT("SYSCALL readv, vfd: %d is pending\n", vfd);
+				return;
+			}
+		}
 		const size_t iov_size = sizeof(guest_iovec<W>) * count;
 
 		// Retrieve the guest IO vec
@@ -414,10 +458,9 @@ static void syscall_writev(Machine<W>& machine)
 		ssize_t res = 0;
 		if (real_fd == 1 || real_fd == 2) {
 			// STDOUT, STDERR
-			for (size_t i = 0; i < vec_cnt; i++) {
-				machine.print(buffers[i].ptr, buffers[i].len);
+			machine.printv(buffers.data(), vec_cnt);
+			for (size_t i = 0; i < vec_cnt; i++)
 				res += buffers[i].len;
-			}
 		} else {
 			// General file descriptor
 			res = writev(real_fd, (const struct iovec *)buffers.data(), vec_cnt);
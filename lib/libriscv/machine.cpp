@@ -1,6 +1,9 @@
 #include "machine.hpp"
 #include "internal_common.hpp"
 #include "native_heap.hpp"
+#ifdef RISCV_MULTIPROCESS
+#include "multiprocessing.hpp"
+#endif
 #include "rv32i_instr.hpp"
 #include "threads.hpp"
 #include "util/auxvec.hpp"
@@ -61,6 +64,34 @@ namespace riscv
 	template <int W>
 	Machine<W>::~Machine()
 	{
+#ifdef RISCV_MULTIPROCESS
+		// Harts share our memory, so they must stop first
+		if (m_smp != nullptr) {
+			this->multiprocess_stop();
+			this->multiprocess_wait();
+		}
+#endif
+	}
+
+	template <int W>
+	void Machine<W>::reset_to(const Machine& master)
+	{
+		memory.reset_to(master.memory);
+
+		// Copy all registers except vectors, just like forking does
+		cpu.registers().copy_from(Registers<W>::Options::NoVectors, master.cpu.registers());
+		cpu.set_execute_segment(master.cpu.current_execute_segment());
+
+		this->m_counter = master.m_counter;
+		this->m_max_counter = master.m_max_counter;
+		if (master.m_mt) {
+			m_mt.reset(new MultiThreading {*this, *master.m_mt});
+		} else {
+			m_mt = nullptr;
+		}
+		if (master.m_arena) {
+			this->transfer_arena_from(master);
+		}
 	}
 
 	template <int W>
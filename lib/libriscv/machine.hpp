@@ -36,6 +36,9 @@ namespace riscv
 		using address_t = address_type<W>; // one unsigned memory address
 		using printer_func = void(*)(const Machine&, const char*, size_t);
 		using stdin_func = long(*)(const Machine&, char*, size_t);
+		// Scatter-gather stdout and stdin: The buffers point directly into guest memory
+		using printv_func = void(*)(const Machine&, const vBuffer*, size_t);
+		using stdin_readv_func = long(*)(const Machine&, const vBuffer*, size_t);
 		using rdtime_func = uint64_t(*)(const Machine&);
 
 		/// The machine takes the binary as a const reference and does not
@@ -313,10 +316,30 @@ namespace riscv
 		void print(const char*, size_t) const;
 		auto& get_printer() const noexcept { return m_printer; }
 		void set_printer(printer_func pf = default_printer) noexcept { m_printer = pf; }
+		/// @brief Print guest memory buffers without copying them. Calls the
+		/// scatter-gather printer once, or the printer once for each buffer
+		/// when no scatter-gather printer is set.
+		void printv(const vBuffer*, size_t cnt) const;
+		auto& get_printv() const noexcept { return m_printv; }
+		void set_printv(printv_func pf = nullptr) noexcept { m_printv = pf; }
 		// Stdin (for when the guest wants to read)
 		long stdin_read(char*, size_t) const;
 		auto& get_stdin() const noexcept { return m_stdin; }
 		void set_stdin(stdin_func sin = default_stdin) noexcept { m_stdin = sin; }
+		/// @brief Read stdin directly into guest memory buffers. Calls the
+		/// scatter-gather stdin once, or otherwise the stdin function for
+		/// each buffer in turn, until it reads less than the buffer length.
+		/// @return The total bytes read, or a negative error.
+		long stdin_readv(const vBuffer*, size_t cnt) const;
+		/// @brief Read stdin directly into guest memory, as read() does for fd 0.
+		/// Reads at most 16MB, and stops at the end of the arena or when the
+		/// range needs too many buffers, so the result may be a short read.
+		/// In the flat arena only the bytes that were read are marked dirty,
+		/// while gathered pages are marked dirty as a whole.
+		/// @return The bytes read, or a negative error.
+		long stdin_read_into(address_t dst, size_t len);
+		auto& get_stdin_readv() const noexcept { return m_stdin_readv; }
+		void set_stdin_readv(stdin_readv_func sin = nullptr) noexcept { m_stdin_readv = sin; }
 		// Monotonic time function (used by RDTIME and RDTIMEH)
 		uint64_t rdtime() const { return m_rdtime(*this); }
 		auto& get_rdtime() const noexcept { return m_rdtime; }
@@ -405,6 +428,43 @@ namespace riscv
 		// Globally register a system call that clobbers all registers
 		static void register_clobbering_syscall(size_t sysnum);
 		static bool is_clobbering_syscall(size_t sysnum) noexcept;
+#ifdef RISCV_MULTIPROCESS
+		/// @brief Start harts that call a guest function in parallel, each
+		/// on its own host thread. Hart N (1..num_harts) calls func(N, arg)
+		/// on its own stack, and the hart stops when the function returns.
+		/// The harts are forks that share the flat read-write arena with
+		/// this machine, so memory outside of the arena is not shared, and
+		/// only this machine should map or unmap memory. This machine is
+		/// hart 0, and it may keep running while the harts are working.
+		/// @param num_harts The number of harts to start.
+		/// @param max_instructions The instruction limit of each hart.
+		/// @param func The guest function each hart calls.
+		/// @param arg The second argument to the function.
+		/// @param stack_base The lowest address of the hart stacks.
+		/// @param stack_size The stack size of each hart.
+		void multiprocess(unsigned num_harts, uint64_t max_instructions,
+			address_t func, address_t arg, address_t stack_base, address_t stack_size);
+		/// @brief Wait for all harts started by multiprocess() to stop.
+		/// @return A bitmask of the harts that did not return normally, where
+		/// bit N-1 is hart N. Zero when every hart returned from its function.
+		unsigned long multiprocess_wait();
+		/// @brief Ask all harts to stop, even those waiting on a futex. Harts
+		/// check for this between instruction quanta and while waiting.
+		/// Harts that have not returned yet are reported as failures by
+		/// multiprocess_wait(), which must still be called.
+		void multiprocess_stop() noexcept;
+		/// @brief Check if harts may be running in parallel. Also true in the harts.
+		/// While multiprocessing, futexes wait and wake on the host, and when
+		/// every hart is waiting on hart 0, which is itself waiting, the harts
+		/// are stopped (and hart 0 stops with a deadlock exception).
+		bool is_multiprocessing() const noexcept;
+		// Multiprocessing: Access to the state shared by hart 0 and its harts
+		Multiprocessing<W>& smp();
+		/// @brief Install guest system calls for multiprocessing:
+		/// syscall_base+0: multiprocess(num_harts, func, arg, stack_base, stack_size)
+		/// syscall_base+1: multiprocess_wait() returning the failure bitmask
+		static void setup_multiprocessing(size_t syscall_base);
+#endif
 		// Threads: Access to thread internal structures
 		const MultiThreading<W>& threads() const;
 		MultiThreading<W>& threads();
@@ -425,6 +485,20 @@ namespace riscv
 		// quickly creating and destroying a machine.
 		void reset();
 
+		/// @brief Rolls a fork back to the state of the machine it was forked
+		/// from, so that it can be reused instead of creating a new fork. Only the
+		/// pages the fork has touched since it was created (or last reset) are
+		/// restored, along with registers, counters, the private arena view,
+		/// mmap and heap state, and threads.
+		/// @param master The machine this machine was forked from. The master
+		/// must not have been modified since the fork was created.
+		/// @note Writes to a shared flat arena cannot be rolled back. Use
+		/// MachineOptions::use_forkable_memory_arena on the master to give forks
+		/// a private arena view. File descriptors and signals are left as-is.
+		/// An existing native heap takes the master's allocations, but keeps
+		/// its on_unknown_free() and on_unknown_realloc() handlers.
+		void reset_to(const Machine& master);
+
 		/// @brief Serializes the current machine state into a vector
 		/// @param vec The vector to serialize into (append)
 		/// @return Returns the total number of serialized bytes
@@ -438,6 +512,37 @@ namespace riscv
 		/// @return Returns 0 on success, otherwise a non-zero integer
 		int deserialize_from(const std::vector<uint8_t>& vec);
 
+		/// @brief Serializes the machine state as an incremental snapshot, which
+		/// only stores the pages whose contents differ from a base snapshot. Pages
+		/// are identified by a hash of their contents, and unlike serialize_to()
+		/// the flat memory arena is included. Deltas can be chained, with each
+		/// delta using the previous snapshot as its base.
+		/// @param vec The vector to serialize into (append)
+		/// @param base The snapshot to compare against, or nullptr for a full snapshot
+		/// @param use_dirty_pages Avoid hashing arena pages that are not marked
+		/// dirty, assuming they are unchanged since base. Requires that dirty pages
+		/// were cleared when base was taken (see MachineOptions::track_dirty_pages).
+		/// @return Returns the total number of serialized bytes
+		size_t serialize_delta_to(std::vector<uint8_t>& vec,
+			const std::vector<uint8_t>* base = nullptr, bool use_dirty_pages = false) const;
+
+		/// @brief Returns the machine to a state stored by serialize_delta_to().
+		/// The same notes as deserialize_from() apply.
+		/// @param chain The full snapshot followed by each delta, oldest first
+		/// @param threads The number of threads used to copy page data
+		/// @return Returns 0 on success, otherwise a non-zero integer
+		int deserialize_delta_from(const std::vector<const std::vector<uint8_t>*>& chain, unsigned threads = 1);
+
+		/// @brief Returns the machine to a full snapshot (made by serialize_delta_to()
+		/// without a base) stored in a file, by memory-mapping the file instead of
+		/// copying it. Pages point straight into the mapping and are copied on the
+		/// first write, so restoring costs O(pages touched), and processes restoring
+		/// the same file share its page cache. The file must not be modified while
+		/// in use. The same notes as deserialize_from() apply.
+		/// @param filename The snapshot file, starting with the snapshot header
+		/// @return Returns 0 on success, otherwise a non-zero integer
+		int deserialize_mapped_from(const std::string& filename);
+
 		std::pair<uint64_t&, uint64_t&> get_counters() noexcept { return {m_counter, m_max_counter}; }
 		template <bool Throw = true>
 		bool simulate_with(uint64_t max_instructions, uint64_t counter, address_t pc);
@@ -452,12 +557,18 @@ namespace riscv
 		mutable void*        m_userdata = nullptr;
 		mutable printer_func m_printer = default_printer;
 		mutable stdin_func   m_stdin = default_stdin;
+		mutable printv_func  m_printv = nullptr;
+		mutable stdin_readv_func m_stdin_readv = nullptr;
 		mutable rdtime_func  m_rdtime = default_rdtime;
 		std::unique_ptr<Arena> m_arena;
 		std::unique_ptr<MultiThreading<W>> m_mt = nullptr;
 		std::unique_ptr<FileDescriptors> m_fds = nullptr;
 		std::unique_ptr<Signals<W>> m_signals = nullptr;
 		std::shared_ptr<MachineOptions<W>> m_options = nullptr;
+#ifdef RISCV_MULTIPROCESS
+		std::unique_ptr<Multiprocessing<W>> m_smp = nullptr;
+		Multiprocessing<W>* m_hart_smp = nullptr; // Harts: owned by hart 0
+#endif
 
 		static_assert((W == 4 || W == 8 || W == 16), "Must be either 32-bit, 64-bit or 128-bit ISA");
 		static void default_printer(const Machine&, const char*, size_t);
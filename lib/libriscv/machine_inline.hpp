@@ -16,7 +16,13 @@ template <int W>
 template <bool Throw>
 inline bool Machine<W>::simulate_with(uint64_t max_instr, uint64_t counter, address_t pc)
 {
-	const bool stopped_normally = cpu.simulate(pc, counter, max_instr);
+	bool stopped_normally;
+#ifdef RISCV_BINARY_TRANSLATION
+	if (UNLIKELY(memory.uses_guard_paged_arena()))
+		stopped_normally = cpu.simulate_guarded(pc, counter, max_instr);
+	else
+#endif
+	stopped_normally = cpu.simulate(pc, counter, max_instr);
 	if constexpr (Throw) {
 		// The simulation either ends normally, or it throws an exception
 		if (UNLIKELY(!stopped_normally))
@@ -56,10 +62,66 @@ inline void Machine<W>::print(const char* buffer, size_t len) const
 	this->m_printer(*this, buffer, len);
 }
 template <int W>
+inline void Machine<W>::printv(const vBuffer* buffers, size_t cnt) const
+{
+	if (this->m_printv != nullptr) {
+		this->m_printv(*this, buffers, cnt);
+		return;
+	}
+	for (size_t i = 0; i < cnt; i++)
+		this->m_printer(*this, buffers[i].ptr, buffers[i].len);
+}
+template <int W>
 inline long Machine<W>::stdin_read(char* buffer, size_t len) const
 {
 	return this->m_stdin(*this, buffer, len);
 }
+template <int W>
+inline long Machine<W>::stdin_readv(const vBuffer* buffers, size_t cnt) const
+{
+	if (this->m_stdin_readv != nullptr)
+		return this->m_stdin_readv(*this, buffers, cnt);
+
+	long total = 0;
+	for (size_t i = 0; i < cnt; i++) {
+		const long result = this->m_stdin(*this, buffers[i].ptr, buffers[i].len);
+		if (result < 0)
+			return (total > 0) ? total : result;
+		total += result;
+		// A short read ends the read, just like readv()
+		if ((size_t)result < buffers[i].len)
+			break;
+	}
+	return total;
+}
+
+template <int W>
+inline long Machine<W>::stdin_read_into(address_t dst, size_t len)
+{
+	// An arbitrary maximum, as read() may always return less
+	static constexpr size_t STDIN_READ_MAX = 16ul << 20;
+	len = std::min(len, STDIN_READ_MAX);
+
+	std::array<vBuffer, 256> buffers;
+	if (memory.uses_flat_memory_arena()
+		&& dst >= memory.initial_rodata_end() && dst < memory.memory_arena_size())
+	{
+		// Stop at the end of the arena
+		len = std::min(len, size_t(memory.memory_arena_size() - dst));
+		buffers[0].ptr = (char *)memory.memory_arena_ptr() + dst;
+		buffers[0].len = len;
+		// Only the bytes actually read are marked dirty
+		const long result = this->stdin_readv(buffers.data(), 1);
+		if (result > 0)
+			memory.mark_dirty_range(dst, result);
+		return result;
+	}
+	// Never gather more pages than there are buffers. Gathering writable
+	// pages has already marked the whole range dirty.
+	len = std::min(len, buffers.size() * Page::size() - (dst & (Page::size() - 1)));
+	const size_t cnt = memory.gather_writable_buffers_from_range(buffers.size(), buffers.data(), dst, len);
+	return this->stdin_readv(buffers.data(), cnt);
+}
 
 template <int W> inline
 void Machine<W>::install_syscall_handler(size_t sysn, syscall_t handler)
@@ -50,6 +50,11 @@ inline address_type<W> Machine<W>::vmcall(address_t pc, Args&&... args)
 	this->setup_call(std::forward<Args>(args)...);
 	// execute guest function
 	if constexpr (MAXI == UINT64_MAX || MAXI == 0u) {
+#ifdef RISCV_BINARY_TRANSLATION
+		if (UNLIKELY(memory.uses_guard_paged_arena()))
+			this->cpu.simulate_guarded(pc, 0u, UINT64_MAX);
+		else
+#endif
 		this->cpu.simulate_inaccurate(pc);
 	} else {
 		this->simulate_with<Throw>(MAXI, 0u, pc);
@@ -2,10 +2,13 @@
 
 #include "decoder_cache.hpp"
 #include "internal_common.hpp"
+#include <algorithm>
+#include <bit>
 #include <inttypes.h>
 #if defined(__linux__) || defined(__FreeBSD__) || defined(__wasm__)
 #define DEMANGLE_ENABLED
 #include <sys/mman.h>
+#include <unistd.h>
 #ifndef MAP_NORESERVE
 #define MAP_NORESERVE 0
 #endif
@@ -22,7 +25,8 @@ namespace riscv
 					MachineOptions<W> options)
 		: m_machine{mach},
 		  m_original_machine {true},
-		  m_binary {bin}
+		  m_binary {bin},
+		  m_symbol_index {std::make_shared<SymbolIndex>()}
 	{
 #ifdef RISCV_VIRTUAL_PAGING
 		if (options.page_fault_handler != nullptr)
@@ -64,8 +68,49 @@ namespace riscv
 					// Over-allocate by 1 page in order to avoid bounds-checking with size
 					// The extra page also provides over-allocation on both sides
 					const size_t len = (pages_max + 1) * Page::size();
-					auto* base_ptr = (uint8_t *)mmap(NULL, len, PROT_READ | PROT_WRITE,
-						MAP_ANONYMOUS | MAP_PRIVATE | MAP_NORESERVE, -1, 0);
+					void* base_ptr = MAP_FAILED;
+#ifdef __linux__
+					if (options.use_forkable_memory_arena)
+					{
+						// The arena lives in an anonymous file, so that forks can
+						// map it MAP_PRIVATE and get kernel copy-on-write of it.
+						const int fd = memfd_create("libriscv-arena", MFD_CLOEXEC);
+						if (fd >= 0 && ftruncate(fd, len) == 0) {
+							base_ptr = mmap(NULL, len, PROT_READ | PROT_WRITE,
+								MAP_SHARED | MAP_NORESERVE, fd, 0);
+						}
+						if (base_ptr != MAP_FAILED) {
+							this->m_arena.memfd = fd;
+						} else if (fd >= 0) {
+							// Fall back to a regular anonymous arena
+							close(fd);
+						}
+					}
+#endif
+#ifdef RISCV_BINARY_TRANSLATION
+					if (W == 8 && options.translate_guard_paged_arena && base_ptr == MAP_FAILED)
+					{
+						// Reserve the arena rounded up to a power of two, plus one more page,
+						// and leave everything past the end of the arena inaccessible. Masked
+						// loads in translated code can then only fault on the host.
+						const size_t reserved = Memory::OVERALLOCATE
+							+ guard_paged_arena_mask(pages_max * Page::size()) + 1 + Page::size();
+						void* reservation = mmap(NULL, reserved, PROT_NONE,
+							MAP_ANONYMOUS | MAP_PRIVATE | MAP_NORESERVE, -1, 0);
+						if (reservation != MAP_FAILED) {
+							if (mprotect(reservation, len, PROT_READ | PROT_WRITE) == 0) {
+								base_ptr = reservation;
+								this->m_arena.reserved = reserved;
+							} else {
+								munmap(reservation, reserved);
+							}
+						}
+					}
+#endif
+					if (base_ptr == MAP_FAILED) {
+						base_ptr = mmap(NULL, len, PROT_READ | PROT_WRITE,
+							MAP_ANONYMOUS | MAP_PRIVATE | MAP_NORESERVE, -1, 0);
+					}
 					this->m_arena.pages = pages_max;
 					// mmap() returns MAP_FAILED (-1) when mapping fails
 					if (UNLIKELY(base_ptr == MAP_FAILED)) {
@@ -74,7 +119,7 @@ namespace riscv
 					} else {
 						// Adjust pointer forward by OVERALLOCATE to provide over-allocation on both sides
 						// while keeping arena at same logical address (relative to zero)
-						this->m_arena.data = (PageData *)(base_ptr + Memory::OVERALLOCATE);
+						this->m_arena.data = (PageData *)((uint8_t *)base_ptr + Memory::OVERALLOCATE);
 					}
 				}
 #else
@@ -148,6 +193,10 @@ namespace riscv
 		} else {
 			throw MachineException(OUT_OF_MEMORY, "Max memory was zero", 0);
 		}
+		if (options.track_dirty_pages) {
+			// Loading the program also dirties pages
+			this->enable_dirty_tracking();
+		}
 		if (!m_binary.empty()) {
 #ifdef RISCV_VIRTUAL_PAGING
 			// Add a zero-page at the start of address space
@@ -161,7 +210,8 @@ namespace riscv
 	Memory<W>::Memory(Machine<W>& mach, const Machine<W>& other, MachineOptions<W> options)
 	  : m_machine{mach},
 		m_original_machine {false},
-		m_binary{other.memory.binary()}
+		m_binary{other.memory.binary()},
+		m_symbol_index{other.memory.m_symbol_index}
 	{
 #ifdef RISCV_EXT_ATOMICS
 		this->m_atomics = other.memory.m_atomics;
@@ -179,8 +229,8 @@ namespace riscv
 #endif
 		// Potentially deallocate execute segments that are no longer referenced
 		this->evict_execute_segments();
-		// only the original machine owns arena
-		if (this->m_arena.data != nullptr && !is_forked()) {
+		// only the original machine owns arena, unless a fork has a private view of it
+		if (this->m_arena.data != nullptr && (!is_forked() || m_arena.private_mapping)) {
 #if defined(__linux__) || defined(__FreeBSD__)
 			// Adjust back to the original base pointer (subtract OVERALLOCATE)
 			auto* base_ptr = (uint8_t *)this->m_arena.data - Memory::OVERALLOCATE;
@@ -188,9 +238,13 @@ namespace riscv
 			{
 				// munmap() the entire address space
 				munmap(base_ptr, UNBOUNDED_ARENA_SIZE);
+			} else if (this->m_arena.reserved != 0) {
+				munmap(base_ptr, this->m_arena.reserved);
 			} else {
 				munmap(base_ptr, (this->m_arena.pages + 1) * Page::size());
 			}
+			if (this->m_arena.memfd >= 0)
+				close(this->m_arena.memfd);
 #else
 			// Adjust back to the original base pointer (subtract OVERALLOCATE)
 			auto* base_ptr = (PageData *)((uint8_t *)this->m_arena.data - Memory::OVERALLOCATE);
@@ -525,6 +579,29 @@ namespace riscv
 	void Memory<W>::machine_loader(
 		const Machine<W>& master, const MachineOptions<W>& options)
 	{
+		if (options.use_memory_arena) {
+			this->m_arena.data = master.memory.m_arena.data;
+#if defined(__linux__)
+			if constexpr (encompassing_Nbit_arena == 0) {
+				if (master.memory.m_arena.memfd >= 0 && master.memory.m_arena.data != nullptr)
+				{
+					// Map a private copy-on-write view of the master arena. Pages
+					// that are never written keep sharing physical memory with the master.
+					this->map_private_arena(master.memory, nullptr);
+				}
+			}
+#endif
+			this->m_arena.pages = master.memory.m_arena.pages;
+			if (!this->m_arena.private_mapping)
+				this->m_arena.reserved = master.memory.m_arena.reserved;
+			this->m_arena.read_boundary = master.memory.m_arena.read_boundary;
+			this->m_arena.write_boundary = master.memory.m_arena.write_boundary;
+			this->m_arena.initial_rodata_end = master.memory.m_arena.initial_rodata_end;
+			if (options.track_dirty_pages) {
+				// Forks start out clean
+				this->enable_dirty_tracking();
+			}
+		}
 #ifdef RISCV_VIRTUAL_PAGING
 		if (options.minimal_fork == false)
 		{
@@ -536,20 +613,9 @@ namespace riscv
 
 			for (const auto& it : master.memory.pages())
 			{
-				const auto& page = it.second;
 				// Skip pages marked as dont_fork
-				if (page.attr.dont_fork) continue;
-				// Make every page non-owning
-				auto attr = page.attr;
-				if (attr.write) {
-					attr.write = false;
-					attr.is_cow = true;
-				}
-				attr.non_owning = true;
-				m_pages.try_emplace(
-					it.first,
-					attr, page.m_page.get()
-				);
+				if (it.second.attr.dont_fork) continue;
+				this->loan_page(master.memory, it.first, it.second);
 			}
 		}
 #else
@@ -561,18 +627,173 @@ namespace riscv
 		this->m_heap_address = master.memory.m_heap_address;
 		this->m_mmap_address = master.memory.m_mmap_address;
 		this->m_mmap_cache   = master.memory.m_mmap_cache;
+		this->m_snapshot_mapping = master.memory.m_snapshot_mapping;
 
 		// Reference the same execute segments
 		this->m_main_exec_segment = master.memory.m_main_exec_segment;
 		this->m_exec = master.memory.m_exec;
 
-		if (options.use_memory_arena) {
-			this->m_arena.data = master.memory.m_arena.data;
-			this->m_arena.pages = master.memory.m_arena.pages;
-			this->m_arena.read_boundary = master.memory.m_arena.read_boundary;
-			this->m_arena.write_boundary = master.memory.m_arena.write_boundary;
-			this->m_arena.initial_rodata_end = master.memory.m_arena.initial_rodata_end;
+		// invalidate all cached pages, because references are invalidated
+		this->invalidate_reset_cache();
+	}
+
+#if defined(__linux__)
+	template <int W> RISCV_INTERNAL
+	void Memory<W>::map_private_arena(const Memory<W>& master, void* fixed_addr)
+	{
+		const size_t len = (master.m_arena.pages + 1) * Page::size();
+		auto* base_ptr = mmap(fixed_addr, len, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_NORESERVE | (fixed_addr ? MAP_FIXED : 0),
+			master.m_arena.memfd, 0);
+		if (UNLIKELY(base_ptr == MAP_FAILED)) {
+			if (fixed_addr != nullptr)
+				munmap(fixed_addr, len);
+			this->m_arena.data = nullptr;
+			this->m_arena.private_mapping = false;
+			throw MachineException(OUT_OF_MEMORY, "Out of memory (copy-on-write arena)", len);
+		}
+		this->m_arena.data = (PageData *)((uint8_t *)base_ptr + Memory::OVERALLOCATE);
+		this->m_arena.private_mapping = true;
+	}
+#endif
+
+#ifdef RISCV_VIRTUAL_PAGING
+	template <int W> RISCV_INTERNAL
+	void Memory<W>::loan_page(const Memory<W>& master, address_t pageno, const Page& page)
+	{
+		auto attr = page.attr;
+		PageData* data = page.m_page.get();
+		if (m_arena.private_mapping && pageno < m_arena.pages
+			&& data == &master.m_arena.data[pageno])
+		{
+			// Loaned arena pages must refer to our own private arena view,
+			// which is already copy-on-write, so they can keep their attributes.
+			data = &m_arena.data[pageno];
 		}
+		else if (attr.write) {
+			// Make every other writable page copy-on-write
+			attr.write = false;
+			attr.is_cow = true;
+		}
+		attr.non_owning = true;
+		m_pages.try_emplace(pageno, attr, data);
+	}
+#endif
+
+	template <int W> RISCV_INTERNAL
+	void Memory<W>::enable_dirty_tracking()
+	{
+		static_assert(offsetof(decltype(m_arena), dirty) == sizeof(void*),
+			"Translated code expects the dirty bitmap right after the arena pointer");
+		if (m_arena.data == nullptr || m_arena.pages == 0)
+			return;
+		// One spare word, as writes may straddle into the over-allocated page
+		m_dirty_bitmap.assign(m_arena.pages / 64 + 1, 0);
+		m_arena.dirty = m_dirty_bitmap.data();
+	}
+
+	template <int W>
+	std::vector<address_type<W>> Memory<W>::dirty_pages() const
+	{
+		std::vector<address_t> result;
+		result.reserve(this->dirty_page_count());
+		this->for_each_dirty_page([&] (address_t pageno) {
+			result.push_back(pageno);
+		});
+		return result;
+	}
+
+	template <int W>
+	size_t Memory<W>::dirty_page_count() const noexcept
+	{
+		size_t count = 0;
+		for (const uint64_t bits : m_dirty_bitmap)
+			count += std::popcount(bits);
+		// Ignore the over-allocated page after the arena
+		const address_t past = m_arena.pages;
+		if (!m_dirty_bitmap.empty() && ((m_dirty_bitmap[past / 64] >> (past % 64)) & 1))
+			count--;
+		return count;
+	}
+
+	template <int W>
+	void Memory<W>::clear_dirty_pages()
+	{
+		std::fill(m_dirty_bitmap.begin(), m_dirty_bitmap.end(), 0);
+		// Cached writable pages must take the slow-path again, so that
+		// page-table writes into the arena are marked anew
+		this->invalidate_reset_cache();
+	}
+
+#ifdef RISCV_VIRTUAL_PAGING
+	template <int W> RISCV_INTERNAL
+	void Memory<W>::compact_touched_pages()
+	{
+		std::sort(m_touched_pages.begin(), m_touched_pages.end());
+		m_touched_pages.erase(
+			std::unique(m_touched_pages.begin(), m_touched_pages.end()),
+			m_touched_pages.end());
+		// The limit only depends on the list, so freeing pages can't make
+		// every new touch compact the list again
+		m_touched_pages_limit = std::max(size_t(64), 2 * m_touched_pages.size());
+	}
+#endif
+
+	template <int W>
+	void Memory<W>::reset_to(const Memory<W>& master)
+	{
+		if (UNLIKELY(!this->is_forked() || &master == this))
+			throw MachineException(ILLEGAL_OPERATION, "Only a fork can be reset to its master");
+
+#ifdef RISCV_VIRTUAL_PAGING
+		// Restore only the pages that were touched since the fork was
+		// created, or since it was last reset. Untouched pages are still
+		// identical to the ones loaned from the master.
+		this->compact_touched_pages();
+		for (const address_t pageno : m_touched_pages)
+		{
+			m_pages.erase(pageno);
+			auto it = master.m_pages.find(pageno);
+			if (it != master.m_pages.end() && !it->second.attr.dont_fork)
+				this->loan_page(master, pageno, it->second);
+		}
+		m_touched_pages.clear();
+#endif
+#if defined(__linux__)
+		if (m_arena.private_mapping)
+		{
+			// Replacing the private view drops every dirtied arena page at once,
+			// while clean pages were still shared with the master anyway.
+			this->map_private_arena(master, (uint8_t *)m_arena.data - Memory::OVERALLOCATE);
+		}
+#endif
+		if (m_arena.data != nullptr) {
+			this->m_arena.read_boundary = master.m_arena.read_boundary;
+			this->m_arena.write_boundary = master.m_arena.write_boundary;
+		}
+
+		this->m_start_address = master.m_start_address;
+		this->m_stack_address = master.m_stack_address;
+		this->m_exit_address = master.m_exit_address;
+		this->m_heap_address = master.m_heap_address;
+		this->m_mmap_address = master.m_mmap_address;
+		this->m_mmap_cache   = master.m_mmap_cache;
+		this->m_snapshot_mapping = master.m_snapshot_mapping;
+		// Every page is identical to the master again
+		if (this->tracks_dirty_pages())
+			this->clear_dirty_pages();
+
+		// Execute segments created by the fork are dropped
+		if (this->m_main_exec_segment != master.m_main_exec_segment
+			|| this->m_exec != master.m_exec)
+		{
+			this->evict_execute_segments();
+			this->m_main_exec_segment = master.m_main_exec_segment;
+			this->m_exec = master.m_exec;
+		}
+#ifdef RISCV_EXT_ATOMICS
+		this->m_atomics = master.m_atomics;
+#endif
 
 		// invalidate all cached pages, because references are invalidated
 		this->invalidate_reset_cache();
@@ -612,20 +833,16 @@ namespace riscv
 			};
 		};
 
-		const typename Elf::Sym* best = nullptr;
-		const char* best_name = nullptr;
-		for_each_symbol([&] (const auto& sym, const char* symname) {
-			if (Elf::SymbolType(sym.st_info) != Elf::STT_FUNC) return;
-
-			if (address >= sym.st_value && (!best || sym.st_value > best->st_value)) {
-				// best guess (symbol + 0xOff)
-				best = &sym;
-				best_name = symname;
-			}
-		});
-		if (best)
-			return result(best_name, address, *best);
-		return {};
+		// Best guess (symbol + 0xOff) is the closest function at or below address
+		const auto& functions = symbol_index().functions;
+		auto it = std::upper_bound(functions.begin(), functions.end(), address,
+			[] (address_t addr, const auto* sym) { return addr < sym->st_value; });
+		if (it == functions.begin())
+			return {};
+		const auto& best = **(it - 1);
+		const auto* strtab = section_by_name_validated(".strtab");
+		const char* best_name = (strtab != nullptr) ? elf_symbol_name(strtab, best.st_name) : nullptr;
+		return result(best_name, address, best);
 	}
 	template <int W>
 	void Memory<W>::print_backtrace(
@@ -2,6 +2,7 @@
 #include "elf.hpp"
 #include "page.hpp"
 #include <cassert>
+#include <cstddef>
 #include <cstring>
 #include <string_view>
 #include <unordered_map>
@@ -249,12 +250,26 @@ namespace riscv
 		// Evict all execute segments, also disabling the main execute segment
 		void evict_execute_segments();
 		void evict_execute_segment(DecodedExecuteSegment<W>&);
+		struct InstructionPair {
+			std::string name;   // Mnemonics, eg. "LUI+ADDI"
+			uint32_t count = 0; // Occurrences inside blocks of the execute segments
+			uint32_t fused = 0; // Occurrences that became a superinstruction
+		};
+		// Static frequencies of adjacent instruction pairs in the decoder
+		// caches of all execute segments, with the most common pairs first
+		std::vector<InstructionPair> gather_instruction_pairs() const;
 #ifdef RISCV_BINARY_TRANSLATION
 		std::vector<address_t> gather_jump_hints() const;
+		// Block execution counts recorded with MachineOptions::record_block_profile,
+		// as (address, count) pairs with the hottest blocks first
+		std::vector<std::pair<address_t, uint32_t>> gather_block_profile() const;
 #endif
 
 		const auto& binary() const noexcept { return m_binary; }
 		void reset();
+		// Roll a fork back to the state of its master, restoring only
+		// the pages touched since the fork was created or last reset
+		void reset_to(const Memory<W>& master);
 		bool is_dynamic_executable() const noexcept { return this->m_is_dynamic; }
 		address_t elf_base_address(address_t offset) const;
 
@@ -266,12 +281,53 @@ namespace riscv
 		address_t memory_arena_read_boundary() const noexcept { return this->m_arena.read_boundary; }
 		address_t memory_arena_write_boundary() const noexcept { return this->m_arena.write_boundary; }
 		address_t initial_rodata_end() const noexcept { return this->m_arena.initial_rodata_end; }
+		// Byte offsets of arena fields from memory_arena_ptr_ref(), used by generated machine code
+		static constexpr size_t memory_arena_dirty_offset() noexcept { return offsetof(decltype(m_arena), dirty); }
+		static constexpr size_t memory_arena_read_boundary_offset() noexcept { return offsetof(decltype(m_arena), read_boundary); }
+		static constexpr size_t memory_arena_write_boundary_offset() noexcept { return offsetof(decltype(m_arena), write_boundary); }
+		static constexpr size_t initial_rodata_end_offset() noexcept { return offsetof(decltype(m_arena), initial_rodata_end); }
+		// True when the arena is backed by a memfd that forks can map privately (copy-on-write)
+		bool uses_forkable_memory_arena() const noexcept { return this->m_arena.memfd >= 0; }
+		// True when this (forked) machine has its own private copy-on-write view of the arena
+		bool has_private_arena_mapping() const noexcept { return this->m_arena.private_mapping; }
+		// True when the arena sits in a guard-paged host reservation (see
+		// MachineOptions::translate_guard_paged_arena)
+		bool uses_guard_paged_arena() const noexcept { return this->m_arena.reserved != 0; }
+		// Host address range of the whole reservation, including guard pages
+		uintptr_t guard_paged_arena_begin() const noexcept { return uintptr_t(this->m_arena.data) - OVERALLOCATE; }
+		uintptr_t guard_paged_arena_end() const noexcept { return guard_paged_arena_begin() + this->m_arena.reserved; }
+		// Addresses and-masked with this always land inside the reservation
+		static constexpr uint64_t guard_paged_arena_mask(uint64_t arena_size) noexcept {
+			uint64_t span = Page::size();
+			while (span < arena_size) span <<= 1;
+			return span - 1;
+		}
+
+		// Dirty-page tracking of the flat arena (see MachineOptions::track_dirty_pages)
+		bool tracks_dirty_pages() const noexcept { return this->m_arena.dirty != nullptr; }
+		bool is_dirty_page(address_t pageno) const noexcept;
+		// Calls fn(pageno) for each arena page written since the last clear, in ascending order
+		template <typename Fn> void for_each_dirty_page(Fn&& fn) const;
+		std::vector<address_t> dirty_pages() const;
+		size_t dirty_page_count() const noexcept;
+		void clear_dirty_pages();
+		// Mark arena pages as written, for writes that bypass the memory helpers
+		void mark_dirty(address_t addr) const noexcept;
+		void mark_dirty_range(address_t addr, size_t len) const noexcept;
 
 		// Serializes the current memory state to an existing vector
 		// Returns the final size of the serialized state
 		size_t serialize_to(std::vector<uint8_t>& vec) const;
 		// Returns memory to a previously stored state
 		void deserialize_from(const std::vector<uint8_t>&, const SerializedMachine<W>&);
+		// Incremental snapshots, see Machine::serialize_delta_to()
+		void serialize_delta_to(std::vector<uint8_t>& vec, size_t start, SerializedDelta<W>&,
+			const std::vector<uint8_t>* base, bool use_dirty_pages) const;
+		void deserialize_delta_from(const std::vector<const std::vector<uint8_t>*>& chain, unsigned threads);
+		// Memory-mapped snapshots, see Machine::deserialize_mapped_from()
+		void deserialize_mapped_from(std::shared_ptr<void> mapping, size_t size, int fd);
+		// True when restored pages still refer to a memory-mapped snapshot
+		bool uses_snapshot_mapping() const noexcept { return this->m_snapshot_mapping != nullptr; }
 
 		Memory(Machine<W>&, std::string_view, MachineOptions<W>);
 		Memory(Machine<W>&, const Machine<W>&, MachineOptions<W>);
@@ -320,6 +376,13 @@ namespace riscv
 		void dynamic_linking(const typename Elf::Header&);
 		void relocate_section(const char* section_name, const char* symtab);
 		const typename Elf::Sym* resolve_symbol(std::string_view name) const;
+		// Hashed names and address-sorted functions of .symtab, built on first use
+		struct SymbolIndex {
+			std::once_flag built;
+			std::unordered_map<std::string_view, const typename Elf::Sym*> by_name;
+			std::vector<const typename Elf::Sym*> functions; // Sorted by st_value
+		};
+		const SymbolIndex& symbol_index() const;
 		const typename Elf::Sym* elf_sym_index(const typename Elf::SectionHeader* shdr, uint32_t symidx) const;
 		// ELF loader
 		void binary_loader(const MachineOptions<W>&);
@@ -328,6 +391,22 @@ namespace riscv
 		void generate_decoder_cache(const MachineOptions<W>&, std::shared_ptr<DecodedExecuteSegment<W>>&, bool is_initial);
 		// Machine copy-on-write fork
 		void machine_loader(const Machine<W>&, const MachineOptions<W>&);
+		// Zero a page-aligned range of the arena, releasing memory when possible
+		void arena_discard(address_t dst, size_t len);
+		void enable_dirty_tracking();
+		// Prepare memory for a snapshot that replaces every page
+		void reset_for_snapshot(const SerializedDelta<W>&);
+#if defined(__linux__)
+		// Map a private copy-on-write view of the master arena
+		void map_private_arena(const Memory<W>& master, void* fixed_addr);
+#endif
+#ifdef RISCV_VIRTUAL_PAGING
+		// Loan a master page to this fork as a non-owning page
+		void loan_page(const Memory<W>& master, address_t pageno, const Page&);
+		// Remember pages a fork modified, so that reset_to() can restore them
+		void record_touched_page(address_t pageno);
+		void compact_touched_pages();
+#endif
 
 		address_t m_start_address = 0;
 		address_t m_stack_address = 0;
@@ -342,12 +421,18 @@ namespace riscv
 		mutable CachedPage<W, PageData> m_wr_cache;
 
 		std::unordered_map<address_t, Page> m_pages;
+		// Page numbers a fork has modified (may contain duplicates)
+		std::vector<address_t> m_touched_pages;
+		// Compact again when the list grows past twice its compacted size
+		size_t m_touched_pages_limit = 64;
 #endif
 
 		const bool m_original_machine;
 		bool m_is_dynamic = false;
 
 		const std::string_view m_binary;
+		// Shared between a machine and its forks
+		std::shared_ptr<SymbolIndex> m_symbol_index;
 
 		// Memory map cache
 		MMapCache<W> m_mmap_cache;
@@ -370,11 +455,20 @@ namespace riscv
 		// Linear arena at start of memory (mmap-backed)
 		struct {
 			PageData* data = nullptr;
+			// Translated code finds the dirty bitmap right after the arena pointer
+			uint64_t* dirty = nullptr; // Bitmap of written pages, when tracked
 			address_t read_boundary = 0;
 			address_t write_boundary = 0;
 			address_t initial_rodata_end = 0;
 			size_t    pages = 0;
+			int       memfd = -1; // Main machine: backing file for forkable arenas
+			bool      private_mapping = false; // Fork: MAP_PRIVATE view of a memfd arena
+			bool      file_mapped = false; // Parts of the arena map a snapshot file
+			size_t    reserved = 0; // Guard-paged arena: bytes reserved, including guard pages
 		} m_arena;
+		std::vector<uint64_t> m_dirty_bitmap;
+		// Snapshot file mapping that restored pages point into
+		std::shared_ptr<void> m_snapshot_mapping;
 
 		friend struct CPU<W>;
 	};
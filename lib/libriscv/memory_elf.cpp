@@ -1,5 +1,6 @@
 #include "machine.hpp"
 #include "internal_common.hpp"
+#include <algorithm>
 
 namespace riscv
 {
@@ -121,14 +122,35 @@ namespace riscv
 	}
 
 	template <int W>
-	const typename Elf<W>::Sym* Memory<W>::resolve_symbol(std::string_view name) const
+	const typename Memory<W>::SymbolIndex& Memory<W>::symbol_index() const
 	{
-		const typename Elf::Sym* result = nullptr;
-		for_each_symbol([&] (const auto& sym, const char* symname) {
-			if (result == nullptr && symname != nullptr && name.compare(symname) == 0)
-				result = &sym;
+		SymbolIndex& index = *m_symbol_index;
+		std::call_once(index.built, [&] {
+			for_each_symbol([&] (const auto& sym, const char* symname) {
+				// The first symbol with a given name wins
+				if (symname != nullptr)
+					index.by_name.emplace(symname, &sym);
+				if (Elf::SymbolType(sym.st_info) == Elf::STT_FUNC)
+					index.functions.push_back(&sym);
+			});
+			// Keep only the first function at each address
+			std::stable_sort(index.functions.begin(), index.functions.end(),
+				[] (const auto* a, const auto* b) { return a->st_value < b->st_value; });
+			auto last = std::unique(index.functions.begin(), index.functions.end(),
+				[] (const auto* a, const auto* b) { return a->st_value == b->st_value; });
+			index.functions.erase(last, index.functions.end());
 		});
-		return result;
+		return index;
+	}
+
+	template <int W>
+	const typename Elf<W>::Sym* Memory<W>::resolve_symbol(std::string_view name) const
+	{
+		const auto& by_name = symbol_index().by_name;
+		auto it = by_name.find(name);
+		if (it != by_name.end())
+			return it->second;
+		return nullptr;
 	}
 
 	template <int W>
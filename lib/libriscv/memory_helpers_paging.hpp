@@ -6,6 +6,7 @@ void Memory<W>::memset(address_t dst, uint8_t value, size_t len)
 #ifndef RISCV_VIRTUAL_PAGING
 	if (UNLIKELY(dst + len > memory_arena_size() || dst + len < dst || dst < initial_rodata_end()))
 		protection_fault(dst);
+	this->mark_dirty_range(dst, len);
 	std::memset(&((char*)m_arena.data)[dst], value, len);
 #else
 	while (len > 0)
@@ -28,6 +29,7 @@ void Memory<W>::memcpy(address_t dst, const void* vsrc, size_t len)
 #ifndef RISCV_VIRTUAL_PAGING
 	if (UNLIKELY(dst + len > memory_arena_size() || dst + len < dst || dst < initial_rodata_end()))
 		protection_fault(dst);
+	this->mark_dirty_range(dst, len);
 	std::memcpy(&((char*)m_arena.data)[dst], vsrc, len);
 #else
 	auto* src = (uint8_t*) vsrc;
@@ -83,6 +85,7 @@ bool Memory<W>::try_memmove(address_t dst, address_t src, size_t len)
 			src + len < memory_arena_size() && src + len > src)) {
 			char* p_src = &((char *)m_arena.data)[src];
 			char* p_dest = &((char *)m_arena.data)[dst];
+			this->mark_dirty_range(dst, len);
 			std::memmove(p_dest, p_src, len);
 			return true;
 		}
@@ -234,6 +237,7 @@ std::string_view Memory<W>::writable_memview(address_t addr, size_t len, size_t
 
 	if constexpr (flat_readwrite_arena) {
 		if (LIKELY(addr + len - initial_rodata_end() < memory_arena_write_boundary() && addr < addr + len)) {
+			this->mark_dirty_range(addr, len);
 			char* begin = &((char *)m_arena.data)[RISCV_SPECSAFE(addr)];
 			return {begin, len};
 		}
@@ -311,6 +315,7 @@ T* Memory<W>::try_memarray(address_t addr, size_t count, size_t maxbytes) const
 		}
 	} else if constexpr (flat_readwrite_arena) {
 		if (LIKELY(addr + len - initial_rodata_end() < memory_arena_write_boundary() && addr < addr + len)) {
+			this->mark_dirty_range(addr, len);
 			char* begin = &((char *)m_arena.data)[RISCV_SPECSAFE(addr)];
 			return (T*) begin;
 		}
@@ -564,6 +569,7 @@ size_t Memory<W>::gather_writable_buffers_from_range(
 		machine().cpu.trigger_exception(PROTECTION_FAULT, addr);
 	if (cnt == 0)
 		machine().cpu.trigger_exception(OUT_OF_MEMORY, len);
+	this->mark_dirty_range(addr, len);
 	buffers[0].ptr = &((char*)m_arena.data)[addr];
 	buffers[0].len = len;
 	return 1;
@@ -60,14 +60,18 @@ T& Memory<W>::writable_read(address_t address)
 {
 	if constexpr (encompassing_Nbit_arena)
 	{
-		if constexpr (encompassing_Nbit_arena == 32)
+		if constexpr (encompassing_Nbit_arena == 32) {
+			this->mark_dirty_range(uint32_t(address), sizeof(T));
 			return *(T *)&((char*)m_arena.data)[uint32_t(address)];
-		else // It's a power-of-two encompassing arena
+		} else { // It's a power-of-two encompassing arena
+			this->mark_dirty_range(address & encompassing_arena_mask, sizeof(T));
 			return *(T *)&((char*)m_arena.data)[address & encompassing_arena_mask];
+		}
 	} else {
 
 	if constexpr (flat_readwrite_arena) {
 		if (LIKELY(address - initial_rodata_end() < memory_arena_write_boundary())) {
+			this->mark_dirty_range(address, sizeof(T));
 			return *(T *)&((char*)m_arena.data)[RISCV_SPECSAFE(address)];
 		}
 #ifndef RISCV_VIRTUAL_PAGING
@@ -92,10 +96,13 @@ void Memory<W>::write(address_t address, T value)
 {
 	if constexpr (encompassing_Nbit_arena)
 	{
-		if constexpr (encompassing_Nbit_arena == 32)
+		if constexpr (encompassing_Nbit_arena == 32) {
+			this->mark_dirty_range(uint32_t(address), sizeof(T));
 			*(T *)&((char*)m_arena.data)[uint32_t(address)] = value;
-		else // It's a power-of-two encompassing arena
+		} else { // It's a power-of-two encompassing arena
+			this->mark_dirty_range(address & encompassing_arena_mask, sizeof(T));
 			*(T *)&((char*)m_arena.data)[address & encompassing_arena_mask] = value;
+		}
 		return;
 	} else {
 
@@ -108,6 +115,7 @@ void Memory<W>::write(address_t address, T value)
 	}
 	else if constexpr (flat_readwrite_arena) {
 		if (LIKELY(address - initial_rodata_end() < memory_arena_write_boundary())) {
+			this->mark_dirty_range(address, sizeof(T));
 #ifdef RISCV_EXT_VECTOR
 			if constexpr (sizeof(T) >= 32) {
 				// Reads and writes using vectors might have alignment requirements
@@ -210,3 +218,51 @@ inline std::shared_ptr<DecodedExecuteSegment<W>>& Memory<W>::exec_segment_for(ad
 	}
 	return CPU<W>::empty_execute_segment();
 }
+
+template <int W>
+inline void Memory<W>::mark_dirty(address_t addr) const noexcept
+{
+	if (UNLIKELY(m_arena.dirty != nullptr)) {
+		const address_t pageno = page_number(addr);
+		if (LIKELY(pageno < m_arena.pages))
+			m_arena.dirty[pageno / 64] |= uint64_t(1) << (pageno % 64);
+	}
+}
+
+template <int W>
+inline void Memory<W>::mark_dirty_range(address_t addr, size_t len) const noexcept
+{
+	if (UNLIKELY(m_arena.dirty != nullptr && len != 0)) {
+		address_t pageno = page_number(addr);
+		// Writes may straddle a page boundary, and the range may leave the arena
+		const address_t last = page_number(addr + (len - 1));
+		const address_t end = std::min(address_t(last < pageno ? m_arena.pages : last + 1), address_t(m_arena.pages));
+		for (; pageno < end; pageno++)
+			m_arena.dirty[pageno / 64] |= uint64_t(1) << (pageno % 64);
+	}
+}
+
+template <int W>
+inline bool Memory<W>::is_dirty_page(address_t pageno) const noexcept
+{
+	if (m_arena.dirty == nullptr || pageno >= m_arena.pages)
+		return false;
+	return (m_arena.dirty[pageno / 64] >> (pageno % 64)) & 1;
+}
+
+template <int W>
+template <typename Fn> inline
+void Memory<W>::for_each_dirty_page(Fn&& fn) const
+{
+	for (size_t i = 0; i < m_dirty_bitmap.size(); i++) {
+		const uint64_t bits = m_dirty_bitmap[i];
+		if (bits == 0)
+			continue;
+		for (unsigned bit = 0; bit < 64; bit++) {
+			const address_t pageno = i * 64 + bit;
+			// The spare bits cover the over-allocated page after the arena
+			if (((bits >> bit) & 1) && pageno < m_arena.pages)
+				fn(pageno);
+		}
+	}
+}
@@ -87,6 +87,7 @@ Page& Memory<W>::allocate_page(const address_t page, Args&&... args)
 		page,
 		std::forward<Args> (args)...
 	);
+	this->record_touched_page(page);
 	// Invalidate only this page
 	this->invalidate_cache(page, &it.first->second);
 	// Return new default-writable page
@@ -103,6 +104,18 @@ inline size_t Memory<W>::owned_pages_active() const noexcept
 	return count;
 }
 
+template <int W>
+inline void Memory<W>::record_touched_page(address_t pageno)
+{
+	// Only forks can be reset, so only forks keep track
+	if (this->is_forked()) {
+		m_touched_pages.push_back(pageno);
+		// Writes to the same pages repeatedly produce duplicates
+		if (UNLIKELY(m_touched_pages.size() > m_touched_pages_limit))
+			this->compact_touched_pages();
+	}
+}
+
 template <int W>
 inline void Memory<W>::trap(address_t page_addr, mmio_cb_t callback)
 {
@@ -110,6 +123,7 @@ inline void Memory<W>::trap(address_t page_addr, mmio_cb_t callback)
 	// a page if it doesn't exist. At least this way the trap will
 	// always work. Less surprises this way.
 	auto& page = create_writable_pageno(page_number(page_addr));
+	this->record_touched_page(page_number(page_addr));
 	// Disabling caching will force the slow-path for the page,
 	// and enables page traps when RISCV_DEBUG is enabled.
 	page.attr.cacheable = false;
@@ -25,12 +25,15 @@ namespace riscv
 	template <int W>
 	Page& Memory<W>::create_writable_pageno(const address_t pageno, bool init)
 	{
+		// Arena pages may be written through the page tables too
+		this->mark_dirty(pageno * Page::size());
 		auto it = m_pages.find(pageno);
 		if (LIKELY(it != m_pages.end())) {
 			Page& page = it->second;
 			if (LIKELY(page.attr.write)) {
 				return page;
 			} else if (page.attr.is_cow) {
+				this->record_touched_page(pageno);
 				m_page_write_handler(*this, pageno, page);
 				// The page may be read-cached at this time
 				// and the page data has likely changed now.
@@ -39,6 +42,7 @@ namespace riscv
 			}
 		} else {
 			// Handler must produce a new page, or throw
+			this->record_touched_page(pageno);
 			Page& page = m_page_fault_handler(*this, pageno, init);
 			if (LIKELY(page.attr.write)) {
 				this->invalidate_cache(pageno, &page);
@@ -53,6 +57,7 @@ namespace riscv
 	{
 		auto it = pages().find(pageno);
 		if (it != pages().end()) {
+			this->record_touched_page(pageno);
 			auto& page = it->second;
 			// Keep non-owning and is_cow attributes
 			const bool is_cow = page.attr.is_cow;
@@ -84,6 +89,7 @@ namespace riscv
 		attr.is_cow = attr.write;
 		attr.write = false;
 		attr.non_owning = true;
+		this->record_touched_page(pageno);
 		m_pages.try_emplace(pageno, attr, Page::cow_page().m_page.get());
 	}
 #endif // RISCV_VIRTUAL_PAGING
@@ -129,6 +135,32 @@ namespace riscv
 #endif
 	}
 
+	template <int W>
+	void Memory<W>::arena_discard(address_t dst, size_t len)
+	{
+#ifndef MADV_DONTNEED
+		static constexpr int MADV_DONTNEED = 0x4;
+#endif
+		this->mark_dirty_range(dst, len);
+		auto* baseptr = &((uint8_t *)m_arena.data)[dst];
+		if constexpr (MADVISE_ENABLED) {
+#ifdef MADV_REMOVE
+			// A memfd-backed arena is a shared mapping, where MADV_DONTNEED
+			// does not zero the memory. Instead, punch a hole in the file.
+			if (m_arena.memfd >= 0 && madvise(baseptr, len, MADV_REMOVE) == 0)
+				return;
+#endif
+			// A private view of a memfd-backed arena would revert to the
+			// contents of the main machine, so it must be zeroed manually.
+			// The same goes for arena pages mapped from a snapshot file.
+			if (!m_arena.private_mapping && m_arena.memfd < 0 && !m_arena.file_mapped) {
+				madvise(baseptr, len, MADV_DONTNEED);
+				return;
+			}
+		}
+		std::memset(baseptr, 0, len);
+	}
+
 	template <int W>
 	void Memory<W>::memdiscard(address_t dst, size_t len, bool ignore_protections)
 	{
@@ -139,12 +171,7 @@ namespace riscv
 			(void)ignore_protections;
 			if (UNLIKELY(dst + len > memory_arena_size() || dst + len < dst))
 				protection_fault(dst);
-			if constexpr (MADVISE_ENABLED) {
-				auto* baseptr = &((uint8_t *)m_arena.data)[dst];
-				madvise(baseptr, len, MADV_DONTNEED);
-			} else {
-				std::memset(&((char*)m_arena.data)[dst], 0, len);
-			}
+			this->arena_discard(dst, len);
 			return;
 		}
 
@@ -165,6 +192,7 @@ namespace riscv
 					// This is the zero-page
 				} else {
 					if (page.attr.is_cow) {
+						this->record_touched_page(pageno);
 						m_page_write_handler(*this, pageno, page);
 					}
 					if (page.attr.write || ignore_protections) {
@@ -172,7 +200,10 @@ namespace riscv
 						if constexpr (MADVISE_ENABLED) {
 							// madvise "fast-path" (XXX: doesn't scale on busy server)
 							if (offset == 0 && size == Page::size()) {
-								madvise(page.data(), Page::size(), MADV_DONTNEED);
+								if (pageno < m_arena.pages && page.m_page.get() == &m_arena.data[pageno])
+									this->arena_discard(dst, Page::size());
+								else
+									madvise(page.data(), Page::size(), MADV_DONTNEED);
 							} else {
 								std::memset(page.data() + offset, 0, size);
 							}
@@ -197,8 +228,7 @@ namespace riscv
 							new_dst = std::min(new_dst, (address_t)memory_arena_size());
 							const size_t new_size = new_dst - dst;
 
-							auto* baseptr = &((uint8_t *)m_arena.data)[dst];
-							madvise(baseptr, new_size, MADV_DONTNEED);
+							this->arena_discard(dst, new_size);
 
 							dst += new_size;
 							len -= new_size;
@@ -230,6 +260,7 @@ namespace riscv
 	template <int W>
 	bool Memory<W>::free_pageno(address_t pageno)
 	{
+		this->record_touched_page(pageno);
 		return m_pages.erase(pageno) != 0;
 	}
 
@@ -304,6 +335,7 @@ namespace riscv
 
 		auto attr = shared_page.attr;
 		attr.non_owning = true;
+		this->record_touched_page(pageno);
 		// NOTE: If you insert a const Page, DON'T modify it! The machine
 		// won't, unless system-calls do or manual intervention happens!
 		auto res = m_pages.try_emplace(
@@ -333,6 +365,7 @@ namespace riscv
 		{
 			const auto pageno = (dst + i) / Page::size();
 			PageData* pdata = reinterpret_cast<PageData*> ((char*) src + i);
+			this->record_touched_page(pageno);
 			m_pages.try_emplace(
 				pageno,
 				attr, pdata
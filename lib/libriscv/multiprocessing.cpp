@@ -0,0 +1,314 @@
+#include "multiprocessing.hpp"
+#include "internal_common.hpp"
+#include "threads.hpp"
+#include <errno.h>
+#include <optional>
+#include <thread>
+#if defined(__linux__)
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace riscv {
+
+template <int W>
+void Machine<W>::multiprocess(unsigned num_harts, uint64_t max_instructions,
+	address_t func, address_t arg, address_t stack_base, address_t stack_size)
+{
+	if (UNLIKELY(this->is_multiprocessing()))
+		throw MachineException(ILLEGAL_OPERATION, "Multiprocessing: Harts are already running");
+	if (UNLIKELY(num_harts == 0 || num_harts > Multiprocessing<W>::MAX_HARTS))
+		throw MachineException(ILLEGAL_OPERATION, "Multiprocessing: Invalid number of harts", num_harts);
+	// Forks of a forkable arena get a private view, which is not shared
+	if (UNLIKELY(!memory.uses_flat_memory_arena() || memory.uses_forkable_memory_arena()))
+		throw MachineException(FEATURE_DISABLED, "Multiprocessing requires a shared flat read-write arena");
+	// Green threads would wait on host futexes too, and block each other
+	if (UNLIKELY(m_mt != nullptr && m_mt->thread_count() > 1))
+		throw MachineException(ILLEGAL_OPERATION, "Multiprocessing: Other threads are running", m_mt->thread_count());
+
+	if (m_smp == nullptr)
+		m_smp.reset(new Multiprocessing<W>(num_harts));
+	else if (m_smp->thread_pool.get_pool_size() < num_harts)
+		m_smp->thread_pool.set_pool_size(num_harts);
+	auto& smp = *m_smp;
+	smp.failures = 0;
+	smp.stopping = false;
+	smp.running = num_harts;
+	smp.blocked = 0;
+	smp.harts.clear();
+	smp.harts.reserve(num_harts);
+
+	// The forks are created here, while this machine is not running
+	MachineOptions<W> options;
+	options.use_memory_arena = true;
+	for (unsigned i = 0; i < num_harts; i++)
+	{
+		auto hart = std::make_unique<Machine<W>>(*this, options);
+		// Green threads stay with the main hart
+		hart->m_mt = nullptr;
+		hart->m_hart_smp = &smp;
+		hart->m_options = this->m_options;
+		hart->m_userdata = this->m_userdata;
+		hart->m_printer = this->m_printer;
+		hart->m_stdin = this->m_stdin;
+		hart->m_printv = this->m_printv;
+		hart->m_stdin_readv = this->m_stdin_readv;
+		hart->m_rdtime = this->m_rdtime;
+
+		const int hart_id = i + 1;
+		hart->cpu.set_cpu_id(hart_id);
+		auto& regs = hart->cpu.registers();
+		regs.get(REG_SP) = (stack_base + hart_id * stack_size) & ~address_t(0xF);
+		regs.get(REG_RA) = memory.exit_address();
+		regs.get(REG_ARG0) = hart_id;
+		regs.get(REG_ARG1) = arg;
+		hart->cpu.jump(func);
+		smp.harts.push_back(std::move(hart));
+	}
+
+	smp.processing = true;
+	for (unsigned i = 0; i < num_harts; i++)
+	{
+		smp.thread_pool.enqueue([&smp, i, max_instructions] {
+			auto& hart = *smp.harts[i];
+			bool stopped_normally = false;
+			try {
+				const uint64_t counter = hart.instruction_counter();
+				while (!smp.stopping.load(std::memory_order_relaxed))
+				{
+					const uint64_t used = hart.instruction_counter() - counter;
+					if (used >= max_instructions)
+						break;
+					const uint64_t quantum = std::min(Multiprocessing<W>::QUANTUM, max_instructions - used);
+					if (hart.template resume<false>(quantum)) {
+						// Stopping while waiting on a futex also stops the hart
+						stopped_normally = !smp.stopping.load();
+						break;
+					}
+				}
+			} catch (...) {
+				stopped_normally = false;
+			}
+			if (!stopped_normally)
+				smp.failures.fetch_or(1ul << i);
+			std::lock_guard<std::mutex> lock(smp.mutex);
+			smp.running--;
+			smp.harts_stopped.notify_all();
+		});
+	}
+}
+
+template <int W>
+unsigned long Machine<W>::multiprocess_wait()
+{
+	if (m_smp == nullptr || !m_smp->processing)
+		return 0;
+	auto& smp = *m_smp;
+	smp.last_activity = ~uint64_t(0);
+	while (!smp.wait_for_harts()) {
+		// Nothing can wake the harts while we are waiting here
+		if (smp.deadlocked())
+			smp.stop();
+	}
+	smp.thread_pool.wait_until_nothing_in_flight();
+	smp.processing = false;
+	smp.harts.clear();
+	return smp.failures.load();
+}
+
+template <int W>
+void Machine<W>::multiprocess_stop() noexcept
+{
+	if (m_smp != nullptr)
+		m_smp->stop();
+}
+
+template <int W>
+bool Machine<W>::is_multiprocessing() const noexcept
+{
+	return cpu.cpu_id() != 0 || (m_smp != nullptr && m_smp->processing);
+}
+
+template <int W>
+Multiprocessing<W>& Machine<W>::smp()
+{
+	if (m_hart_smp != nullptr)
+		return *m_hart_smp;
+	if (LIKELY(m_smp != nullptr))
+		return *m_smp;
+	throw MachineException(FEATURE_DISABLED, "Multiprocessing is not initialized");
+}
+
+template <int W>
+bool Multiprocessing<W>::wait_for_harts()
+{
+	std::unique_lock<std::mutex> lock(this->mutex);
+	return harts_stopped.wait_for(lock, WAIT_SLICE, [this] { return running == 0; });
+}
+
+template <int W>
+bool Multiprocessing<W>::deadlocked() noexcept
+{
+	const uint64_t current = activity.load();
+	const bool all_blocked = blocked.load() == running.load();
+	const bool result = all_blocked && current == last_activity;
+	last_activity = all_blocked ? current : ~uint64_t(0);
+	return result;
+}
+
+template <int W>
+void Multiprocessing<W>::futex(Machine<W>& machine,
+	address_t addr, int futex_op, int val, uint32_t val3)
+{
+	static constexpr int HOST_FUTEX_PRIVATE = 128;
+	static constexpr int HOST_FUTEX_CLOCK_REALTIME = 256;
+	const int op = futex_op & 0xF;
+	if (UNLIKELY(addr % 4 != 0)) {
+		machine.set_result(-EINVAL);
+		return;
+	}
+	auto& word = machine.memory.template writable_read<uint32_t> (addr);
+
+	if (op == 1 /* FUTEX_WAKE */ || op == 10 /* FUTEX_WAKE_BITSET */)
+	{
+		activity++;
+#if defined(__linux__) && defined(SYS_futex)
+		const long res = syscall(SYS_futex, &word,
+			op | HOST_FUTEX_PRIVATE, val, nullptr, nullptr, val3);
+		machine.set_result(res < 0 ? -errno : res);
+#else
+		// Waiters poll the futex word
+		machine.set_result(0);
+#endif
+		return;
+	}
+	else if (op != 0 /* FUTEX_WAIT */ && op != 9 /* FUTEX_WAIT_BITSET */)
+	{
+		machine.set_result(-EINVAL);
+		return;
+	}
+
+	// The guest timeout, as a deadline on the steady clock
+	using clock = std::chrono::steady_clock;
+	std::optional<clock::time_point> deadline;
+	if (const auto g_ts = machine.sysarg(3); g_ts != 0) {
+		int64_t guest_ts[2];
+		machine.copy_from_guest(guest_ts, g_ts, sizeof(guest_ts));
+		const auto timeout = std::chrono::duration_cast<clock::duration>(
+			std::chrono::seconds(guest_ts[0]) + std::chrono::nanoseconds(guest_ts[1]));
+		if (op == 0) // Relative
+			deadline = clock::now() + timeout;
+		else if (futex_op & HOST_FUTEX_CLOCK_REALTIME)
+			deadline = clock::now() + (timeout - std::chrono::duration_cast<clock::duration>(
+				std::chrono::system_clock::now().time_since_epoch()));
+		else // Absolute time on the monotonic clock
+			deadline = clock::time_point(timeout);
+	}
+	// Hart 0 is not counted, as it is the one looking for deadlocks
+	const bool is_hart = machine.cpu.cpu_id() != 0;
+	const bool counted = is_hart && !deadline;
+	if (counted)
+		blocked++;
+	else if (!is_hart)
+		last_activity = ~uint64_t(0);
+
+	long result = 0;
+	for (bool first = true;; first = false)
+	{
+		if (is_hart && stopping.load()) {
+			machine.stop();
+			result = -EINTR;
+			break;
+		}
+		const auto now = clock::now();
+		if (deadline && now >= *deadline) {
+			result = -ETIMEDOUT;
+			break;
+		}
+		auto slice_end = now + WAIT_SLICE;
+		if (deadline && *deadline < slice_end)
+			slice_end = *deadline;
+#if defined(__linux__) && defined(SYS_futex)
+		// The steady clock is CLOCK_MONOTONIC, as FUTEX_WAIT_BITSET expects
+		(void)first;
+		const auto since_epoch = slice_end.time_since_epoch();
+		const auto secs = std::chrono::duration_cast<std::chrono::seconds>(since_epoch);
+		struct timespec ts;
+		ts.tv_sec = secs.count();
+		ts.tv_nsec = std::chrono::duration_cast<std::chrono::nanoseconds>(since_epoch - secs).count();
+		const long res = syscall(SYS_futex, &word, 9 /* FUTEX_WAIT_BITSET */ | HOST_FUTEX_PRIVATE,
+			val, &ts, nullptr, (op == 9) ? val3 : ~0u);
+		if (res == 0 || (errno != ETIMEDOUT && errno != EINTR)) {
+			result = (res < 0) ? -errno : 0;
+			break;
+		}
+#else
+		if (std::atomic_ref<uint32_t>(word).load() != (uint32_t)val) {
+			result = first ? -EAGAIN : 0;
+			break;
+		}
+		std::this_thread::sleep_until(std::min(slice_end, now + std::chrono::microseconds(100)));
+#endif
+		// Hart 0 waiting forever while every hart is also waiting forever
+		if (!is_hart && !deadline && deadlocked()) {
+			this->stop();
+			throw MachineException(DEADLOCK_REACHED, "Multiprocessing: Every hart is waiting on a futex", addr);
+		}
+	}
+	if (counted)
+		blocked--;
+	activity++;
+	machine.set_result(result);
+}
+
+template <int W>
+void Machine<W>::setup_multiprocessing(size_t syscall_base)
+{
+	// multiprocess(num_harts, func, arg, stack_base, stack_size)
+	install_syscall_handler(syscall_base + 0,
+	[] (Machine<W>& machine) {
+		const auto [num_harts, func, arg, stack_base, stack_size] =
+			machine.template sysargs<unsigned, address_t, address_t, address_t, address_t> ();
+		try {
+			machine.multiprocess(num_harts, machine.max_instructions(),
+				func, arg, stack_base, stack_size);
+			machine.set_result(0);
+		} catch (const MachineException& e) {
+			machine.set_result(e.type() == FEATURE_DISABLED ? -ENOSYS : -EINVAL);
+		}
+	});
+	// multiprocess_wait()
+	install_syscall_handler(syscall_base + 1,
+	[] (Machine<W>& machine) {
+		machine.set_result(machine.multiprocess_wait());
+	});
+}
+
+#ifdef RISCV_32I
+template struct Multiprocessing<4>;
+template void Machine<4>::multiprocess(unsigned, uint64_t, address_type<4>, address_type<4>, address_type<4>, address_type<4>);
+template unsigned long Machine<4>::multiprocess_wait();
+template void Machine<4>::multiprocess_stop() noexcept;
+template Multiprocessing<4>& Machine<4>::smp();
+template bool Machine<4>::is_multiprocessing() const noexcept;
+template void Machine<4>::setup_multiprocessing(size_t);
+#endif
+#ifdef RISCV_64I
+template struct Multiprocessing<8>;
+template void Machine<8>::multiprocess(unsigned, uint64_t, address_type<8>, address_type<8>, address_type<8>, address_type<8>);
+template unsigned long Machine<8>::multiprocess_wait();
+template void Machine<8>::multiprocess_stop() noexcept;
+template Multiprocessing<8>& Machine<8>::smp();
+template bool Machine<8>::is_multiprocessing() const noexcept;
+template void Machine<8>::setup_multiprocessing(size_t);
+#endif
+#ifdef RISCV_128I
+template struct Multiprocessing<16>;
+template void Machine<16>::multiprocess(unsigned, uint64_t, address_type<16>, address_type<16>, address_type<16>, address_type<16>);
+template unsigned long Machine<16>::multiprocess_wait();
+template void Machine<16>::multiprocess_stop() noexcept;
+template Multiprocessing<16>& Machine<16>::smp();
+template bool Machine<16>::is_multiprocessing() const noexcept;
+template void Machine<16>::setup_multiprocessing(size_t);
+#endif
+} // riscv
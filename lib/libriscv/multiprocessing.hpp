@@ -0,0 +1,54 @@
+#pragma once
+#include "machine.hpp"
+#include "util/threadpool.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+namespace riscv {
+
+// Harts started by Machine::multiprocess(). Each hart is a fork of the
+// machine that shares its flat read-write arena, and it runs on its own
+// host thread from the pool.
+template <int W>
+struct Multiprocessing
+{
+	using address_t = address_type<W>;
+	// Failures are reported as a bitmask, one bit per hart
+	static constexpr unsigned MAX_HARTS = 8 * sizeof(unsigned long);
+	// Harts check for a stop request between quanta, and between
+	// slices of waiting on a futex
+	static constexpr uint64_t QUANTUM = 1'000'000;
+	static constexpr std::chrono::milliseconds WAIT_SLICE { 10 };
+
+	Multiprocessing(unsigned workers) : thread_pool(workers) {}
+
+	// While harts run in parallel, futexes wait and wake on the host,
+	// directly on the guest memory that the harts share.
+	void futex(Machine<W>&, address_t addr, int futex_op, int val, uint32_t val3);
+	// Ask every hart to stop, without waking them from the guest
+	void stop() noexcept { stopping = true; }
+	// Wait up to one slice for the harts to stop. Called by hart 0 only.
+	bool wait_for_harts();
+	// Hart 0 is waiting, and every running hart has been waiting on
+	// a futex without a timeout for (at least) a whole slice
+	bool deadlocked() noexcept;
+
+	ThreadPool thread_pool;
+	std::vector<std::unique_ptr<Machine<W>>> harts;
+	std::atomic<unsigned long> failures = 0;
+	std::atomic<bool> stopping = false;
+	// Harts that have not stopped yet, and how many of them
+	// are waiting on a futex without a timeout
+	std::atomic<unsigned> running = 0;
+	std::atomic<unsigned> blocked = 0;
+	// Changes on every futex wake, and every time a wait ends
+	std::atomic<uint64_t> activity = 0;
+	uint64_t last_activity = ~uint64_t(0);
+	std::mutex mutex;
+	std::condition_variable harts_stopped;
+	bool processing = false;
+};
+
+} // riscv
@@ -137,7 +137,11 @@ void Machine<W>::setup_native_heap(size_t sysnum, uint64_t base, size_t max_memo
 template <int W>
 void Machine<W>::transfer_arena_from(const Machine& other)
 {
-	m_arena.reset(new Arena(other.arena()));
+	// An existing arena keeps its unknown-chunk handlers
+	if (m_arena != nullptr)
+		other.arena().transfer(*m_arena);
+	else
+		m_arena.reset(new Arena(other.arena()));
 }
 
 template <int W>
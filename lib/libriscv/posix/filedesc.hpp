@@ -2,6 +2,7 @@
 #include <functional>
 #include <string>
 #include <map>
+#include <vector>
 #include "../types.hpp"
 
 #if defined(__APPLE__) || defined(__LINUX__)
@@ -50,6 +51,35 @@ struct FileDescriptors
 	bool permit_sockets = false;
 	bool proxy_mode = false;
 
+	// Asynchronous system calls: read, readv, ppoll and epoll_pwait no
+	// longer block the host thread. When a real FD is not ready, the
+	// machine stops with a pending wait instead, and the system call is
+	// restarted when the machine is resumed. The host is expected to wait
+	// for the pending FDs (eg. in its own epoll loop), or the deadline,
+	// and then resume the machine.
+	bool async_syscalls = false;
+
+	struct PendingWait {
+		struct Entry {
+			real_fd_type fd;
+			short events; // POLLIN, POLLOUT, ...
+		};
+		std::vector<Entry> fds;
+		// Absolute deadline in steady clock nanoseconds, or -1 for none
+		int64_t  deadline = -1;
+		// The suspended system call and the address of its ECALL
+		int      sysno = -1;
+		uint64_t pc = 0;
+	};
+	bool has_pending_wait() const noexcept { return pending_wait.sysno >= 0; }
+	const PendingWait& pending() const noexcept { return pending_wait; }
+	void clear_pending_wait() noexcept {
+		pending_wait.fds.clear();
+		pending_wait.deadline = -1;
+		pending_wait.sysno = -1;
+	}
+	PendingWait pending_wait;
+
 	std::function<bool(void*, std::string&)> filter_open = nullptr; /* NOTE: Can modify path */
 	std::function<bool(void*, std::string&)> filter_readlink = nullptr; /* NOTE: Can modify path */
 	std::function<bool(void*, const std::string&)> filter_stat = nullptr;
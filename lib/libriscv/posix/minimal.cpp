@@ -39,9 +39,7 @@ namespace riscv
 			riscv::vBuffer buffers[16];
 			const size_t cnt =
 				machine.memory.gather_buffers_from_range(16, buffers, address, len);
-			for (size_t i = 0; i < cnt; i++) {
-				machine.print(buffers[i].ptr, buffers[i].len);
-			}
+			machine.printv(buffers, cnt);
 			machine.set_result(len);
 			return;
 		}
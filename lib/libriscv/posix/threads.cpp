@@ -1,4 +1,7 @@
 #include "../threads.hpp"
+#ifdef RISCV_MULTIPROCESS
+#include "../multiprocessing.hpp"
+#endif
 
 namespace riscv {
 
@@ -14,6 +17,12 @@ static inline void futex_op(Machine<W>& machine,
 
 	THPRINT(machine, ">>> futex(0x%lX, op=%d (0x%X), val=%d val3=0x%X)\n",
 		(long)addr, futex_op & 0xF, futex_op, val, val3);
+#ifdef RISCV_MULTIPROCESS
+	if (machine.is_multiprocessing()) {
+		machine.smp().futex(machine, addr, futex_op, val, val3);
+		return;
+	}
+#endif
 
 	if ((futex_op & 0xF) == FUTEX_WAIT || (futex_op & 0xF) == FUTEX_WAIT_BITSET)
 	{
@@ -192,6 +201,13 @@ void Machine<W>::setup_posix_threads()
 		const auto  ptid = machine.template sysarg<address_type<W>> (4);
 		const auto   tls = machine.template sysarg<address_type<W>> (5);
 		const auto  ctid = machine.template sysarg<address_type<W>> (6);
+#ifdef RISCV_MULTIPROCESS
+		// Green threads cannot share host futexes with running harts
+		if (UNLIKELY(machine.is_multiprocessing())) {
+			machine.set_result(-EAGAIN);
+			return;
+		}
+#endif
 		auto* parent = machine.threads().get_thread();
 		auto* thread = machine.threads().create(flags, ctid, ptid, stack, tls, 0, 0);
 		THPRINT(machine,
@@ -228,6 +244,12 @@ void Machine<W>::setup_posix_threads()
 			machine.set_result(-ENOSPC);
 			return;
 		}
+#ifdef RISCV_MULTIPROCESS
+		if (UNLIKELY(machine.is_multiprocessing())) {
+			machine.set_result(-EAGAIN);
+			return;
+		}
+#endif
 
 		const int  flags = args.flags;
 		const auto stack = args.stack + args.stack_size;
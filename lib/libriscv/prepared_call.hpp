@@ -161,12 +161,85 @@ namespace riscv
 		this->store(m, m.address_of(func), std::forward<Args>(args)...);
 	}
 
+	/**
+	 * The argument registers of a function signature, worked out at compile
+	 * time. Signatures with arguments that are pushed on the stack (strings,
+	 * structs and vectors) are instead set up by Machine::setup_call().
+	**/
+	template <int W, typename F> struct PreparedCallLayout;
+	template <int W, typename R, typename... P>
+	struct PreparedCallLayout<W, R(P...)>
+	{
+		template <typename T>
+		static constexpr bool is_float_arg = std::is_same_v<T, float> || std::is_same_v<T, double>;
+		template <typename T>
+		static constexpr unsigned integer_regs =
+			(std::is_integral_v<T> || std::is_enum_v<T>) ? ((sizeof(T) > W) ? 2 : 1) : 0;
+
+		static constexpr unsigned INTEGER_ARGS = (integer_regs<remove_cvref<P>> + ... + 0u);
+		static constexpr unsigned FLOAT_ARGS = (unsigned(is_float_arg<remove_cvref<P>>) + ... + 0u);
+		static constexpr bool in_registers =
+			((integer_regs<remove_cvref<P>> != 0 || is_float_arg<remove_cvref<P>>) && ...)
+			&& INTEGER_ARGS <= 8 && FLOAT_ARGS <= 8;
+
+		// The integer or floating-point register of each argument
+		static constexpr auto REGISTERS = [] {
+			std::array<unsigned, sizeof...(P) + 1> regs {};
+			[[maybe_unused]] unsigned i = 0, iarg = REG_ARG0, farg = REG_FA0;
+			([&] {
+				if constexpr (is_float_arg<remove_cvref<P>>)
+					regs[i++] = farg++;
+				else {
+					regs[i++] = iarg;
+					iarg += integer_regs<remove_cvref<P>>;
+				}
+			}(), ...);
+			return regs;
+		}();
+
+		template <typename... Args>
+		static void set_registers(Registers<W>& regs, Args&&... args)
+		{
+			set_registers(regs, std::index_sequence_for<P...>{}, std::forward<Args>(args)...);
+		}
+
+	private:
+		template <size_t... I, typename... Args>
+		static void set_registers(Registers<W>& regs, std::index_sequence<I...>, Args&&... args)
+		{
+			(set_register<remove_cvref<P>, REGISTERS[I]>(regs, std::forward<Args>(args)), ...);
+		}
+
+		template <typename T, unsigned REG, typename A>
+		static void set_register(Registers<W>& regs, A&& arg)
+		{
+			// Arguments are converted to the types in the signature
+			const T value = static_cast<T>(arg);
+			if constexpr (std::is_same_v<T, float>)
+				regs.getfl(REG).set_float(value);
+			else if constexpr (std::is_same_v<T, double>)
+				regs.getfl(REG).f64 = value;
+			else if constexpr (std::is_enum_v<T>)
+				regs.get(REG) = int(value);
+			else {
+				regs.get(REG) = value;
+				if constexpr (sizeof(T) > W) // upper 32-bits for 64-bit integers
+					regs.get(REG + 1) = value >> 32;
+			}
+		}
+	};
+
 	/**
 	 * A prepared vmcall makes preparations for a given type of call
 	 * by recording the PC, max instructions, and enforcing a function type
 	 * 
 	 * A fast-path is attempted to be created, which allows the function
 	 * to return by directly stopping the simulation and returning.
+	 * 
+	 * Arguments that fit in registers are written straight to the registers
+	 * worked out for the signature, and the execute segment of the function
+	 * is kept alive and entered directly. Without an instruction limit the
+	 * call is made without counting instructions, like Machine::vmcall().
 	**/
 	template <int W, typename F, uint64_t IMAX = UINT64_MAX, bool UseFastPath = true>
 	struct PreparedCall
@@ -174,16 +247,36 @@ namespace riscv
 	public:
 		using address_t = address_type<W>;
 		using Ret = std::function<F>::result_type;
+		using Layout = PreparedCallLayout<W, F>;
 
 		template <typename... Args>
 		auto call_with(Machine<W>& m, Args&&... args) const
 		{
 			static_assert(std::is_invocable_v<F, Args...>,
 				"PreparedCall: Invalid argument types for function call");
+			auto& cpu = m.cpu;
+
+			cpu.reset_stack_pointer();
+			if constexpr (Layout::in_registers) {
+				cpu.reg(REG_RA) = m.memory.exit_address();
+				Layout::set_registers(cpu.registers(), std::forward<Args>(args)...);
+				cpu.reg(REG_SP) &= ~address_t(0xF);
+			} else {
+				m.setup_call(std::forward<Args>(args)...);
+			}
 
-			m.cpu.reset_stack_pointer();
-			m.setup_call(std::forward<Args>(args)...);
-			m.simulate_with(IMAX, 0, m_pc);
+			if (UNLIKELY(&cpu.current_execute_segment() != m_exec.get()))
+				this->enter_execute_segment(m);
+			if constexpr (IMAX == UINT64_MAX) {
+#ifdef RISCV_BINARY_TRANSLATION
+				if (UNLIKELY(m.memory.uses_guard_paged_arena()))
+					cpu.simulate_guarded(m_pc, 0u, UINT64_MAX);
+				else
+#endif
+				cpu.simulate_inaccurate(m_pc);
+			} else {
+				m.simulate_with(IMAX, 0, m_pc);
+			}
 
 			if constexpr (std::is_same_v<Ret, float>)
 				return m.cpu.registers().getfl(REG_RETVAL).f32[0];
@@ -228,6 +321,8 @@ namespace riscv
 
 			this->m_machine = &m;
 			this->m_pc = pc;
+			// Keep the execute segment of the function alive
+			this->m_exec = m.memory.exec_segment_for(pc);
 
 			if constexpr (UseFastPath) {
 				// Try to create a fast path function
@@ -262,14 +357,26 @@ namespace riscv
 			}
 		}
 		PreparedCall(const PreparedCall& other)
-			: m_machine(other.m_machine), m_pc(other.m_pc)
+			: m_machine(other.m_machine), m_pc(other.m_pc), m_exec(other.m_exec)
 		{
 		}
 		~PreparedCall() = default;
 
 	private:
+		// The pinned segment is only entered while memory still
+		// maps the function to it, eg. not after a fork reset.
+		void enter_execute_segment(Machine<W>& m) const
+		{
+			const auto& segment = m.memory.exec_segment_for(m_pc);
+			if (!segment->empty() && !segment->is_stale()) {
+				this->m_exec = segment;
+				m.cpu.set_execute_segment(*segment);
+			}
+		}
+
 		Machine<W>* m_machine = nullptr;
 		address_t   m_pc = 0;
+		mutable std::shared_ptr<DecodedExecuteSegment<W>> m_exec = nullptr;
 	};
 
 } // riscv
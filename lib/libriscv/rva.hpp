@@ -17,6 +17,11 @@ namespace riscv
 			m_reservation = addr;
 			return true;
 		}
+		// The value loaded by LR. SC compares it against memory, and only
+		// stores when it is unchanged, using a compare-and-swap. That way
+		// stores from other harts sharing the memory make the SC fail.
+		void set_reserved_value(address_t value) noexcept { m_reserved_value = value; }
+		address_t reserved_value() const noexcept { return m_reserved_value; }
 
 		// Volume I: RISC-V Unprivileged ISA V20190608 p.49:
 		// An SC can only pair with the most recent LR in program order.
@@ -39,5 +44,6 @@ namespace riscv
 		}
 
 		address_t m_reservation = 0x0;
+		address_t m_reserved_value = 0x0;
 	};
 }
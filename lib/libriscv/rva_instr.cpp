@@ -47,6 +47,38 @@ namespace riscv
 		}
 	}
 
+	// Read-modify-write for the AMOs that have no host atomic equivalent
+	template <typename Type, typename F>
+	static inline Type amo_fetch_update(Type& value, F&& func)
+	{
+#if USE_ATOMIC_OPS
+		std::atomic_ref<Type> ref(value);
+		Type old_value = ref.load(std::memory_order_relaxed);
+		while (!ref.compare_exchange_weak(old_value, func(old_value)));
+		return old_value;
+#else
+		const Type old_value = value;
+		value = func(old_value);
+		return old_value;
+#endif
+	}
+
+	// SC only stores when memory still holds the value loaded by LR
+	template <typename Type, int W>
+	static inline bool store_conditional_exchange(CPU<W>& cpu, address_type<W> addr, Type value)
+	{
+		Type& mem = cpu.machine().memory.template writable_read<Type> (addr);
+		Type expected = static_cast<Type> (cpu.atomics().reserved_value());
+#if USE_ATOMIC_OPS
+		if constexpr (sizeof(Type) <= 8)
+			return std::atomic_ref<Type>(mem).compare_exchange_strong(expected, value);
+#endif
+		if (mem != expected)
+			return false;
+		mem = value;
+		return true;
+	}
+
 	ATOMIC_INSTR(AMOADD_W,
 	[] (auto& cpu, rv32i_instruction instr) RVINSTR_COLDATTR
 	{
@@ -120,9 +152,8 @@ namespace riscv
 	{
 		cpu.template amo<int32_t>(instr,
 		[] (auto& cpu, auto& value, auto rs2) {
-			auto old_val = value;
-			value = std::max(value, (int32_t)cpu.reg(rs2));
-			return old_val;
+			const int32_t operand = (int32_t)cpu.reg(rs2);
+			return amo_fetch_update(value, [=] (int32_t old) { return std::max(old, operand); });
 		});
 	}, DECODED_ATOMIC(AMOADD_W).printer);
 
@@ -131,9 +162,8 @@ namespace riscv
 	{
 		cpu.template amo<int32_t>(instr,
 		[] (auto& cpu, auto& value, auto rs2) {
-			auto old_val = value;
-			value = std::min(value, (int32_t)cpu.reg(rs2));
-			return old_val;
+			const int32_t operand = (int32_t)cpu.reg(rs2);
+			return amo_fetch_update(value, [=] (int32_t old) { return std::min(old, operand); });
 		});
 	}, DECODED_ATOMIC(AMOADD_W).printer);
 
@@ -142,9 +172,8 @@ namespace riscv
 	{
 		cpu.template amo<uint32_t>(instr,
 		[] (auto& cpu, auto& value, auto rs2) {
-			auto old_val = value;
-			value = std::max(value, (uint32_t)cpu.reg(rs2));
-			return old_val;
+			const uint32_t operand = (uint32_t)cpu.reg(rs2);
+			return amo_fetch_update(value, [=] (uint32_t old) { return std::max(old, operand); });
 		});
 	}, DECODED_ATOMIC(AMOADD_W).printer);
 
@@ -153,9 +182,8 @@ namespace riscv
 	{
 		cpu.template amo<uint32_t>(instr,
 		[] (auto& cpu, auto& value, auto rs2) {
-			auto old_val = value;
-			value = std::min(value, (uint32_t)cpu.reg(rs2));
-			return old_val;
+			const uint32_t operand = (uint32_t)cpu.reg(rs2);
+			return amo_fetch_update(value, [=] (uint32_t old) { return std::min(old, operand); });
 		});
 	}, DECODED_ATOMIC(AMOADD_W).printer);
 
@@ -224,9 +252,8 @@ namespace riscv
 	{
 		cpu.template amo<int64_t>(instr,
 		[] (auto& cpu, auto& value, auto rs2) {
-			auto old_val = value;
-			value = std::max(value, int64_t(cpu.reg(rs2)));
-			return old_val;
+			const int64_t operand = int64_t(cpu.reg(rs2));
+			return amo_fetch_update(value, [=] (int64_t old) { return std::max(old, operand); });
 		});
 	}, DECODED_ATOMIC(AMOADD_W).printer);
 
@@ -235,9 +262,8 @@ namespace riscv
 	{
 		cpu.template amo<int64_t>(instr,
 		[] (auto& cpu, auto& value, auto rs2) {
-			auto old_val = value;
-			value = std::min(value, int64_t(cpu.reg(rs2)));
-			return old_val;
+			const int64_t operand = int64_t(cpu.reg(rs2));
+			return amo_fetch_update(value, [=] (int64_t old) { return std::min(old, operand); });
 		});
 	}, DECODED_ATOMIC(AMOADD_W).printer);
 
@@ -246,9 +272,8 @@ namespace riscv
 	{
 		cpu.template amo<uint64_t>(instr,
 		[] (auto& cpu, auto& value, auto rs2) {
-			auto old_val = value;
-			value = std::max(value, (uint64_t)cpu.reg(rs2));
-			return old_val;
+			const uint64_t operand = (uint64_t)cpu.reg(rs2);
+			return amo_fetch_update(value, [=] (uint64_t old) { return std::max(old, operand); });
 		});
 	}, DECODED_ATOMIC(AMOADD_W).printer);
 
@@ -257,9 +282,8 @@ namespace riscv
 	{
 		cpu.template amo<uint64_t>(instr,
 		[] (auto& cpu, auto& value, auto rs2) {
-			auto old_val = value;
-			value = std::min(value, (uint64_t)cpu.reg(rs2));
-			return old_val;
+			const uint64_t operand = (uint64_t)cpu.reg(rs2);
+			return amo_fetch_update(value, [=] (uint64_t old) { return std::min(old, operand); });
 		});
 	}, DECODED_ATOMIC(AMOADD_W).printer);
 
@@ -311,6 +335,7 @@ namespace riscv
 			if (!cpu.atomics().load_reserve(4, addr))
 				cpu.trigger_exception(DEADLOCK_REACHED);
 			value = (int32_t)cpu.machine().memory.template read<uint32_t> (addr);
+			cpu.atomics().set_reserved_value(uint32_t(value));
 		}
 		else if (instr.Atype.funct3 == AMOSIZE_D)
 		{
@@ -318,6 +343,7 @@ namespace riscv
 				if (!cpu.atomics().load_reserve(8, addr))
 					cpu.trigger_exception(DEADLOCK_REACHED);
 				value = (int64_t)cpu.machine().memory.template read<uint64_t> (addr);
+				cpu.atomics().set_reserved_value(value);
 			} else
 				cpu.trigger_exception(ILLEGAL_OPCODE);
 		}
@@ -327,6 +353,7 @@ namespace riscv
 				if (!cpu.atomics().load_reserve(16, addr))
 					cpu.trigger_exception(DEADLOCK_REACHED);
 				value = cpu.machine().memory.template read<RVREGTYPE(cpu)> (addr);
+				cpu.atomics().set_reserved_value(value);
 			} else
 				cpu.trigger_exception(ILLEGAL_OPCODE);
 		}
@@ -351,28 +378,22 @@ namespace riscv
 		bool resv = false;
 		if (instr.Atype.funct3 == AMOSIZE_W)
 		{
-			resv = cpu.atomics().store_conditional(4, addr);
-			if (resv) {
-				cpu.machine().memory.template write<uint32_t> (addr, cpu.reg(instr.Atype.rs2));
-			}
+			resv = cpu.atomics().store_conditional(4, addr)
+				&& store_conditional_exchange<uint32_t>(cpu, addr, cpu.reg(instr.Atype.rs2));
 		}
 		else if (instr.Atype.funct3 == AMOSIZE_D)
 		{
 			if constexpr (RVISGE64BIT(cpu)) {
-				resv = cpu.atomics().store_conditional(8, addr);
-				if (resv) {
-					cpu.machine().memory.template write<uint64_t> (addr, cpu.reg(instr.Atype.rs2));
-				}
+				resv = cpu.atomics().store_conditional(8, addr)
+					&& store_conditional_exchange<uint64_t>(cpu, addr, cpu.reg(instr.Atype.rs2));
 			} else
 				cpu.trigger_exception(ILLEGAL_OPCODE);
 		}
 		else if (instr.Atype.funct3 == AMOSIZE_Q)
 		{
 			if constexpr (RVIS128BIT(cpu)) {
-				resv = cpu.atomics().store_conditional(16, addr);
-				if (resv) {
-					cpu.machine().memory.template write<RVREGTYPE(cpu)> (addr, cpu.reg(instr.Atype.rs2));
-				}
+				resv = cpu.atomics().store_conditional(16, addr)
+					&& store_conditional_exchange<RVREGTYPE(cpu)>(cpu, addr, cpu.reg(instr.Atype.rs2));
 			} else
 				cpu.trigger_exception(ILLEGAL_OPCODE);
 		}
@@ -1,6 +1,19 @@
 #include <libriscv/machine.hpp>
 
 #include "internal_common.hpp"
+#include "util/crc32.hpp"
+#include <algorithm>
+#include <thread>
+#include <unordered_map>
+#if defined(__linux__) || defined(__FreeBSD__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define SNAPSHOT_MMAP_ENABLED
+#else
+#include <fstream>
+#endif
 #ifdef __GNUG__
 #define RISCV_PACKED __attribute__((packed))
 #else
@@ -193,6 +206,7 @@ namespace riscv
 		this->clear_all_pages();
 #endif
 		this->evict_execute_segments();
+		this->m_snapshot_mapping = nullptr;
 
 #ifdef RISCV_VIRTUAL_PAGING
 		size_t off = state.mem_offset;
@@ -241,6 +255,559 @@ namespace riscv
 #endif // RISCV_VIRTUAL_PAGING
 	}
 
+	/** Incremental (delta) snapshots **/
+
+	static const uint64_t DELTA_MAGIC_VALUE = 0x5a1d7e4c0de1ba5e;
+	template <int W>
+	struct SerializedDelta
+	{
+		using address_t = address_type<W>;
+
+		uint64_t magic;
+		uint64_t id;        // Identifies this snapshot
+		uint64_t parent_id; // The snapshot this one is based on, or 0
+		uint32_t n_pages;     // Pages in the complete page table
+		uint32_t n_datapages; // Pages with data stored in this snapshot
+		uint16_t reg_size;
+		uint16_t page_size;
+		uint16_t attr_size;
+		uint16_t serp_size;
+		uint32_t table_offset;
+		uint64_t data_offset; // Page-aligned
+
+		Registers<W> registers;
+		uint64_t     counter;
+
+		address_t start_address = 0;
+		address_t stack_address = 0;
+		address_t mmap_address  = 0;
+		address_t heap_address  = 0;
+		address_t exit_address  = 0;
+	};
+	struct SerializedDeltaPage
+	{
+		static constexpr uint32_t NO_DATA = UINT32_MAX;
+		static constexpr uint8_t PAGED = 0x1; // Has a page table entry
+
+		uint64_t addr; // Page number
+		uint64_t hash; // Hash of the page contents, 0 when there is no data
+		uint32_t data_index; // Data in this snapshot, or NO_DATA when in an older one
+		uint8_t  flags;
+		uint8_t  padding[3] {0};
+		PageAttributes attr;
+	};
+	static_assert(sizeof(PageAttributes) == 8 && sizeof(SerializedDeltaPage) == 32,
+		"The delta page table layout is part of the snapshot format");
+
+	static uint64_t page_hash(const PageData& page)
+	{
+		// Two independent CRC32-C over each half of the page
+		static constexpr size_t HALF = sizeof(PageData) / 2;
+		const uint64_t hash = (uint64_t(crc32c(page.buffer8.data(), HALF)) << 32)
+			| crc32c(page.buffer8.data() + HALF, HALF);
+		return (hash != 0) ? hash : 1; // 0 means no data
+	}
+
+	template <int W>
+	static const SerializedDelta<W>* delta_header(const uint8_t* data, size_t size)
+	{
+		if (size < sizeof(SerializedDelta<W>))
+			return nullptr;
+		const auto* hdr = (const SerializedDelta<W>*) data;
+		if (hdr->magic != DELTA_MAGIC_VALUE
+			|| hdr->reg_size != sizeof(Registers<W>)
+			|| hdr->page_size != Page::size()
+			|| hdr->attr_size != sizeof(PageAttributes)
+			|| hdr->serp_size != sizeof(SerializedDeltaPage))
+			return nullptr;
+		if (hdr->table_offset + uint64_t(hdr->n_pages) * sizeof(SerializedDeltaPage) > size
+			|| hdr->data_offset + uint64_t(hdr->n_datapages) * sizeof(PageData) > size)
+			return nullptr;
+		return hdr;
+	}
+	template <int W>
+	static const SerializedDelta<W>* delta_header(const std::vector<uint8_t>& vec)
+	{
+		return delta_header<W>(vec.data(), vec.size());
+	}
+	template <int W>
+	static const SerializedDeltaPage* delta_table(const std::vector<uint8_t>& vec)
+	{
+		const auto* hdr = (const SerializedDelta<W>*) vec.data();
+		return (const SerializedDeltaPage*) &vec[hdr->table_offset];
+	}
+
+	template <int W>
+	size_t Machine<W>::serialize_delta_to(std::vector<uint8_t>& vec,
+		const std::vector<uint8_t>* base, bool use_dirty_pages) const
+	{
+		const size_t before = vec.size();
+		const SerializedDelta<W>* base_header = nullptr;
+		if (base != nullptr) {
+			base_header = delta_header<W>(*base);
+			if (base_header == nullptr)
+				throw MachineException(INVALID_PROGRAM, "Base snapshot was invalid");
+		}
+
+		SerializedDelta<W> header {
+			.magic     = DELTA_MAGIC_VALUE,
+			.id        = 0,
+			.parent_id = (base_header) ? base_header->id : 0,
+			.n_pages   = 0,
+			.n_datapages = 0,
+			.reg_size  = sizeof(Registers<W>),
+			.page_size = Page::size(),
+			.attr_size = sizeof(PageAttributes),
+			.serp_size = sizeof(SerializedDeltaPage),
+			.table_offset = sizeof(SerializedDelta<W>),
+			.data_offset  = 0,
+
+			.registers = cpu.registers(),
+			.counter   = this->instruction_counter(),
+
+			.start_address = memory.start_address(),
+			.stack_address = memory.stack_initial(),
+			.mmap_address  = memory.mmap_address(),
+			.heap_address  = memory.heap_address(),
+			.exit_address  = memory.exit_address(),
+		};
+		// The header is written last, when the page counts are known
+		vec.resize(before + sizeof(header));
+		this->memory.serialize_delta_to(vec, before, header, base, use_dirty_pages);
+
+		// The ID covers the page table and registers, and is chained to the parent
+		const auto* table = &vec[before + header.table_offset];
+		const size_t table_bytes = header.n_pages * sizeof(SerializedDeltaPage);
+		header.id = (uint64_t(crc32c(uint32_t(header.parent_id), table, table_bytes)) << 32)
+			| crc32c(uint32_t(header.parent_id >> 32), &header.registers, sizeof(header.registers));
+		header.id ^= header.counter;
+		std::memcpy(&vec[before], &header, sizeof(header));
+
+		return vec.size() - before;
+	}
+
+	template <int W>
+	void Memory<W>::serialize_delta_to(std::vector<uint8_t>& vec, size_t start,
+		SerializedDelta<W>& header, const std::vector<uint8_t>* base, bool use_dirty_pages) const
+	{
+		// Page hashes of the base snapshot
+		std::unordered_map<uint64_t, uint64_t> base_hashes;
+		if (base != nullptr) {
+			const auto* base_header = (const SerializedDelta<W>*) base->data();
+			const auto* base_table = delta_table<W>(*base);
+			base_hashes.reserve(base_header->n_pages);
+			for (size_t i = 0; i < base_header->n_pages; i++)
+				base_hashes.emplace(base_table[i].addr, base_table[i].hash);
+		}
+		use_dirty_pages = use_dirty_pages && base != nullptr && this->tracks_dirty_pages();
+
+		std::vector<SerializedDeltaPage> table;
+		std::vector<const PageData*> datapages;
+		auto add_page = [&] (uint64_t pageno, const PageData* data, uint8_t flags, PageAttributes attr, uint64_t hash)
+		{
+			SerializedDeltaPage spage {
+				.addr = pageno,
+				.hash = hash,
+				.data_index = SerializedDeltaPage::NO_DATA,
+				.flags = flags,
+				.attr  = attr,
+			};
+			// Make all pages owned from now on
+			spage.attr.is_cow = false;
+			spage.attr.non_owning = false;
+			if (hash != 0) {
+				auto it = base_hashes.find(pageno);
+				if (it == base_hashes.end() || it->second != hash) {
+					spage.data_index = datapages.size();
+					datapages.push_back(data);
+				}
+			}
+			table.push_back(spage);
+		};
+		// Clean arena pages can reuse the hash from the base snapshot
+		auto hash_of = [&] (uint64_t pageno, const PageData& data) -> uint64_t
+		{
+			if (use_dirty_pages && pageno < m_arena.pages && &data == &m_arena.data[pageno]
+				&& !this->is_dirty_page(pageno))
+			{
+				auto it = base_hashes.find(pageno);
+				if (it != base_hashes.end())
+					return it->second;
+			}
+			return page_hash(data);
+		};
+
+#ifdef RISCV_VIRTUAL_PAGING
+		table.reserve(m_pages.size());
+		for (const auto& it : m_pages)
+		{
+			const auto& page = it.second;
+			// The zero-page (and other guard pages) have no data
+			const uint64_t hash = page.is_cow_page() ? 0 : hash_of(it.first, page.page());
+			add_page(it.first, &page.page(), SerializedDeltaPage::PAGED, page.attr, hash);
+		}
+#endif
+		// Arena pages without a page table entry. All-zero pages are skipped,
+		// as the arena is cleared on restore.
+		static const uint64_t zero_hash = page_hash(PageData{});
+		for (address_t pageno = 0; pageno < m_arena.pages; pageno++)
+		{
+#ifdef RISCV_VIRTUAL_PAGING
+			if (m_pages.count(pageno) != 0)
+				continue;
+#endif
+			if (use_dirty_pages && !this->is_dirty_page(pageno) && base_hashes.count(pageno) == 0)
+				continue; // Still a zero-page
+			const uint64_t hash = hash_of(pageno, m_arena.data[pageno]);
+			if (hash == zero_hash)
+				continue;
+			add_page(pageno, &m_arena.data[pageno], 0x0, PageAttributes{}, hash);
+		}
+		// Deterministic order, so that equal states produce equal snapshots.
+		// Page data is stored in the same order, so that consecutive pages
+		// can be memory-mapped together (see deserialize_mapped_from()).
+		std::sort(table.begin(), table.end(),
+			[] (const auto& a, const auto& b) { return a.addr < b.addr; });
+		std::vector<const PageData*> ordered;
+		ordered.reserve(datapages.size());
+		for (auto& spage : table) {
+			if (spage.data_index != SerializedDeltaPage::NO_DATA) {
+				ordered.push_back(datapages[spage.data_index]);
+				spage.data_index = ordered.size() - 1;
+			}
+		}
+		datapages = std::move(ordered);
+
+		const size_t table_bytes = table.size() * sizeof(SerializedDeltaPage);
+		// Page data starts page-aligned (relative to the snapshot)
+		const size_t data_offset = (sizeof(SerializedDelta<W>) + table_bytes + Page::size() - 1) & ~size_t(Page::size() - 1);
+		vec.resize(start + data_offset + datapages.size() * sizeof(PageData));
+		std::memcpy(&vec[start + header.table_offset], table.data(), table_bytes);
+		auto* dst = &vec[start + data_offset];
+		for (const auto* data : datapages) {
+			std::memcpy(dst, data, sizeof(PageData));
+			dst += sizeof(PageData);
+		}
+
+		header.n_pages = table.size();
+		header.n_datapages = datapages.size();
+		header.data_offset = data_offset;
+	}
+
+	template <int W>
+	int Machine<W>::deserialize_delta_from(const std::vector<const std::vector<uint8_t>*>& chain, unsigned threads)
+	{
+		if (chain.empty())
+			return -1;
+		// Each snapshot must be based on the previous one
+		uint64_t parent_id = 0;
+		for (const auto* snapshot : chain) {
+			const auto* header = delta_header<W>(*snapshot);
+			if (header == nullptr)
+				return -1;
+			if (header->parent_id != parent_id)
+				return -2;
+			parent_id = header->id;
+		}
+		const auto& header = *(const SerializedDelta<W>*) chain.back()->data();
+
+		this->m_counter = header.counter;
+		this->m_max_counter = 0;
+		cpu.registers() = header.registers;
+		cpu.set_execute_segment(*CPU<W>::empty_execute_segment());
+		memory.deserialize_delta_from(chain, threads);
+		return 0;
+	}
+
+	template <int W>
+	void Memory<W>::reset_for_snapshot(const SerializedDelta<W>& header)
+	{
+		this->m_start_address = header.start_address;
+		this->m_stack_address = header.stack_address;
+		this->m_mmap_address  = header.mmap_address;
+		this->m_heap_address  = header.heap_address;
+		this->m_exit_address  = header.exit_address;
+		this->m_mmap_cache    = {};
+#ifdef RISCV_EXT_ATOMICS
+		this->m_atomics = {};
+#endif
+
+		// Completely reset memory, as all pages will be replaced
+#ifdef RISCV_VIRTUAL_PAGING
+		this->clear_all_pages();
+#endif
+		this->evict_execute_segments();
+		// No page refers to a previous snapshot mapping anymore
+		this->m_snapshot_mapping = nullptr;
+#ifdef SNAPSHOT_MMAP_ENABLED
+		if (m_arena.file_mapped) {
+			// Replace file-backed arena pages with anonymous memory again
+			void* ptr = mmap(m_arena.data, m_arena.pages * Page::size(), PROT_READ | PROT_WRITE,
+				MAP_ANONYMOUS | MAP_PRIVATE | MAP_NORESERVE | MAP_FIXED, -1, 0);
+			if (ptr == MAP_FAILED)
+				throw MachineException(OUT_OF_MEMORY, "Unable to reset the memory arena", m_arena.pages * Page::size());
+			m_arena.file_mapped = false;
+		}
+#endif
+		if (m_arena.data != nullptr && m_arena.pages > 0)
+			this->arena_discard(0, m_arena.pages * Page::size());
+	}
+
+	template <int W>
+	void Memory<W>::deserialize_delta_from(const std::vector<const std::vector<uint8_t>*>& chain, unsigned threads)
+	{
+		const auto& newest = *chain.back();
+		const auto& header = *(const SerializedDelta<W>*) newest.data();
+
+		// Pages without data in the newest snapshot are stored by older ones
+		std::vector<std::unordered_map<uint64_t, const SerializedDeltaPage*>> older(chain.size() - 1);
+		for (size_t i = 0; i < older.size(); i++)
+		{
+			const auto& snapshot = *chain[i];
+			const auto& hdr = *(const SerializedDelta<W>*) snapshot.data();
+			if (hdr.n_pages == 0)
+				continue;
+			const auto* table = delta_table<W>(snapshot);
+			for (size_t p = 0; p < hdr.n_pages; p++)
+				if (table[p].data_index != SerializedDeltaPage::NO_DATA)
+					older[i].emplace(table[p].addr, &table[p]);
+		}
+		auto find_data = [&] (const SerializedDeltaPage& spage) -> const uint8_t*
+		{
+			for (size_t i = chain.size() - 1; i-- > 0; )
+			{
+				const auto& index = older[i];
+				const auto& snapshot = *chain[i];
+				const auto& hdr = *(const SerializedDelta<W>*) snapshot.data();
+				auto it = index.find(spage.addr);
+				if (it != index.end() && it->second->hash == spage.hash) {
+					if (it->second->data_index >= hdr.n_datapages)
+						break;
+					return &snapshot[hdr.data_offset + it->second->data_index * sizeof(PageData)];
+				}
+			}
+			throw MachineException(INVALID_PROGRAM, "Snapshot chain is missing page data", spage.addr);
+		};
+
+		this->reset_for_snapshot(header);
+
+		struct Copy {
+			void* dst;
+			const uint8_t* src;
+		};
+		std::vector<Copy> copies;
+		copies.reserve(header.n_pages);
+
+		const auto* table = delta_table<W>(newest);
+		for (size_t i = 0; i < header.n_pages; i++)
+		{
+			const auto& spage = table[i];
+			if (spage.data_index != SerializedDeltaPage::NO_DATA && spage.data_index >= header.n_datapages)
+				throw MachineException(INVALID_PROGRAM, "Serialized machine state was invalid", spage.addr);
+			const address_t pageno = spage.addr;
+			PageData* dst = nullptr;
+			if (pageno < m_arena.pages)
+				dst = &m_arena.data[pageno];
+#ifdef RISCV_VIRTUAL_PAGING
+			if (spage.hash == 0) {
+				// Pages without data
+				m_pages.try_emplace(pageno, spage.attr, Page::cow_page().m_page.get());
+				continue;
+			}
+			if (dst != nullptr) {
+				if (spage.flags & SerializedDeltaPage::PAGED) {
+					// Create new non-owning arena page
+					PageAttributes attr = spage.attr;
+					attr.non_owning = true;
+					m_pages.try_emplace(pageno, attr, dst);
+				}
+			} else {
+				// Create new uninitialized page
+				auto result = m_pages.try_emplace(pageno, spage.attr, PageData::UNINITIALIZED);
+				dst = &result.first->second.page();
+			}
+#else
+			if (dst == nullptr || spage.hash == 0)
+				throw MachineException(INVALID_PROGRAM, "Serialized page is outside of the memory arena", spage.addr);
+#endif
+			const uint8_t* src = (spage.data_index != SerializedDeltaPage::NO_DATA)
+				? &newest[header.data_offset + spage.data_index * sizeof(PageData)]
+				: find_data(spage);
+			copies.push_back({dst, src});
+		}
+#ifdef RISCV_VIRTUAL_PAGING
+		// page tables have been changed
+		this->invalidate_reset_cache();
+#endif
+
+		// Copying page data is independent, and can be split between threads
+		auto copy_range = [&copies] (size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++)
+				std::memcpy(copies[i].dst, copies[i].src, sizeof(PageData));
+		};
+		threads = std::max(1u, std::min<unsigned>(threads, copies.size() / 64));
+		const size_t per_thread = (copies.size() + threads - 1) / threads;
+		std::vector<std::thread> workers;
+		for (unsigned t = 1; t < threads; t++) {
+			const size_t begin = std::min(copies.size(), t * per_thread);
+			const size_t end = std::min(copies.size(), begin + per_thread);
+			workers.emplace_back(copy_range, begin, end);
+		}
+		copy_range(0, std::min(copies.size(), per_thread));
+		for (auto& worker : workers)
+			worker.join();
+	}
+
+	/** Memory-mapped snapshots **/
+
+	template <int W>
+	int Machine<W>::deserialize_mapped_from(const std::string& filename)
+	{
+#ifdef SNAPSHOT_MMAP_ENABLED
+		struct FileDescriptor {
+			const int fd;
+			~FileDescriptor() { if (fd >= 0) close(fd); }
+		} file { open(filename.c_str(), O_RDONLY | O_CLOEXEC) };
+		struct stat st;
+		if (file.fd < 0 || fstat(file.fd, &st) != 0)
+			return -1;
+		const size_t size = st.st_size;
+		if (size < sizeof(SerializedDelta<W>))
+			return -1;
+		// A private mapping keeps writes to restored pages local to this machine
+		void* ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, file.fd, 0);
+		if (ptr == MAP_FAILED)
+			return -1;
+		std::shared_ptr<void> mapping { ptr, [size] (void* p) { munmap(p, size); } };
+
+		const auto* header = delta_header<W>((const uint8_t*)ptr, size);
+		if (header == nullptr)
+			return -1;
+		// Deltas need the data of the snapshots they are based on
+		if (header->parent_id != 0)
+			return -2;
+
+		this->m_counter = header->counter;
+		this->m_max_counter = 0;
+		cpu.registers() = header->registers;
+		cpu.set_execute_segment(*CPU<W>::empty_execute_segment());
+		memory.deserialize_mapped_from(std::move(mapping), size, file.fd);
+		return 0;
+#else
+		// Without mmap() the snapshot is read and restored as usual
+		std::ifstream file(filename, std::ios::binary);
+		if (!file)
+			return -1;
+		const std::vector<uint8_t> vec { std::istreambuf_iterator<char>(file), {} };
+		const auto* header = delta_header<W>(vec);
+		if (header != nullptr && header->parent_id != 0)
+			return -2;
+		return this->deserialize_delta_from({&vec});
+#endif
+	}
+
+	template <int W>
+	void Memory<W>::deserialize_mapped_from(std::shared_ptr<void> mapping, size_t size, int fd)
+	{
+#ifdef SNAPSHOT_MMAP_ENABLED
+		const auto* snapshot = (uint8_t *)mapping.get();
+		const auto& header = *delta_header<W>(snapshot, size);
+		this->reset_for_snapshot(header);
+
+		// Arena pages can only be mapped directly from the file when the
+		// arena is a regular private mapping with the same page size.
+		// A forkable arena is shared with its forks through a memfd.
+		const bool map_arena = m_arena.data != nullptr && m_arena.memfd < 0
+			&& !m_arena.private_mapping && !this->is_forked()
+			&& size_t(sysconf(_SC_PAGESIZE)) == Page::size();
+		auto map_arena_run = [&] (address_t pageno, size_t data_index, size_t count)
+		{
+			auto* dst = &m_arena.data[pageno];
+			const size_t offset = header.data_offset + data_index * sizeof(PageData);
+			const size_t len = count * sizeof(PageData);
+			// Restored pages count as written, whether mapped or copied
+			this->mark_dirty_range(pageno * Page::size(), len);
+			if (map_arena) {
+				void* ptr = mmap(dst, len, PROT_READ | PROT_WRITE,
+					MAP_PRIVATE | MAP_FIXED, fd, offset);
+				if (ptr != MAP_FAILED) {
+					m_arena.file_mapped = true;
+					return;
+				}
+				// A failed MAP_FIXED may have unmapped the range
+				ptr = mmap(dst, len, PROT_READ | PROT_WRITE,
+					MAP_ANONYMOUS | MAP_PRIVATE | MAP_NORESERVE | MAP_FIXED, -1, 0);
+				if (ptr == MAP_FAILED)
+					throw MachineException(OUT_OF_MEMORY, "Unable to restore the memory arena", len);
+			}
+			std::memcpy((void *)dst, &snapshot[offset], len);
+		};
+		// Consecutive arena pages with consecutive data
+		address_t run_pageno = 0;
+		size_t run_index = 0, run_count = 0;
+
+		const auto* table = (const SerializedDeltaPage*) &snapshot[header.table_offset];
+		for (size_t i = 0; i < header.n_pages; i++)
+		{
+			const auto& spage = table[i];
+			if (spage.hash != 0 && spage.data_index >= header.n_datapages)
+				throw MachineException(INVALID_PROGRAM, "Serialized machine state was invalid", spage.addr);
+			const address_t pageno = spage.addr;
+			if (pageno < m_arena.pages)
+			{
+				if (spage.hash != 0) {
+					if (run_count > 0 && pageno == run_pageno + run_count && spage.data_index == run_index + run_count) {
+						run_count++;
+					} else {
+						if (run_count > 0)
+							map_arena_run(run_pageno, run_index, run_count);
+						run_pageno = pageno;
+						run_index  = spage.data_index;
+						run_count  = 1;
+					}
+				}
+#ifdef RISCV_VIRTUAL_PAGING
+				if (spage.hash == 0) {
+					m_pages.try_emplace(pageno, spage.attr, Page::cow_page().m_page.get());
+				} else if (spage.flags & SerializedDeltaPage::PAGED) {
+					// Create new non-owning arena page
+					PageAttributes attr = spage.attr;
+					attr.non_owning = true;
+					m_pages.try_emplace(pageno, attr, &m_arena.data[pageno]);
+				}
+#endif
+				continue;
+			}
+#ifdef RISCV_VIRTUAL_PAGING
+			if (spage.hash == 0) {
+				// Pages without data
+				m_pages.try_emplace(pageno, spage.attr, Page::cow_page().m_page.get());
+				continue;
+			}
+			// Pages point straight into the file mapping, and
+			// writable pages are copied on the first write.
+			PageAttributes attr = spage.attr;
+			attr.is_cow = attr.write;
+			attr.write  = false;
+			auto* data = (PageData *)&snapshot[header.data_offset + spage.data_index * sizeof(PageData)];
+			m_pages.try_emplace(pageno, attr, data);
+#else
+			throw MachineException(INVALID_PROGRAM, "Serialized page is outside of the memory arena", spage.addr);
+#endif
+		}
+		if (run_count > 0)
+			map_arena_run(run_pageno, run_index, run_count);
+#ifdef RISCV_VIRTUAL_PAGING
+		// page tables have been changed
+		this->invalidate_reset_cache();
+#endif
+		this->m_snapshot_mapping = std::move(mapping);
+#else
+		(void)mapping; (void)size; (void)fd;
+		throw MachineException(FEATURE_DISABLED, "Memory-mapped snapshots are not supported on this platform");
+#endif
+	}
+
 	INSTANTIATE_32_IF_ENABLED(Machine);
 	INSTANTIATE_64_IF_ENABLED(Machine);
 	INSTANTIATE_128_IF_ENABLED(Machine);
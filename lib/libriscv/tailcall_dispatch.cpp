@@ -36,13 +36,28 @@
 #define NEXT_C_INSTR() \
 	d += 1;            \
 	EXECUTE_CURRENT()
+#define STEP_INSTR() \
+	d += (compressed_enabled ? 2 : 1);
+#define STEP_C_INSTR() \
+	d += 1;
 
 #define RETURN_VALUES()   \
 	pc
 #define UNUSED_FUNCTION() \
 	cpu.trigger_exception(ILLEGAL_OPCODE);
 
+#ifdef RISCV_BLOCK_PROFILE
+#define PROFILE_BLOCK()                                            \
+	if (auto* block_counters = exec->block_counters(); UNLIKELY(block_counters != nullptr)) { \
+		auto& block_count = block_counters[d - exec->decoder_cache()]; \
+		block_count += (block_count != UINT32_MAX);                \
+	}
+#else
+#define PROFILE_BLOCK() /* */
+#endif
+
 #define BEGIN_BLOCK()                               \
+	PROFILE_BLOCK()                                 \
 	pc += d->block_bytes();                         \
 	counter.increment_counter(d->instruction_count());
 #define NEXT_BLOCK(len, OF)              \
@@ -166,7 +181,7 @@ namespace riscv
 			exec->mapping_at(instr.whole)(CPU(), counter.value()-1, counter.max(), pc);
 		counter.set_counters(new_values.counter, new_values.max_counter);
 		if (new_values.max_counter == 0) {
-#ifdef RISCV_LIBTCC
+#ifdef RISCV_BINARY_TRANSLATION
 			// We need to check if we have a current exception
 			if (UNLIKELY(CPU().has_current_exception())) {
 				const auto except = CPU().current_exception();
@@ -214,6 +229,15 @@ namespace riscv
 	{
 		// Calculate the current PC (mid block)
 		pc = (d - exec->decoder_cache()) << DecoderData<W>::SHIFT;
+		// Compact decoder caches decode each page on first execution
+		if (exec->is_compact()) {
+			exec->decode_page(pc);
+			if (d->get_bytecode() != RV32I_BC_INVALID) {
+				// Undo the count of the undecoded entry and resume
+				counter.increment_counter(-uint64_t(DecoderData<W>{}.instruction_count()));
+				NEXT_BLOCK(0, false);
+			}
+		}
 		// Check if the instruction is still invalid
 		bool stale = false;
 		try {
@@ -367,6 +391,26 @@ namespace riscv
 #endif
 		[RV32I_BC_LIVEPATCH] = execute_livepatch,
 		[RV32I_BC_SYSTEM]  = rv32i_system,
+
+		[RV32I_BC_FUSED_LUI_ADDI] = rv32i_fused_lui_addi,
+		[RV32I_BC_FUSED_AUIPC_ADDI] = rv32i_fused_auipc_addi,
+		[RV32I_BC_FUSED_AUIPC_JALR] = rv32i_fused_auipc_jalr,
+		[RV32I_BC_FUSED_MV_MV] = rv32i_fused_mv_mv,
+		[RV32I_BC_FUSED_LI_BEQ] = rv32i_fused_li_beq,
+		[RV32I_BC_FUSED_LI_BNE] = rv32i_fused_li_bne,
+		[RV32I_BC_FUSED_ADDI_BNE] = rv32i_fused_addi_bne,
+		[RV32I_BC_FUSED_LDW_ADD] = rv32i_fused_ldw_add,
+		[RV32I_BC_FUSED_LDW_LDW] = rv32i_fused_ldw_ldw,
+		[RV32I_BC_FUSED_STW_STW] = rv32i_fused_stw_stw,
+#ifdef RISCV_64I
+		[RV64I_BC_FUSED_LDD_ADD] = rv64i_fused_ldd_add,
+		[RV64I_BC_FUSED_LDD_LDD] = rv64i_fused_ldd_ldd,
+		[RV64I_BC_FUSED_STD_STD] = rv64i_fused_std_std,
+#endif
+#ifdef RISCV_EXT_COMPRESSED
+		[RV32C_BC_FUSED_LDD_LDD] = rv32c_fused_ldd_ldd,
+		[RV32C_BC_FUSED_STD_STD] = rv32c_fused_std_std,
+#endif
 		};
 	}
 
@@ -130,4 +130,24 @@ static constexpr void *computed_opcode[] = {
 #endif
 	[RV32I_BC_LIVEPATCH]  = &&execute_livepatch,
 	[RV32I_BC_SYSTEM] = &&rv32i_system,
+
+	[RV32I_BC_FUSED_LUI_ADDI] = &&rv32i_fused_lui_addi,
+	[RV32I_BC_FUSED_AUIPC_ADDI] = &&rv32i_fused_auipc_addi,
+	[RV32I_BC_FUSED_AUIPC_JALR] = &&rv32i_fused_auipc_jalr,
+	[RV32I_BC_FUSED_MV_MV] = &&rv32i_fused_mv_mv,
+	[RV32I_BC_FUSED_LI_BEQ] = &&rv32i_fused_li_beq,
+	[RV32I_BC_FUSED_LI_BNE] = &&rv32i_fused_li_bne,
+	[RV32I_BC_FUSED_ADDI_BNE] = &&rv32i_fused_addi_bne,
+	[RV32I_BC_FUSED_LDW_ADD] = &&rv32i_fused_ldw_add,
+	[RV32I_BC_FUSED_LDW_LDW] = &&rv32i_fused_ldw_ldw,
+	[RV32I_BC_FUSED_STW_STW] = &&rv32i_fused_stw_stw,
+#ifdef RISCV_64I
+	[RV64I_BC_FUSED_LDD_ADD] = &&rv64i_fused_ldd_add,
+	[RV64I_BC_FUSED_LDD_LDD] = &&rv64i_fused_ldd_ldd,
+	[RV64I_BC_FUSED_STD_STD] = &&rv64i_fused_std_std,
+#endif
+#ifdef RISCV_EXT_COMPRESSED
+	[RV32C_BC_FUSED_LDD_LDD] = &&rv32c_fused_ldd_ldd,
+	[RV32C_BC_FUSED_STD_STD] = &&rv32c_fused_std_std,
+#endif
 };
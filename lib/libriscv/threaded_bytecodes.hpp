@@ -139,10 +139,74 @@ namespace riscv
 #endif
 		RV32I_BC_LIVEPATCH,
 		RV32I_BC_SYSTEM,
+
+		// Superinstructions: the first entry of an adjacent pair in the
+		// same block executes both, leaving the second entry unchanged
+		RV32I_BC_FUSED_LUI_ADDI,
+		RV32I_BC_FUSED_AUIPC_ADDI,
+		RV32I_BC_FUSED_AUIPC_JALR,
+		RV32I_BC_FUSED_MV_MV,
+		RV32I_BC_FUSED_LI_BEQ,
+		RV32I_BC_FUSED_LI_BNE,
+		RV32I_BC_FUSED_ADDI_BNE,
+		RV32I_BC_FUSED_LDW_ADD,
+		RV32I_BC_FUSED_LDW_LDW,
+		RV32I_BC_FUSED_STW_STW,
+#ifdef RISCV_64I
+		RV64I_BC_FUSED_LDD_ADD,
+		RV64I_BC_FUSED_LDD_LDD,
+		RV64I_BC_FUSED_STD_STD,
+#endif
+#ifdef RISCV_EXT_COMPRESSED
+		RV32C_BC_FUSED_LDD_LDD,
+		RV32C_BC_FUSED_STD_STD,
+#endif
 		BYTECODES_MAX
 	};
 	static_assert(BYTECODES_MAX <= 256, "A bytecode must fit in a byte");
 
+	static constexpr bool is_fused_bytecode(unsigned bytecode) noexcept {
+		return bytecode >= RV32I_BC_FUSED_LUI_ADDI && bytecode < BYTECODES_MAX;
+	}
+	// The regular bytecode of the first instruction in a superinstruction
+	static constexpr unsigned unfused_bytecode(unsigned bytecode) noexcept
+	{
+		switch (bytecode) {
+		case RV32I_BC_FUSED_LUI_ADDI:
+			return RV32I_BC_LUI;
+		case RV32I_BC_FUSED_AUIPC_ADDI:
+		case RV32I_BC_FUSED_AUIPC_JALR:
+			return RV32I_BC_AUIPC;
+		case RV32I_BC_FUSED_MV_MV:
+			return RV32I_BC_MV;
+		case RV32I_BC_FUSED_LI_BEQ:
+		case RV32I_BC_FUSED_LI_BNE:
+			return RV32I_BC_LI;
+		case RV32I_BC_FUSED_ADDI_BNE:
+			return RV32I_BC_ADDI;
+		case RV32I_BC_FUSED_LDW_ADD:
+		case RV32I_BC_FUSED_LDW_LDW:
+			return RV32I_BC_LDW;
+		case RV32I_BC_FUSED_STW_STW:
+			return RV32I_BC_STW;
+#ifdef RISCV_64I
+		case RV64I_BC_FUSED_LDD_ADD:
+		case RV64I_BC_FUSED_LDD_LDD:
+			return RV32I_BC_LDD;
+		case RV64I_BC_FUSED_STD_STD:
+			return RV32I_BC_STD;
+#endif
+#ifdef RISCV_EXT_COMPRESSED
+		case RV32C_BC_FUSED_LDD_LDD:
+			return RV32C_BC_LDD;
+		case RV32C_BC_FUSED_STD_STD:
+			return RV32C_BC_STD;
+#endif
+		default:
+			return bytecode;
+		}
+	}
+
 	union FasterItype
 	{
 		uint32_t whole;
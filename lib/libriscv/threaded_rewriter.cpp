@@ -599,4 +599,125 @@ namespace riscv
 		return bytecode;
 	}
 
+	template <int W>
+	static unsigned fused_bytecode_for(const DecoderData<W>& first, const DecoderData<W>& second)
+	{
+		const unsigned next = unfused_bytecode(second.get_bytecode());
+		switch (first.get_bytecode())
+		{
+			case RV32I_BC_LUI:
+				if (next == RV32I_BC_ADDI)
+					return RV32I_BC_FUSED_LUI_ADDI;
+				break;
+			case RV32I_BC_AUIPC:
+				if (next == RV32I_BC_ADDI)
+					return RV32I_BC_FUSED_AUIPC_ADDI;
+				if (next == RV32I_BC_JALR) {
+					// Function returns are found and live-patched by looking
+					// at the JALR, which must then always be dispatched to
+					const FasterItype jalr { second.instr };
+					if (jalr.rs2 == REG_RA && jalr.rs1 == 0 && jalr.imm == 0)
+						break;
+					return RV32I_BC_FUSED_AUIPC_JALR;
+				}
+				break;
+			case RV32I_BC_MV:
+				if (next == RV32I_BC_MV)
+					return RV32I_BC_FUSED_MV_MV;
+				break;
+			case RV32I_BC_LI:
+				if (next == RV32I_BC_BEQ || next == RV32I_BC_BEQ_FW)
+					return RV32I_BC_FUSED_LI_BEQ;
+				if (next == RV32I_BC_BNE || next == RV32I_BC_BNE_FW)
+					return RV32I_BC_FUSED_LI_BNE;
+				break;
+			case RV32I_BC_ADDI:
+				if (next == RV32I_BC_BNE || next == RV32I_BC_BNE_FW)
+					return RV32I_BC_FUSED_ADDI_BNE;
+				break;
+			case RV32I_BC_LDW:
+				if (next == RV32I_BC_OP_ADD)
+					return RV32I_BC_FUSED_LDW_ADD;
+				if (next == RV32I_BC_LDW)
+					return RV32I_BC_FUSED_LDW_LDW;
+				break;
+			case RV32I_BC_STW:
+				if (next == RV32I_BC_STW)
+					return RV32I_BC_FUSED_STW_STW;
+				break;
+#ifdef RISCV_64I
+			case RV32I_BC_LDD:
+				if (next == RV32I_BC_OP_ADD)
+					return RV64I_BC_FUSED_LDD_ADD;
+				if (next == RV32I_BC_LDD)
+					return RV64I_BC_FUSED_LDD_LDD;
+				break;
+			case RV32I_BC_STD:
+				if (next == RV32I_BC_STD)
+					return RV64I_BC_FUSED_STD_STD;
+				break;
+#endif
+			default:
+				break;
+		}
+		return RV32I_BC_INVALID;
+	}
+
+#ifdef RISCV_EXT_COMPRESSED
+	template <int W>
+	static unsigned fused_compressed_bytecode_for(const DecoderData<W>& first, const DecoderData<W>& second)
+	{
+		if constexpr (W >= 8) {
+			// Stack spills and reloads in prologues and epilogues
+			const unsigned next = unfused_bytecode(second.get_bytecode());
+			if (first.get_bytecode() == RV32C_BC_LDD && next == RV32C_BC_LDD)
+				return RV32C_BC_FUSED_LDD_LDD;
+			if (first.get_bytecode() == RV32C_BC_STD && next == RV32C_BC_STD)
+				return RV32C_BC_FUSED_STD_STD;
+		}
+		return RV32I_BC_INVALID;
+	}
+#endif
+
+	template <int W> RISCV_INTERNAL
+	size_t DecodedExecuteSegment<W>::threaded_fuse()
+	{
+		return this->threaded_fuse(this->decoder_cache(), this->exec_begin(), this->exec_end());
+	}
+
+	template <int W> RISCV_INTERNAL
+	size_t DecodedExecuteSegment<W>::threaded_fuse(DecoderData<W>* exec_decoder, address_t begin, address_t end)
+	{
+#ifdef RISCV_ASM_DISPATCH
+		// The assembly dispatch has no superinstruction handlers
+		return 0;
+#else
+		static constexpr unsigned DIVISOR = DecoderData<W>::DIVISOR;
+		size_t fused = 0;
+
+		// Entries in the middle of 32-bit instructions are invalid,
+		// so every entry can be visited regardless of alignment.
+		for (address_t pc = begin; pc + DIVISOR < end; pc += DIVISOR)
+		{
+			auto& first = exec_decoder[pc / DIVISOR];
+			// The second instruction must be in the same block
+			if (first.block_bytes() == 0)
+				continue;
+
+			unsigned bytecode = RV32I_BC_INVALID;
+			if (pc + 4 < end)
+				bytecode = fused_bytecode_for<W>(first, exec_decoder[(pc + 4) / DIVISOR]);
+#ifdef RISCV_EXT_COMPRESSED
+			if (bytecode == RV32I_BC_INVALID)
+				bytecode = fused_compressed_bytecode_for<W>(first, exec_decoder[(pc + 2) / DIVISOR]);
+#endif
+			if (bytecode != RV32I_BC_INVALID) {
+				first.set_bytecode(bytecode);
+				fused++;
+			}
+		}
+		return fused;
+#endif
+	}
+
 } // riscv
@@ -1,5 +1,8 @@
 #pragma once
+#include <array>
 #include <cstdio>
+#include <deque>
+#include <optional>
 #include <unordered_map>
 #include "machine.hpp"
 
@@ -23,6 +26,7 @@ template <int W>
 struct Thread
 {
 	using address_t = address_type<W>;
+	enum class State : uint8_t { Running, Suspended, Blocked };
 
 	MultiThreading<W>& threading;
 	const int tid;
@@ -34,9 +38,15 @@ struct Thread
 	address_t stack_size;
 	// Address zeroed when exiting
 	address_t clear_tid = 0;
-	// The current or last blocked word
-	uint32_t block_word = 0;
+	// The current or last blocked word (eg. futex address)
+	address_t block_word = 0;
 	uint32_t block_extra = 0;
+	// The run queue or wait queue this thread is in
+	State state = State::Running;
+	Thread* prev = nullptr;
+	Thread* next = nullptr;
+	// Position in the thread slab
+	unsigned slot = 0;
 
 	Thread(MultiThreading<W>&, int tid, address_t tls,
 		address_t stack, address_t stkbase, address_t stksize);
@@ -44,17 +54,43 @@ struct Thread
 	bool exit(); // Returns false when we *cannot* continue
 	void suspend();
 	void suspend(address_t return_value);
-	void block(uint32_t reason, uint32_t extra = 0);
-	void block_return(address_t return_value, uint32_t reason, uint32_t extra);
+	void block(address_t reason, uint32_t extra = 0);
+	void block_return(address_t return_value, address_t reason, uint32_t extra);
 	void activate();
 	void resume();
 };
 
+// An intrusive FIFO of threads, linked through Thread::prev and next
+template <int W>
+struct ThreadList
+{
+	using thread_t = Thread<W>;
+
+	bool empty() const noexcept { return head == nullptr; }
+	thread_t* front() const noexcept { return head; }
+	void push_back(thread_t* t) noexcept {
+		t->prev = tail;
+		t->next = nullptr;
+		if (tail) tail->next = t; else head = t;
+		tail = t;
+	}
+	void erase(thread_t* t) noexcept {
+		if (t->prev) t->prev->next = t->next; else head = t->next;
+		if (t->next) t->next->prev = t->prev; else tail = t->prev;
+		t->prev = t->next = nullptr;
+	}
+
+	thread_t* head = nullptr;
+	thread_t* tail = nullptr;
+};
+
 template <int W>
 struct MultiThreading
 {
 	using address_t = address_type<W>;
 	using thread_t  = Thread<W>;
+	// Blocked threads wait in one of these queues, hashed by block word
+	static constexpr unsigned WAIT_QUEUE_BITS = 6;
 
 	thread_t* create(int flags, address_t ctid, address_t ptid,
 		address_t stack, address_t tls, address_t stkbase, address_t stksize);
@@ -66,23 +102,42 @@ struct MultiThreading
 	bool      yield_to(int tid, bool store_retval = true);
 	void      erase_thread(int tid);
 	void      wakeup_next();
-	bool      block(address_t retval, uint32_t reason, uint32_t extra = 0);
+	bool      block(address_t retval, address_t reason, uint32_t extra = 0);
 	void      unblock(int tid);
-	size_t    wakeup_blocked(size_t max, uint32_t reason, uint32_t mask = ~0U);
+	size_t    wakeup_blocked(size_t max, address_t reason, uint32_t mask = ~0U);
 	/* A suspended thread can at any time be resumed. */
-	auto&     suspended_threads() { return m_suspended; }
+	size_t    suspended_count() const noexcept { return m_suspended_count; }
 	/* A blocked thread can only be resumed by unblocking it. */
-	auto&     blocked_threads() { return m_blocked; }
+	size_t    blocked_count() const noexcept { return m_blocked_count; }
+	size_t    thread_count() const noexcept { return m_threads.size(); }
+
+	/* Queue management: All O(1), and none of them allocate. */
+	void      enqueue(thread_t*) noexcept;  // Add to the run queue
+	void      wait_on(thread_t*) noexcept;  // Add to the wait queue of its block word
+	void      dequeue(thread_t*) noexcept;  // Remove from any queue
 
 	MultiThreading(Machine<W>&);
 	MultiThreading(Machine<W>&, const MultiThreading&);
 	Machine<W>& machine;
-	std::vector<thread_t*> m_blocked;
-	std::vector<thread_t*> m_suspended;
-	std::unordered_map<int, thread_t> m_threads;
+	ThreadList<W> m_suspended;
+	std::array<ThreadList<W>, 1u << WAIT_QUEUE_BITS> m_waiters;
+	size_t     m_suspended_count = 0;
+	size_t     m_blocked_count = 0;
+	// Threads live in a slab with stable addresses, and the slots
+	// of exited threads are re-used by new threads.
+	std::deque<std::optional<thread_t>> m_slab;
+	std::vector<unsigned> m_free_slots;
+	std::unordered_map<int, thread_t*> m_threads;
 	unsigned   m_thread_counter = 0;
 	unsigned   m_max_threads = 50;
 	thread_t*  m_current = nullptr;
+
+private:
+	template <typename... Args>
+	thread_t* allocate(Args&&... args);
+	ThreadList<W>& wait_queue(address_t reason) noexcept {
+		return m_waiters[(uint64_t(reason) * 0x9E3779B97F4A7C15ull) >> (64 - WAIT_QUEUE_BITS)];
+	}
 };
 
 /** Implementation **/
@@ -95,8 +150,7 @@ inline MultiThreading<W>::MultiThreading(Machine<W>& mach)
 	const address_t base = 0x1000;
 	const address_t size = mach.memory.stack_initial() - base;
 	// Create the main thread
-	auto it = m_threads.try_emplace(0, *this, 0, 0x0, mach.cpu.reg(REG_SP), base, size);
-	m_current = &it.first->second;
+	m_current = allocate(*this, 0, 0x0, mach.cpu.reg(REG_SP), base, size);
 }
 
 template <int W>
@@ -104,18 +158,16 @@ inline MultiThreading<W>::MultiThreading(Machine<W>& mach, const MultiThreading<
 	: machine(mach), m_thread_counter(other.m_thread_counter), m_max_threads(other.m_max_threads)
 {
 	for (const auto& it : other.m_threads) {
-		const int tid = it.first;
-		m_threads.try_emplace(tid, *this, it.second);
+		allocate(*this, *it.second);
 	}
-	/* Copy each suspended by pointer lookup */
-	m_suspended.reserve(other.m_suspended.size());
-	for (const auto* t : other.m_suspended) {
-		m_suspended.push_back(get_thread(t->tid));
+	/* Re-create the queues in the same order by TID lookup */
+	for (const auto* t = other.m_suspended.front(); t != nullptr; t = t->next) {
+		enqueue(get_thread(t->tid));
 	}
-	/* Copy each blocked by pointer lookup */
-	m_blocked.reserve(other.m_blocked.size());
-	for (const auto* t : other.m_blocked) {
-		m_blocked.push_back(get_thread(t->tid));
+	for (const auto& queue : other.m_waiters) {
+		for (const auto* t = queue.front(); t != nullptr; t = t->next) {
+			wait_on(get_thread(t->tid));
+		}
 	}
 	/* Copy current thread */
 	m_current = get_thread(other.m_current->tid);
@@ -123,9 +175,63 @@ inline MultiThreading<W>::MultiThreading(Machine<W>& mach, const MultiThreading<
 		throw MachineException(INVALID_PROGRAM, "Other machine had invalid multi-threading state");
 }
 
+template <int W>
+template <typename... Args>
+inline Thread<W>* MultiThreading<W>::allocate(Args&&... args)
+{
+	unsigned slot;
+	if (!m_free_slots.empty()) {
+		slot = m_free_slots.back();
+		m_free_slots.pop_back();
+	} else {
+		slot = m_slab.size();
+		m_slab.emplace_back();
+	}
+	auto& thread = m_slab[slot].emplace(std::forward<Args>(args)...);
+	thread.slot = slot;
+	m_threads.emplace(thread.tid, &thread);
+	return &thread;
+}
+
+template <int W>
+inline void MultiThreading<W>::enqueue(thread_t* thread) noexcept
+{
+	thread->state = thread_t::State::Suspended;
+	m_suspended.push_back(thread);
+	m_suspended_count++;
+}
+
+template <int W>
+inline void MultiThreading<W>::wait_on(thread_t* thread) noexcept
+{
+	thread->state = thread_t::State::Blocked;
+	wait_queue(thread->block_word).push_back(thread);
+	m_blocked_count++;
+}
+
+template <int W>
+inline void MultiThreading<W>::dequeue(thread_t* thread) noexcept
+{
+	switch (thread->state) {
+	case thread_t::State::Suspended:
+		m_suspended.erase(thread);
+		m_suspended_count--;
+		break;
+	case thread_t::State::Blocked:
+		wait_queue(thread->block_word).erase(thread);
+		m_blocked_count--;
+		break;
+	case thread_t::State::Running:
+		return;
+	}
+	thread->state = thread_t::State::Running;
+}
+
 template <int W>
 inline void Thread<W>::resume()
 {
+	// A resumed thread is no longer waiting anywhere
+	threading.dequeue(this);
 	threading.m_current = this;
 	auto& m = threading.machine;
 	// restore registers
@@ -148,8 +254,8 @@ inline void Thread<W>::suspend()
 	this->stored_regs.copy_from(
 		Registers<W>::Options::NoVectors,
 		threading.machine.cpu.registers());
-	// add to suspended (NB: can throw)
-	threading.m_suspended.push_back(this);
+	// add to the back of the run queue
+	threading.enqueue(this);
 }
 
 template <int W>
@@ -161,7 +267,7 @@ inline void Thread<W>::suspend(address_t return_value)
 }
 
 template <int W>
-inline void Thread<W>::block(uint32_t reason, uint32_t extra)
+inline void Thread<W>::block(address_t reason, uint32_t extra)
 {
 	// copy all regs except vector lanes
 	this->stored_regs.copy_from(
@@ -169,12 +275,12 @@ inline void Thread<W>::block(uint32_t reason, uint32_t extra)
 		threading.machine.cpu.registers());
 	this->block_word = reason;
 	this->block_extra = extra;
-	// add to blocked (NB: can throw)
-	threading.m_blocked.push_back(this);
+	// add to the wait queue of the block word
+	threading.wait_on(this);
 }
 
 template <int W>
-inline void Thread<W>::block_return(address_t return_value, uint32_t reason, uint32_t extra)
+inline void Thread<W>::block_return(address_t return_value, address_t reason, uint32_t extra)
 {
 	this->block(reason, extra);
 	// set the block reason as the next return value
@@ -192,7 +298,7 @@ inline Thread<W>* MultiThreading<W>::get_thread(int tid)
 {
 	auto it = m_threads.find(tid);
 	if (it == m_threads.end()) return nullptr;
-	return &it->second;
+	return it->second;
 }
 
 template <int W>
@@ -200,10 +306,8 @@ inline void MultiThreading<W>::wakeup_next()
 {
 	// resume a waiting thread
 	if (!m_suspended.empty()) {
-		auto* next = m_suspended.front();
-		m_suspended.erase(m_suspended.begin());
-		// resume next thread
-		next->resume();
+		// resume next thread (also removing it from the run queue)
+		m_suspended.front()->resume();
 	} else {
 		THPRINT(machine, "No more threads to resume. Fallback to tid=0 (*ERROR*)\n");
 		auto* next = get_thread(0);
@@ -279,8 +383,7 @@ inline Thread<W>* MultiThreading<W>::create(
 		throw MachineException(INVALID_PROGRAM, "Too many threads", this->m_max_threads);
 
 	const int tid = ++this->m_thread_counter;
-	auto it = m_threads.try_emplace(tid, *this, tid, tls, stack, stkbase, stksize);
-	auto* thread = &it.first->second;
+	auto* thread = allocate(*this, tid, tls, stack, stkbase, stksize);
 
 	// flag for write child TID
 	if (flags & CHILD_SETTID) {
@@ -326,7 +429,7 @@ inline bool MultiThreading<W>::suspend_and_yield(long result)
 }
 
 template <int W>
-inline bool MultiThreading<W>::block(address_t retval, uint32_t reason, uint32_t extra)
+inline bool MultiThreading<W>::block(address_t retval, address_t reason, uint32_t extra)
 {
 	auto* thread = get_thread();
 	if (UNLIKELY(m_suspended.empty())) {
@@ -359,14 +462,7 @@ inline bool MultiThreading<W>::yield_to(int tid, bool store_retval)
 		thread->suspend(0);
 	else
 		thread->suspend();
-	// remove the next thread from suspension
-	for (auto it = m_suspended.begin(); it != m_suspended.end(); ++it) {
-		if (*it == next) {
-			m_suspended.erase(it);
-			break;
-		}
-	}
-	// resume next thread
+	// resume next thread (also removing it from its queue)
 	next->resume();
 	return true;
 }
@@ -374,38 +470,37 @@ inline bool MultiThreading<W>::yield_to(int tid, bool store_retval)
 template <int W>
 inline void MultiThreading<W>::unblock(int tid)
 {
-	for (auto it = m_blocked.begin(); it != m_blocked.end(); )
+	auto* thread = get_thread(tid);
+	if (thread != nullptr && thread->state == thread_t::State::Blocked)
 	{
-		if ((*it)->tid == tid)
-		{
-			// suspend current thread
-			get_thread()->suspend(0);
-			// resume this thread
-			(*it)->resume();
-			m_blocked.erase(it);
-			return;
-		}
-		else ++it;
+		// suspend current thread
+		get_thread()->suspend(0);
+		// resume this thread
+		thread->resume();
+		return;
 	}
 	// given thread id was not blocked
 	machine.cpu.reg(REG_ARG0) = -1;
 }
 template <int W>
-inline size_t MultiThreading<W>::wakeup_blocked(size_t max, uint32_t reason, uint32_t mask)
+inline size_t MultiThreading<W>::wakeup_blocked(size_t max, address_t reason, uint32_t mask)
 {
 	size_t awakened = 0;
-	for (auto it = m_blocked.begin(); it != m_blocked.end() && awakened < max; )
+	// Only the threads hashed to the same wait queue are visited
+	auto* next = wait_queue(reason).front();
+	while (next != nullptr && awakened < max)
 	{
+		auto* thread = next;
+		next = thread->next;
 		// compare against block reason
-		const auto bits = (*it)->block_extra;
-		if ((*it)->block_word == reason && (bits == 0 || (bits & mask) != 0))
+		const auto bits = thread->block_extra;
+		if (thread->block_word == reason && (bits == 0 || (bits & mask) != 0))
 		{
 			// move to suspended
-			m_suspended.push_back(*it);
-			m_blocked.erase(it);
+			dequeue(thread);
+			enqueue(thread);
 			awakened ++;
 		}
-		else ++it;
 	}
 	return awakened;
 }
@@ -415,7 +510,13 @@ inline void MultiThreading<W>::erase_thread(int tid)
 {
 	auto it = m_threads.find(tid);
 	assert(it != m_threads.end());
+	auto* thread = it->second;
+	// An exiting thread may still be in a queue (eg. killed by tgkill)
+	dequeue(thread);
 	m_threads.erase(it);
+	const unsigned slot = thread->slot;
+	m_slab[slot].reset();
+	m_free_slots.push_back(slot);
 }
 
 } // riscv
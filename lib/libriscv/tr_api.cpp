@@ -44,6 +44,15 @@ namespace riscv {
 #define MISALIGNED_INSTRUCTION 4
 #define VISIBLE  __attribute__((visibility("default")))
 #define INTERNAL __attribute__((visibility("hidden")))
+#ifdef TRANSLATION_UNIT
+// Split translation: Each unit has its own callback table and offsets,
+// and block functions may be called from other units.
+#define BINTR_FUNC INTERNAL
+#define BINTR_INIT TRANSLATION_UNIT
+#else
+#define BINTR_FUNC static
+#define BINTR_INIT init
+#endif
 
 #if RISCV_TRANSLATION_DYLIB == 4
 	typedef uint32_t addr_t;
@@ -253,6 +262,19 @@ static struct CallbackTable {
 INTERNAL static int32_t arena_offset;
 //#define ARENA_AT(cpu, x)  (arena_ptr + (x))
 #define ARENA_AT(cpu, x)  (*(char **)((uintptr_t)cpu + arena_offset) + (x))
+#ifdef RISCV_DIRTY_TRACKING
+// The dirty-page bitmap pointer is stored right after the arena pointer
+#define ARENA_DIRTY(cpu)  (*(uint64_t **)((uintptr_t)cpu + arena_offset + sizeof(void*)))
+static inline void MARK_DIRTY(CPU* cpu, addr_t addr, unsigned size) {
+	uint64_t* bitmap = ARENA_DIRTY(cpu);
+	if (bitmap) { // Forks may share this code without tracking
+		const addr_t first = addr >> 12;
+		const addr_t last = (addr + size - 1) >> 12;
+		bitmap[first >> 6] |= (uint64_t)1 << (first & 63);
+		bitmap[last >> 6] |= (uint64_t)1 << (last & 63);
+	}
+}
+#endif
 
 INTERNAL static int32_t ic_offset;
 #define INS_COUNTER(cpu) (*(uint64_t *)((uintptr_t)cpu + ic_offset))
@@ -375,10 +397,12 @@ static inline uint64_t MUL128(
 
 #ifdef EMBEDDABLE_CODE
 static
+#elif defined(TRANSLATION_UNIT)
+INTERNAL
 #else
 extern VISIBLE
 #endif
-void init(struct CallbackTable* table, int32_t arena_off, int32_t ins_counter_off, int32_t rdcache_off)
+void BINTR_INIT(struct CallbackTable* table, int32_t arena_off, int32_t ins_counter_off, int32_t rdcache_off)
 {
 	api = *table;
 	arena_offset = arena_off;
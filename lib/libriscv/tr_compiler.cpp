@@ -7,6 +7,16 @@
 #include <dlfcn.h>
 #endif
 #include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <vector>
+#ifndef _WIN32
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#endif
+#include "util/threadpool.h"
 
 static std::string compiler()
 {
@@ -39,6 +49,22 @@ static std::string host_arch()
 
 namespace riscv
 {
+	// Shared objects are produced under a temporary name, and then renamed
+	// into place, so that concurrent processes never load a partial file.
+	static std::string temporary_filename(const std::string& outfile)
+	{
+		static std::atomic<unsigned> counter = 0;
+		return outfile + ".tmp" + std::to_string(getpid()) + "-" + std::to_string(counter++);
+	}
+	static bool publish_translation(const std::string& tmpfile, const std::string& outfile)
+	{
+		if (rename(tmpfile.c_str(), outfile.c_str()) != 0) {
+			unlink(tmpfile.c_str());
+			return false;
+		}
+		return true;
+	}
+
 	std::string compile_command(int /*arch*/, const std::string& cflags)
 	{
 		return compiler() + " -O2 -s -std=c99 -fPIC -shared -rdynamic -x c "
@@ -70,9 +96,10 @@ namespace riscv
 			return nullptr;
 		}
 		// system compiler invocation
+		const std::string tmpfile = temporary_filename(outfile);
 		const std::string command =
 			compile_command(arch, cflags) + " "
-			 + " -o " + outfile + " "
+			 + " -o " + tmpfile + " "
 			 + std::string(namebuffer) + " 2>&1"; // redirect stderr
 
 		// compile the translated code
@@ -97,9 +124,211 @@ namespace riscv
 			unlink(namebuffer);
 		}
 
+		if (!publish_translation(tmpfile, outfile))
+			return nullptr;
+		return dlopen(outfile.c_str(), RTLD_LAZY);
+	}
+
+	static bool
+	compile_object(const std::string& code, int arch, const std::string& cflags,
+		const std::string& objfile)
+	{
+		// create temporary filename
+		char namebuffer[64];
+		strncpy(namebuffer, "/tmp/rvtrcode-XXXXXX", sizeof(namebuffer));
+		// open a temporary file with owner privs
+		const int fd = mkstemp(namebuffer);
+		if (fd < 0) {
+			return false;
+		}
+		// write translated code to temp file
+		ssize_t len = write(fd, code.c_str(), code.size());
+		close(fd);
+		if (len < (ssize_t) code.size()) {
+			unlink(namebuffer);
+			return false;
+		}
+		// system compiler invocation (compile only)
+		const std::string command =
+			compile_command(arch, cflags) + " -c "
+			 + " -o " + objfile + " "
+			 + std::string(namebuffer) + " 2>&1"; // redirect stderr
+
+		if (verbose()) {
+			printf("Command: %s\n", command.c_str());
+		}
+		FILE* f = popen(command.c_str(), "r");
+		if (f == nullptr) {
+			unlink(namebuffer);
+			return false;
+		}
+		// get compiler output
+		char buffer[2048];
+		while (fgets(buffer, sizeof(buffer), f) != NULL) {
+			if (verbose())
+				fprintf(stderr, "%s", buffer);
+		}
+		const int status = pclose(f);
+
+		if (!keep_code()) {
+			// delete temporary code file
+			unlink(namebuffer);
+		}
+		return status == 0;
+	}
+
+	void*
+	compile_units(const std::vector<std::string>& units, int arch, const std::string& cflags,
+		const std::string& outfile)
+	{
+		// Compile all translation units concurrently into object files
+		std::vector<std::string> objects;
+		for (size_t i = 0; i < units.size(); i++) {
+			objects.push_back(outfile + ".unit" + std::to_string(i) + ".o");
+		}
+		std::vector<char> results(units.size(), false);
+		{
+			ThreadPool pool(std::min<size_t>(units.size(),
+				std::max(1u, std::thread::hardware_concurrency())));
+			for (size_t i = 0; i < units.size(); i++) {
+				pool.enqueue([&, i] {
+					results[i] = compile_object(units[i], arch, cflags, objects[i]);
+				});
+			}
+			pool.wait_until_nothing_in_flight();
+		}
+		bool success = std::all_of(results.begin(), results.end(),
+			[] (char result) { return result != 0; });
+
+		// Link all object files into a single shared object
+		const std::string tmpfile = temporary_filename(outfile);
+		if (success) {
+			std::string command = compiler() + " -shared -s -o " + tmpfile;
+			for (auto& object : objects)
+				command += " " + object;
+			command += " 2>&1";
+			if (verbose()) {
+				printf("Command: %s\n", command.c_str());
+			}
+			FILE* f = popen(command.c_str(), "r");
+			if (f != nullptr) {
+				char buffer[2048];
+				while (fgets(buffer, sizeof(buffer), f) != NULL) {
+					if (verbose())
+						fprintf(stderr, "%s", buffer);
+				}
+				success = pclose(f) == 0;
+			} else {
+				success = false;
+			}
+			// A failed link may leave a partial shared object behind
+			if (!success)
+				unlink(tmpfile.c_str());
+		}
+		for (auto& object : objects)
+			unlink(object.c_str());
+
+		if (!success || !publish_translation(tmpfile, outfile))
+			return nullptr;
 		return dlopen(outfile.c_str(), RTLD_LAZY);
 	}
 
+#ifndef _WIN32
+	int translation_cache_lock(const std::string& filename)
+	{
+		// Serialize compilation of the same translation between processes
+		const std::string lockfile = filename + ".lock";
+		const int fd = open(lockfile.c_str(), O_CREAT | O_RDWR | O_CLOEXEC, 0600);
+		if (fd < 0)
+			return -1;
+		if (flock(fd, LOCK_EX) != 0) {
+			close(fd);
+			return -1;
+		}
+		return fd;
+	}
+	void translation_cache_unlock(int fd)
+	{
+		if (fd >= 0) {
+			flock(fd, LOCK_UN);
+			close(fd);
+		}
+	}
+
+	void translation_cache_touch(const std::string& filename)
+	{
+		// The modification time is used as the last use of a cached translation
+		utimensat(AT_FDCWD, filename.c_str(), nullptr, 0);
+	}
+
+	std::pair<uint64_t, uint64_t> translation_cache_evict(const std::string& prefix,
+		const std::string& suffix, uint64_t max_bytes, const std::string& keep)
+	{
+		// The prefix is a directory followed by the start of the filename
+		const size_t slash = prefix.find_last_of('/');
+		const std::string directory = (slash != std::string::npos) ? prefix.substr(0, slash + 1) : "./";
+		const std::string name_prefix = (slash != std::string::npos) ? prefix.substr(slash + 1) : prefix;
+
+		struct CachedFile {
+			std::string path;
+			uint64_t size;
+			time_t last_use;
+		};
+		std::vector<CachedFile> files;
+		uint64_t total_bytes = 0;
+
+		DIR* dir = opendir(directory.c_str());
+		if (dir == nullptr)
+			return {0, 0};
+		while (struct dirent* entry = readdir(dir)) {
+			// Cached translations are named <prefix><8 hex digits><suffix>
+			const std::string name = entry->d_name;
+			if (name.size() != name_prefix.size() + 8 + suffix.size()
+				|| name.compare(0, name_prefix.size(), name_prefix) != 0
+				|| name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0)
+				continue;
+			const std::string hash = name.substr(name_prefix.size(), 8);
+			if (hash.find_first_not_of("0123456789ABCDEF") != std::string::npos)
+				continue;
+			struct stat st;
+			const std::string path = directory + name;
+			if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode))
+				continue;
+			files.push_back({path, uint64_t(st.st_size), st.st_mtime});
+			total_bytes += st.st_size;
+		}
+		closedir(dir);
+
+		// Evict the least recently used translations first
+		std::sort(files.begin(), files.end(), [] (const CachedFile& a, const CachedFile& b) {
+			return a.last_use < b.last_use;
+		});
+		uint64_t evicted_files = 0;
+		uint64_t evicted_bytes = 0;
+		for (const auto& file : files) {
+			if (total_bytes <= max_bytes)
+				break;
+			if (file.path == keep || file.path == directory + keep)
+				continue;
+			// Already loaded translations remain valid after unlinking.
+			// The lock file stays: another process may be holding or waiting
+			// on it, and a new lock file would let a second compiler in.
+			if (unlink(file.path.c_str()) == 0) {
+				total_bytes -= file.size;
+				evicted_files++;
+				evicted_bytes += file.size;
+			}
+		}
+		return {evicted_files, evicted_bytes};
+	}
+#else
+	int translation_cache_lock(const std::string&) { return -1; }
+	void translation_cache_unlock(int) {}
+	void translation_cache_touch(const std::string&) {}
+	std::pair<uint64_t, uint64_t> translation_cache_evict(const std::string&,
+		const std::string&, uint64_t, const std::string&) { return {0, 0}; }
+#endif
+
 	static std::string mingw_compile_command(int /*arch*/,
 		const std::string& cflags, const MachineTranslationCrossOptions& cross_options)
 	{
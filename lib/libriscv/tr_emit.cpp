@@ -90,6 +90,105 @@ struct BranchInfo {
 	uint64_t call_pc;
 };
 
+// The per-block IR is built before any code is emitted, so that
+// passes can look both forwards and backwards across the block.
+enum EmitIRFlags : uint8_t {
+	IR_SIMPLE   = 0x1, // Register-to-register ALU, cannot trap
+	IR_DEAD     = 0x2, // Result is overwritten before it is read
+	IR_CONSTANT = 0x4, // Result is a known constant (see value)
+};
+static constexpr uint32_t IR_CLOBBER_ALL = ~1u;
+
+template <int W>
+struct EmitIR {
+	rv32i_instruction instr; // Expanded instruction
+	uint8_t  flags = 0;
+	uint32_t read = 0;       // Bitmask of registers read (IR_SIMPLE only)
+	uint32_t written = 0;    // Bitmask of registers written
+	address_type<W> pc = 0;
+	address_type<W> value = 0;
+};
+
+static constexpr uint32_t reg_bit(unsigned reg) noexcept {
+	return (1u << reg) & ~1u; // x0 is never read or written
+}
+
+// Integer registers that an instruction may modify,
+// IR_CLOBBER_ALL when it is not known.
+static uint32_t ir_written_registers(const rv32i_instruction instr)
+{
+	if (instr.is_compressed())
+		return IR_CLOBBER_ALL;
+	switch (instr.opcode()) {
+	case RV32I_LUI:
+	case RV32I_AUIPC:
+	case RV32I_OP_IMM:
+	case RV32I_OP:
+	case RV64I_OP_IMM32:
+	case RV64I_OP32:
+	case RV32I_LOAD:
+	case RV32I_JAL:
+	case RV32I_JALR:
+	case RV32A_ATOMIC:
+	case RV32F_FPFUNC:
+		return reg_bit(instr.Itype.rd);
+	case RV32I_STORE:
+	case RV32I_BRANCH:
+	case RV32I_FENCE:
+	case RV32F_LOAD:
+	case RV32F_STORE:
+	case RV32F_FMADD:
+	case RV32F_FMSUB:
+	case RV32F_FNMADD:
+	case RV32F_FNMSUB:
+		return 0;
+	default:
+		return IR_CLOBBER_ALL;
+	}
+}
+
+// Returns true for the ALU instructions that the emitter always
+// produces inline code for, and which cannot trap.
+template <int W>
+static bool ir_simple_instruction(const rv32i_instruction instr, uint32_t& read)
+{
+	switch (instr.opcode()) {
+	case RV32I_LUI:
+	case RV32I_AUIPC:
+		read = 0;
+		return true;
+	case RV32I_OP_IMM:
+		read = reg_bit(instr.Itype.rs1);
+		switch (instr.Itype.funct3) {
+		case 0x1: // SLLI
+			return instr.Itype.high_bits() == 0x0;
+		case 0x5: // SRLI, SRAI
+			return instr.Itype.high_bits() == 0x0 || instr.Itype.high_bits() == 0x400;
+		default:
+			return true;
+		}
+	case RV32I_OP:
+		read = reg_bit(instr.Rtype.rs1) | reg_bit(instr.Rtype.rs2);
+		switch (instr.Rtype.jumptable_friendly_op()) {
+		case 0x0: case 0x1: case 0x2: case 0x3: // ADD, SLL, SLT, SLTU
+		case 0x4: case 0x5: case 0x6: case 0x7: // XOR, SRL, OR, AND
+		case 0x200: case 0x205: // SUB, SRA
+			return true;
+		default:
+			return false;
+		}
+	case RV64I_OP_IMM32: // ADDIW
+		read = reg_bit(instr.Itype.rs1);
+		return W >= 8 && instr.Itype.funct3 == 0x0;
+	case RV64I_OP32: // ADDW, SUBW
+		read = reg_bit(instr.Rtype.rs1) | reg_bit(instr.Rtype.rs2);
+		return W >= 8 && (instr.Rtype.jumptable_friendly_op() == 0x0
+			|| instr.Rtype.jumptable_friendly_op() == 0x200);
+	default:
+		return false;
+	}
+}
+
 template <int W>
 struct Emitter
 {
@@ -114,18 +213,37 @@ struct Emitter
 				encompassing_arena_bits++;
 			this->m_encompassing_arena_mask = (1ULL << encompassing_arena_bits) - 1;
 		}
+		if (ptinfo.use_guard_paged_arena) {
+			this->m_guard_arena_mask = Memory<W>::guard_paged_arena_mask(ptinfo.arena_size);
+		}
 	}
 
 	template <typename ... Args>
 	void add_code(Args&& ... addendum) {
 		([&] {
-			this->code += std::string(addendum) + "\n";
+			this->code.append(addendum);
+			this->code += '\n';
 		}(), ...);
 	}
 	const std::string& get_code() const noexcept { return this->code; }
 
-	std::string loaded_regname(int reg) {
-		return "reg" + std::to_string(reg);
+	static const std::string& loaded_regname(int reg) {
+		static const std::array<std::string, 32> names = [] {
+			std::array<std::string, 32> result;
+			for (size_t i = 0; i < result.size(); i++)
+				result[i] = "reg" + std::to_string(i);
+			return result;
+		}();
+		return names[reg];
+	}
+	static const std::string& memory_regname(int reg) {
+		static const std::array<std::string, 32> names = [] {
+			std::array<std::string, 32> result;
+			for (size_t i = 0; i < result.size(); i++)
+				result[i] = "cpu->r[" + std::to_string(i) + "]";
+			return result;
+		}();
+		return names[reg];
 	}
 	void load_register(int reg) {
 		if (uses_register_caching()) {
@@ -136,14 +254,14 @@ struct Emitter
 	void potentially_reload_register(int reg) {
 		if (uses_register_caching()) {
 			if (reg != 0 && reg < CACHED_REGISTERS) {
-				add_code(loaded_regname(reg) + " = cpu->r[" + std::to_string(reg) + "];");
+				add_code(loaded_regname(reg) + " = " + memory_regname(reg) + ";");
 			}
 		}
 	}
 	void potentially_realize_register(int reg) {
 		if (uses_register_caching()) {
 			if (reg != 0 && reg < CACHED_REGISTERS) {
-				add_code("cpu->r[" + std::to_string(reg) + "] = " + loaded_regname(reg) + ";");
+				add_code(memory_regname(reg) + " = " + loaded_regname(reg) + ";");
 			}
 		}
 	}
@@ -151,7 +269,7 @@ struct Emitter
 		if (uses_register_caching()) {
 			for (int reg = x0; reg < x1; reg++) {
 				if (reg != 0 && reg < CACHED_REGISTERS) {
-					add_code("cpu->r[" + std::to_string(reg) + "] = " + loaded_regname(reg) + ";");
+					add_code(memory_regname(reg) + " = " + loaded_regname(reg) + ";");
 				}
 			}
 		}
@@ -200,7 +318,7 @@ struct Emitter
 				load_register(reg);
 				return loaded_regname(reg);
 			} else {
-				return "cpu->r[" + std::to_string(reg) + "]";
+				return memory_regname(reg);
 			}
 		}
 		return "(addr_t)0";
@@ -213,7 +331,7 @@ struct Emitter
 				load_register(reg);
 				return loaded_regname(reg);
 			} else {
-				return "cpu->r[" + std::to_string(reg) + "]";
+				return memory_regname(reg);
 			}
 		}
 		return "(addr_t)0";
@@ -224,7 +342,7 @@ struct Emitter
 				load_register(reg);
 				return loaded_regname(reg);
 			} else {
-				return "cpu->r[" + std::to_string(reg) + "]";
+				return memory_regname(reg);
 			}
 		}
 		return "(addr_t)0";
@@ -273,6 +391,9 @@ struct Emitter
 			return true;
 		return false;
 	}
+	bool uses_guard_paged_arena() const noexcept {
+		return tinfo.use_guard_paged_arena && !tinfo.use_virtual_paging_fallback && tinfo.arena_ptr != 0;
+	}
 	constexpr address_t get_Nbit_encompassing_arena_mask() noexcept {
 		if constexpr (riscv::encompassing_Nbit_arena != 0)
 			return riscv::encompassing_arena_mask;
@@ -306,6 +427,15 @@ struct Emitter
 		}
 	}
 
+	// Loads in a guard-paged arena are masked into the reservation instead
+	// of being bounds-checked, and loads past the arena fault on the host
+	std::string guarded_arena_at(const std::string& address) {
+		const std::string guarded = "((" + address + ") & " + STRADDR(m_guard_arena_mask) + ")";
+		if (tinfo.is_libtcc && !tinfo.use_shared_execute_segments)
+			return "(" + m_arena_hex_address + " + " + guarded + ")";
+		return "ARENA_AT(cpu, " + guarded + ")";
+	}
+
 	std::string arena_at_fixed(const std::string& type, address_t address) {
 		if (tinfo.is_libtcc && !tinfo.use_shared_execute_segments) {
 			if (uses_Nbit_encompassing_arena()) {
@@ -324,50 +454,50 @@ struct Emitter
 		return std::abs(new_offset - old_offset) <= int64_t(Memory<W>::OVERALLOCATE - size);
 	}
 
+	// A bounds check on a register stays valid until the register is
+	// written, or until control can enter from elsewhere (see
+	// reset_all_tracked_registers), so it covers any later access in
+	// the same straight-line code that lands within the overallocation.
 	bool skip_load_bounds_check(int reg, int64_t offset, size_t size) {
 		if (tinfo.unsafe_remove_checks
 			|| uses_Nbit_encompassing_arena()) return true; // No bounds check
 		if (tinfo.use_virtual_paging_fallback) return false; // Always check
 
-		if (last_read_check_pc == m_last_pc
-			&& last_read_check_register == reg
-			&& offset_is_within_overallocation(last_read_check_offset, offset, size)) {
-			// Skip bounds check, but continue (same register, same original bounds-checked offset)
-			last_read_check_pc = pc();
+		auto& read_check = this->m_read_checks[reg];
+		auto& write_check = this->m_write_checks[reg];
+		if (read_check.valid
+			&& offset_is_within_overallocation(read_check.offset, offset, size)) {
+			// Skip bounds check (same register, same original bounds-checked offset)
 			return true;
-		} else if (last_write_check_pc == m_last_pc
-			&& last_write_check_register == reg
-			&& offset_is_within_overallocation(last_write_check_offset, offset, size)) {
-			// Previous was a write check for same register + offset range
+		} else if (write_check.valid
+			&& offset_is_within_overallocation(write_check.offset, offset, size)) {
 			// The arena is divided into unreadable, readable and writable regions,
 			// and any region that is writable is also readable, so we inherit the check:
-			last_read_check_pc = pc();
-			last_read_check_register = reg;
-			last_read_check_offset = offset;
 			return true;
-		} else {
-			last_read_check_pc = pc();
-			last_read_check_register = reg;
-			last_read_check_offset = offset;
-			return false;
 		}
+		read_check = { true, offset };
+		return false;
 	}
 	bool skip_store_bounds_check(int reg, int64_t offset, size_t size) {
 		if (tinfo.unsafe_remove_checks
 			|| uses_Nbit_encompassing_arena()) return true; // No bounds check
 		if (tinfo.use_virtual_paging_fallback) return false; // Always check
 
-		if (last_write_check_pc == m_last_pc
-			&& last_write_check_register == reg
-			&& offset_is_within_overallocation(last_write_check_offset, offset, size)) {
+		auto& write_check = this->m_write_checks[reg];
+		if (write_check.valid
+			&& offset_is_within_overallocation(write_check.offset, offset, size)) {
 			// Skip bounds check
-			last_write_check_pc = pc();
 			return true;
-		} else {
-			last_write_check_pc = pc();
-			last_write_check_register = reg;
-			last_write_check_offset = offset;
-			return false;
+		}
+		write_check = { true, offset };
+		return false;
+	}
+	void forget_bounds_checks(uint32_t written) {
+		for (unsigned reg = 1; reg < 32; reg++) {
+			if (written & reg_bit(reg)) {
+				this->m_read_checks[reg].valid = false;
+				this->m_write_checks[reg].valid = false;
+			}
 		}
 	}
 
@@ -411,7 +541,11 @@ struct Emitter
 		}
 
 		const std::string address = from_untracked_reg(reg) + " + " + from_imm(imm);
-		if (skip_load_bounds_check(reg, imm, sizeof(T)))
+		if (uses_guard_paged_arena())
+		{
+			add_code(dst + " = *(" + type + "*)" + guarded_arena_at(address) + ";");
+		}
+		else if (skip_load_bounds_check(reg, imm, sizeof(T)))
 		{
 			add_code(dst + " = *(" + type + "*)" + arena_at(address) + ";");
 		}
@@ -455,6 +589,13 @@ struct Emitter
 			throw MachineException(INVALID_PROGRAM, "Unsupported memory store type");
 		}
 	}
+	std::string mark_dirty(const std::string& type, const std::string& address) {
+		if (!tinfo.track_dirty_pages)
+			return "";
+		if (uses_Nbit_encompassing_arena())
+			return " MARK_DIRTY(cpu, (" + address + ") & " + hex_address(address_t(get_Nbit_encompassing_arena_mask())) + ", sizeof(" + type + "));";
+		return " MARK_DIRTY(cpu, " + address + ", sizeof(" + type + "));";
+	}
 	void memory_store(std::string type, int reg, int32_t imm, std::string value)
 	{
 		if (uses_flat_memory_arena()) {
@@ -464,13 +605,13 @@ struct Emitter
 			}
 			constexpr bool good = riscv::encompassing_Nbit_arena != 0;
 			if (absolute_vaddr != 0 && absolute_vaddr >= tinfo.arena_roend && (good || absolute_vaddr < tinfo.arena_size)) {
-				add_code("{" + type + "* t = &" + arena_at_fixed(type, absolute_vaddr) + "; *t = " + value + "; }");
+				add_code("{" + type + "* t = &" + arena_at_fixed(type, absolute_vaddr) + "; *t = " + value + ";" + mark_dirty(type, hex_address(absolute_vaddr)) + " }");
 				return;
 			}
 			if (auto tracked_value = get_tracked_register(reg)) {
 				const address_t vaddr = *tracked_value + imm;
 				if (vaddr >= tinfo.arena_roend && vaddr <= tinfo.arena_size - 32) {
-					add_code("{" + type + "* t = &" + arena_at_fixed(type, vaddr) + "; *t = " + value + "; }");
+					add_code("{" + type + "* t = &" + arena_at_fixed(type, vaddr) + "; *t = " + value + ";" + mark_dirty(type, hex_address(vaddr)) + " }");
 					return;
 				}
 			}
@@ -479,12 +620,12 @@ struct Emitter
 		const std::string address = from_untracked_reg(reg) + " + " + from_imm(imm);
 		if (skip_store_bounds_check(reg, imm, sizeof(type)))
 		{
-			add_code("*(" + type + "*)" + arena_at(address) + " = " + value + ";");
+			add_code("*(" + type + "*)" + arena_at(address) + " = " + value + ";" + mark_dirty(type, address));
 		}
 		else if (uses_flat_memory_arena()) {
 			add_code(
 				"if (LIKELY(ARENA_WRITABLE(" + address + ")))",
-				"  *(" + type + "*)" + arena_at(address) + " = " + value + ";",
+				"  { *(" + type + "*)" + arena_at(address) + " = " + value + ";" + mark_dirty(type, address) + " }",
 				"else {");
 			if (!tinfo.use_virtual_paging_fallback) {
 				add_code("  cpu->pc = " + hex_address(this->pc()) + "LL; goto exception;",
@@ -567,7 +708,6 @@ struct Emitter
 
 	const std::string get_func() const noexcept { return this->func; }
 	void emit();
-	rv32i_instruction emit_rvc();
 
 private:
 	static std::string speculation_safe(const std::string& address) {
@@ -602,27 +742,29 @@ private:
 	}
 	void reset_all_tracked_registers() {
 		this->m_is_tracked_register.fill(false);
-		this->last_read_check_pc = 0;
-		this->last_write_check_pc = 0;
+		this->forget_bounds_checks(IR_CLOBBER_ALL);
 	}
+	void build_ir();
 
 	std::string code;
 	size_t m_idx = 0;
 	address_t m_pc = 0x0;
-	address_t m_last_pc = 0x0;
 	rv32i_instruction instr;
 	unsigned m_instr_length = 0;
 	uint64_t m_instr_counter = 0;
 	uint32_t m_zero_insn_counter = 0;
 	address_t m_encompassing_arena_mask = 0;
-	address_t last_read_check_pc = 0;
-	address_t last_write_check_pc = 0;
-	int last_read_check_register = 0;
-	int last_read_check_offset = 0;
-	int last_write_check_register = 0;
-	int last_write_check_offset = 0;
+	address_t m_guard_arena_mask = 0;
 	bool m_used_store_syscalls = false;
 
+	struct BoundsCheck {
+		bool valid = false;
+		int64_t offset = 0;
+	};
+	std::array<BoundsCheck, 32> m_read_checks {};
+	std::array<BoundsCheck, 32> m_write_checks {};
+	std::vector<EmitIR<W>> m_ir;
+
 	std::array<bool, 32> gpr_exists {};
 	std::array<bool, 32> m_is_tracked_register {};
 	std::array<address_t, 32> m_tracked_registers {};
@@ -812,6 +954,101 @@ inline void Emitter<W>::emit_system_call(std::string syscall_reg, bool clobber_a
 #include "tr_emit_rvc.cpp"
 #endif
 
+template <int W>
+void Emitter<W>::build_ir()
+{
+	const size_t count = tinfo.instr.size();
+	this->m_ir.resize(count);
+
+	address_t pc = tinfo.basepc;
+	for (size_t i = 0; i < count; i++) {
+		auto& ir = this->m_ir[i];
+		ir.instr = tinfo.instr[i];
+		ir.pc = pc;
+		pc += (compressed_enabled) ? ir.instr.length() : 4;
+#ifdef RISCV_EXT_C
+		if (ir.instr.is_compressed())
+			ir.instr = rvc_expand<W>(ir.instr);
+#endif
+		ir.written = ir_written_registers(ir.instr);
+		if (!ir.instr.is_compressed() && !ir.instr.is_illegal()
+			&& !tinfo.ebreak_locations->count(ir.pc)
+			&& ir_simple_instruction<W>(ir.instr, ir.read))
+			ir.flags = IR_SIMPLE;
+	}
+	// Keep traced instructions 1:1 with the original program
+	if (tinfo.trace_instructions)
+		return;
+
+	// Constant propagation across LUI/AUIPC and ADDI. Anything
+	// that is not straight-line code forgets all known values.
+	std::array<bool, 32> known {};
+	std::array<address_t, 32> values {};
+	for (size_t i = 0; i < count; i++) {
+		auto& ir = this->m_ir[i];
+		const bool is_label = tinfo.jump_locations.count(ir.pc)
+			|| tinfo.jump_locations.count(ir.pc + 2)
+			|| tinfo.global_jump_locations.count(ir.pc);
+		if (is_label)
+			known.fill(false);
+		if (!(ir.flags & IR_SIMPLE)) {
+			const auto op = ir.instr.opcode();
+			if (ir.written == IR_CLOBBER_ALL || (op != RV32I_LOAD && op != RV32I_STORE && op != RV32F_LOAD && op != RV32F_STORE))
+				known.fill(false);
+			else if (ir.written != 0)
+				known[ir.instr.Itype.rd] = false;
+			continue;
+		}
+		const unsigned rd = ir.instr.Itype.rd;
+		if (rd == 0)
+			continue;
+		switch (ir.instr.opcode()) {
+		case RV32I_LUI:
+			known[rd] = true;
+			values[rd] = ir.instr.Utype.upper_imm();
+			break;
+		case RV32I_AUIPC:
+			known[rd] = true;
+			values[rd] = ir.pc + ir.instr.Utype.upper_imm();
+			break;
+		case RV32I_OP_IMM:
+			if (ir.instr.Itype.funct3 == 0x0 && ir.instr.Itype.rs1 == 0) {
+				known[rd] = true;
+				values[rd] = ir.instr.Itype.signed_imm();
+				break;
+			} else if (ir.instr.Itype.funct3 == 0x0 && known[ir.instr.Itype.rs1]) {
+				// ADDI on a known value: rd no longer depends on rs1
+				ir.flags |= IR_CONSTANT;
+				ir.value = values[ir.instr.Itype.rs1] + ir.instr.Itype.signed_imm();
+				ir.read = 0;
+				known[rd] = true;
+				values[rd] = ir.value;
+				break;
+			}
+			[[fallthrough]];
+		default:
+			known[rd] = false;
+		}
+	}
+
+	// Dead register stores: a simple instruction whose result is
+	// overwritten before anything can observe it. Labels only add
+	// incoming paths, so they do not make an earlier store live.
+	uint32_t live = ~0u;
+	for (size_t i = count; i-- > 0; ) {
+		auto& ir = this->m_ir[i];
+		if (!(ir.flags & IR_SIMPLE)) {
+			live = ~0u;
+			continue;
+		}
+		if (ir.written != 0 && (live & ir.written) == 0) {
+			ir.flags |= IR_DEAD;
+			continue;
+		}
+		live = (live & ~ir.written) | ir.read;
+	}
+}
+
 template <int W>
 void Emitter<W>::emit()
 {
@@ -820,13 +1057,17 @@ void Emitter<W>::emit()
 	auto next_pc = tinfo.basepc;
 	address_t current_callable_pc = 0;
 	this->m_pc = tinfo.basepc;
-	this->m_last_pc = tinfo.basepc;
+
+	this->build_ir();
+	// Roughly 64 bytes of C per instruction
+	this->code.reserve(this->code.size() + tinfo.instr.size() * 64);
 
 	for (int i = 0; i < int(tinfo.instr.size()); i++) {
 		this->m_idx = i;
 		this->instr = tinfo.instr[i];
-		this->m_last_pc = this->m_pc;
 		this->m_pc = next_pc;
+		if (i > 0)
+			this->forget_bounds_checks(this->m_ir[i-1].written);
 		if constexpr (compressed_enabled)
 			this->m_instr_length = this->instr.length();
 		else
@@ -903,12 +1144,18 @@ void Emitter<W>::emit()
 			this->emit_system_call(std::to_string(SYSCALL_EBREAK), true);
 		}
 
+		if (this->m_ir[i].flags & IR_DEAD) {
+			// Counted, but never observed
+			this->reset_tracked_register(this->m_ir[i].instr.Itype.rd);
+			continue;
+		}
+
 		// instruction generation
 #ifdef RISCV_EXT_C
 		if (instr.is_compressed()) {
 			// Compressed 16-bit instructions
 			auto original = instr.whole;
-			instr = this->emit_rvc();
+			instr = this->m_ir[i].instr;
 
 			if (instr.is_compressed())
 			{
@@ -1159,7 +1406,9 @@ void Emitter<W>::emit()
 
 			switch (instr.Itype.funct3) {
 			case 0x0: // ADDI
-				if (instr.Itype.signed_imm() == 0) {
+				if (this->m_ir[i].flags & IR_CONSTANT) {
+					add_code(dst + " = " + STRADDR(this->m_ir[i].value) + ";");
+				} else if (instr.Itype.signed_imm() == 0) {
 					add_code(dst + " = " + src + ";");
 				} else if (instr.Itype.rs1 == 0) {
 					add_code(dst + " = " + from_imm(instr.Itype.signed_imm()) + ";");
@@ -1283,7 +1532,9 @@ void Emitter<W>::emit()
 			// Register tracking (mostly ADDI)
 			if (instr.Itype.funct3 == 0) {
 				// Track register value when rs1 == 0:
-				if (instr.Itype.rs1 == 0) {
+				if (this->m_ir[i].flags & IR_CONSTANT) {
+					this->track_register_value(instr.Itype.rd, this->m_ir[i].value);
+				} else if (instr.Itype.rs1 == 0) {
 					this->track_register_value(instr.Itype.rd, instr.Itype.signed_imm());
 				} else {
 					if (auto tracked_value = get_tracked_register(instr.Itype.rs1)) {
@@ -2171,20 +2422,21 @@ CPU<W>::emit(std::string& code, const TransInfo<W>& tinfo)
 {
 	Emitter<W> e(tinfo);
 	e.emit();
+	code.reserve(code.size() + e.get_code().size() + 4096);
 
 	// Create register push and pop macros
 	if (tinfo.use_register_caching) {
 		code += "#define STORE_REGS_" + e.get_func() + "() \\\n";
 		for (size_t reg = 1; reg < e.CACHED_REGISTERS; reg++) {
 			if (e.gpr_exists_at(reg)) {
-				code += "  cpu->r[" + std::to_string(reg) + "] = " + e.loaded_regname(reg) + "; \\\n";
+				code += "  " + e.memory_regname(reg) + " = " + e.loaded_regname(reg) + "; \\\n";
 			}
 		}
 		code += "  ;\n";
 		code += "#define LOAD_REGS_" + e.get_func() + "() \\\n";
 		for (size_t reg = 1; reg < e.CACHED_REGISTERS; reg++) {
 			if (e.gpr_exists_at(reg)) {
-				code += "  " + e.loaded_regname(reg) + " = cpu->r[" + std::to_string(reg) + "]; \\\n";
+				code += "  " + e.loaded_regname(reg) + " = " + e.memory_regname(reg) + "; \\\n";
 			}
 		}
 		code += "  ;\n";
@@ -2192,19 +2444,19 @@ CPU<W>::emit(std::string& code, const TransInfo<W>& tinfo)
 			code += "#define STORE_SYS_REGS_" + e.get_func() + "() \\\n";
 			for (size_t reg = 10; reg < 18; reg++) {
 				if (e.gpr_exists_at(reg)) {
-					code += "  cpu->r[" + std::to_string(reg) + "] = " + e.loaded_regname(reg) + "; \\\n";
+					code += "  " + e.memory_regname(reg) + " = " + e.loaded_regname(reg) + "; \\\n";
 				}
 			}
 			code += "  ;\n";
 			code += "#define STORE_NON_SYS_REGS_" + e.get_func() + "() \\\n";
 			for (size_t reg = 0; reg < 10; reg++) {
 				if (e.gpr_exists_at(reg)) {
-					code += "  cpu->r[" + std::to_string(reg) + "] = " + e.loaded_regname(reg) + "; \\\n";
+					code += "  " + e.memory_regname(reg) + " = " + e.loaded_regname(reg) + "; \\\n";
 				}
 			}
 			for (size_t reg = 18; reg < e.CACHED_REGISTERS; reg++) {
 				if (e.gpr_exists_at(reg)) {
-					code += "  cpu->r[" + std::to_string(reg) + "] = " + e.loaded_regname(reg) + "; \\\n";
+					code += "  " + e.memory_regname(reg) + " = " + e.loaded_regname(reg) + "; \\\n";
 				}
 			}
 			code += "  ;\n";
@@ -2212,7 +2464,7 @@ CPU<W>::emit(std::string& code, const TransInfo<W>& tinfo)
 		code += "#define LOAD_SYS_REGS_" + e.get_func() + "() \\\n";
 		for (size_t reg = 10; reg < 12; reg++) {
 			if (e.gpr_exists_at(reg)) {
-				code += "  " + e.loaded_regname(reg) + " = cpu->r[" + std::to_string(reg) + "]; \\\n";
+				code += "  " + e.loaded_regname(reg) + " = " + e.memory_regname(reg) + "; \\\n";
 			}
 		}
 		code += "  ;\n";
@@ -2220,17 +2472,17 @@ CPU<W>::emit(std::string& code, const TransInfo<W>& tinfo)
 
 	// Forward declarations
 	for (const auto& entry : e.get_forward_declared()) {
-		code += "static ReturnValues " + entry + "(CPU*, uint64_t, uint64_t, addr_t);\n";
+		code += "BINTR_FUNC ReturnValues " + entry + "(CPU*, uint64_t, uint64_t, addr_t);\n";
 	}
 
 	// Function header
-	code += "static ReturnValues " + e.get_func() + "(CPU* cpu, uint64_t ic, uint64_t max_ic, addr_t pc) {\n";
+	code += "BINTR_FUNC ReturnValues " + e.get_func() + "(CPU* cpu, uint64_t ic, uint64_t max_ic, addr_t pc) {\n";
 
 	// Function GPRs
 	if (tinfo.use_register_caching) {
 		for (size_t reg = 1; reg < 24; reg++) {
 			if (e.gpr_exists_at(reg)) {
-				code += "addr_t " + e.loaded_regname(reg) + " = cpu->r[" + std::to_string(reg) + "];\n";
+				code += "addr_t " + e.loaded_regname(reg) + " = " + e.memory_regname(reg) + ";\n";
 			}
 		}
 	}
@@ -2277,7 +2529,7 @@ CPU<W>::emit(std::string& code, const TransInfo<W>& tinfo)
 	code += "exception_is_handled:\n"; // Re-using exit point for exceptions
 	for (size_t reg = 1; reg < e.CACHED_REGISTERS; reg++) {
 		if (e.gpr_exists_at(reg)) {
-			code += "  cpu->r[" + std::to_string(reg) + "] = " + e.loaded_regname(reg) + ";\n";
+			code += "  " + e.memory_regname(reg) + " = " + e.loaded_regname(reg) + ";\n";
 		}
 	}
 	code += "  cpu->pc = pc; return (ReturnValues){ic, max_ic};\n";
@@ -2304,4 +2556,15 @@ template std::vector<TransMapping<8>> CPU<8>::emit(std::string&, const TransInfo
 #ifdef RISCV_128I
 template std::vector<TransMapping<16>> CPU<16>::emit(std::string&, const TransInfo<16>&);
 #endif
+#ifdef RISCV_EXT_C
+#ifdef RISCV_32I
+template rv32i_instruction rvc_expand<4>(rv32i_instruction);
+#endif
+#ifdef RISCV_64I
+template rv32i_instruction rvc_expand<8>(rv32i_instruction);
+#endif
+#ifdef RISCV_128I
+template rv32i_instruction rvc_expand<16>(rv32i_instruction);
+#endif
+#endif
 } // riscv
@@ -1,7 +1,8 @@
 
 template <int W>
-rv32i_instruction Emitter<W>::emit_rvc()
+rv32i_instruction rvc_expand(rv32i_instruction instr)
 {
+	using address_t = address_type<W>;
 	#define CI_CODE(x, y) ((x << 13) | (y))
 	const rv32c_instruction ci { instr };
 
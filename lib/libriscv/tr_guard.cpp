@@ -0,0 +1,116 @@
+#include "machine.hpp"
+#include "internal_common.hpp"
+#if defined(__linux__) || defined(__FreeBSD__)
+#include <csetjmp>
+#include <csignal>
+#include <mutex>
+#define RISCV_GUARD_SIGNALS
+#endif
+
+namespace riscv
+{
+#ifdef RISCV_GUARD_SIGNALS
+	// Guarded simulations nest on a thread (eg. vmcalls from system calls),
+	// so each one pushes a context with the arena it owns.
+	struct GuardContext {
+		sigjmp_buf buf;
+		uintptr_t begin;
+		uintptr_t end;
+		uintptr_t fault_addr;
+		GuardContext* prev;
+	};
+	static thread_local GuardContext* current_guard = nullptr;
+	static struct sigaction old_segv_action;
+	static struct sigaction old_bus_action;
+
+	static void chain_signal(int sig, siginfo_t* info, void* uctx)
+	{
+		struct sigaction& old = (sig == SIGBUS) ? old_bus_action : old_segv_action;
+		if (old.sa_flags & SA_SIGINFO) {
+			old.sa_sigaction(sig, info, uctx);
+		} else if (old.sa_handler == SIG_DFL) {
+			// Returning re-executes the faulting instruction
+			// with the default disposition restored.
+			sigaction(sig, &old, nullptr);
+		} else if (old.sa_handler != SIG_IGN) {
+			old.sa_handler(sig);
+		}
+	}
+
+	static void guard_signal_handler(int sig, siginfo_t* info, void* uctx)
+	{
+		GuardContext* ctx = current_guard;
+		const auto addr = uintptr_t(info->si_addr);
+		// Only the part of the reservation past the arena is inaccessible,
+		// and host-side helpers are bounds-checked against the arena size,
+		// so a fault inside the reservation always comes from a masked load.
+		if (ctx != nullptr && addr >= ctx->begin && addr < ctx->end) {
+			ctx->fault_addr = addr;
+			siglongjmp(ctx->buf, 1);
+		}
+		chain_signal(sig, info, uctx);
+	}
+
+	static void install_guard_signal_handlers()
+	{
+		static std::once_flag installed;
+		std::call_once(installed, [] {
+			struct sigaction sa {};
+			sa.sa_sigaction = guard_signal_handler;
+			sa.sa_flags = SA_SIGINFO | SA_NODEFER | SA_ONSTACK;
+			sigemptyset(&sa.sa_mask);
+			sigaction(SIGSEGV, &sa, &old_segv_action);
+			sigaction(SIGBUS, &sa, &old_bus_action);
+		});
+	}
+
+	template <int W>
+	bool CPU<W>::simulate_guarded(address_t pc, uint64_t icounter, uint64_t maxcounter)
+	{
+		install_guard_signal_handlers();
+
+		GuardContext ctx;
+		ctx.begin = uintptr_t(memory().guard_paged_arena_begin());
+		ctx.end   = uintptr_t(memory().guard_paged_arena_end());
+		ctx.fault_addr = 0;
+		ctx.prev  = current_guard;
+
+		if (sigsetjmp(ctx.buf, 0) != 0) {
+			// The translated code faulted inside the reservation. Registers
+			// written by the current block may not have been stored back.
+			current_guard = ctx.prev;
+			trigger_exception(PROTECTION_FAULT,
+				address_t(ctx.fault_addr - uintptr_t(memory().memory_arena_ptr())));
+		}
+
+		// siglongjmp() skips every frame between here and the faulting load
+		// without unwinding. Those are the dispatch loop and translated code,
+		// which must never hold locals with non-trivial destructors.
+		current_guard = &ctx;
+		try {
+			const bool result = this->simulate(pc, icounter, maxcounter);
+			current_guard = ctx.prev;
+			return result;
+		} catch (...) {
+			current_guard = ctx.prev;
+			throw;
+		}
+	}
+#else
+	template <int W>
+	bool CPU<W>::simulate_guarded(address_t pc, uint64_t icounter, uint64_t maxcounter)
+	{
+		return this->simulate(pc, icounter, maxcounter);
+	}
+#endif
+
+#ifdef RISCV_32I
+	template bool CPU<4>::simulate_guarded(address_t, uint64_t, uint64_t);
+#endif
+#ifdef RISCV_64I
+	template bool CPU<8>::simulate_guarded(address_t, uint64_t, uint64_t);
+#endif
+#ifdef RISCV_128I
+	template bool CPU<16>::simulate_guarded(address_t, uint64_t, uint64_t);
+#endif
+}
@@ -9,8 +9,11 @@
 #include <cmath>
 #include <chrono>
 #include <fstream>
+#include <list>
 #include <mutex>
 #include <sstream>
+#include <string_view>
+#include <thread>
 #if defined(__MINGW32__) || defined(__MINGW64__) || defined(_MSC_VER)
 # define YEP_IS_WINDOWS 1
 # include "win32/dlfcn.h"
@@ -56,6 +59,46 @@ namespace riscv
 		}
 	extern void  dylib_close(void* dylib, bool is_libtcc);
 	extern void* dylib_lookup(void* dylib, const char*, bool is_libtcc);
+	extern int  translation_cache_lock(const std::string& filename);
+	extern void translation_cache_unlock(int fd);
+	extern void translation_cache_touch(const std::string& filename);
+	extern std::pair<uint64_t, uint64_t> translation_cache_evict(const std::string& prefix,
+		const std::string& suffix, uint64_t max_bytes, const std::string& keep);
+	// Only one process compiles a given translation, while
+	// the others wait for it and then load the published result
+	struct TranslationCacheLock {
+		TranslationCacheLock(bool enabled, const std::string& filename)
+			: fd(enabled ? translation_cache_lock(filename) : -1) {}
+		~TranslationCacheLock() { translation_cache_unlock(fd); }
+		const int fd;
+	};
+
+	static struct {
+		std::atomic<uint64_t> hits = 0;
+		std::atomic<uint64_t> misses = 0;
+		std::atomic<uint64_t> compile_time_ns = 0;
+		std::atomic<uint64_t> evicted_files = 0;
+		std::atomic<uint64_t> evicted_bytes = 0;
+	} cache_stats;
+
+	TranslationCacheStats translation_cache_stats() noexcept
+	{
+		return TranslationCacheStats {
+			.hits = cache_stats.hits.load(),
+			.misses = cache_stats.misses.load(),
+			.compile_time_ns = cache_stats.compile_time_ns.load(),
+			.evicted_files = cache_stats.evicted_files.load(),
+			.evicted_bytes = cache_stats.evicted_bytes.load(),
+		};
+	}
+	void reset_translation_cache_stats() noexcept
+	{
+		cache_stats.hits = 0;
+		cache_stats.misses = 0;
+		cache_stats.compile_time_ns = 0;
+		cache_stats.evicted_files = 0;
+		cache_stats.evicted_bytes = 0;
+	}
 
 	template <int W>
 	using binary_translation_init_func = void (*)(const CallbackTable<W>&, int32_t, int32_t, int32_t);
@@ -202,6 +245,21 @@ static std::unordered_map<std::string, std::string> create_defines_for(const Mac
 	if constexpr (encompassing_Nbit_arena != 0) {
 		defines.emplace("RISCV_NBIT_UNBOUNDED", std::to_string(encompassing_Nbit_arena));
 	}
+	if (options.track_dirty_pages) {
+		// Translated arena stores must also mark pages dirty
+		defines.emplace("RISCV_DIRTY_TRACKING", "1");
+	}
+	if (!options.translator_block_profile.empty()) {
+		// A different profile selects different blocks, so it's part of the hash
+		uint32_t hash = 0;
+		for (const auto& entry : options.translator_block_profile) {
+			hash = crc32c(hash, &entry.first, sizeof(entry.first));
+			hash = crc32c(hash, &entry.second, sizeof(entry.second));
+		}
+		char buffer[16];
+		snprintf(buffer, sizeof(buffer), "0x%08X", hash);
+		defines.emplace("RISCV_BLOCK_PROFILE", buffer);
+	}
 	return defines;
 }
 
@@ -231,6 +289,12 @@ int CPU<W>::load_translation(const MachineOptions<W>& options,
 		return 0;
 	}
 
+	// The native backend emits machine code in-process, without a compiler
+	if (options.translate_native && !has_cross_compile && !exec.is_binary_translated()) {
+		if (native_translate(options, exec, machine()))
+			return 0;
+	}
+
 	// Checksum the execute segment, ...
 	TIME_POINT(t5);
 	const std::string cflags = defines_to_string(create_defines_for(machine(), options));
@@ -242,10 +306,14 @@ int CPU<W>::load_translation(const MachineOptions<W>& options,
 	// Also add the compiler flags to the checksum
 	checksum = crc32c(checksum, cflags.c_str(), cflags.size());
 	exec.set_translation_hash(checksum);
+	// Shared objects from the system compiler are also keyed on the
+	// compiler and its flags, so that changing CC or CFLAGS recompiles
+	const std::string command = compile_command(W, cflags);
+	const uint32_t cache_key = crc32c(checksum, command.c_str(), command.size());
 
 	char filebuffer[512];
 	int len = snprintf(filebuffer, sizeof(filebuffer),
-		"%s%08X%s", options.translation_prefix.c_str(), checksum, options.translation_suffix.c_str());
+		"%s%08X%s", options.translation_prefix.c_str(), cache_key, options.translation_suffix.c_str());
 	if (len <= 0)
 		return -1;
 
@@ -270,23 +338,9 @@ int CPU<W>::load_translation(const MachineOptions<W>& options,
 			if (translation.hash == checksum)
 			{
 				// Initialize the translation
-				Machine<W>& m = const_cast<Machine<W>&> (machine());
-				auto counters = m.get_counters();
-
-				const int32_t ins_counter_offset = uintptr_t(&counters.first) - uintptr_t(&m);
-				const int32_t max_counter_offset = uintptr_t(&counters.second) - uintptr_t(&m);
-				if (ins_counter_offset + sizeof(uint64_t) != max_counter_offset) {
-					throw MachineException(INVALID_PROGRAM, "Invalid counter offsets in emulator");
-				}
-				const int32_t arena_offset = uintptr_t(&machine().memory.memory_arena_ptr_ref()) - uintptr_t(&m);
-#ifdef RISCV_VIRTUAL_PAGING
-				const int32_t rdcache_offset = uintptr_t(&machine().memory.rdcache()) - uintptr_t(&m);
-#else
-				const int32_t rdcache_offset = 0;
-#endif
-
+				const auto offsets = translation_offsets(machine());
 				translation.init_func(create_bintr_callback_table(exec),
-					arena_offset, ins_counter_offset, rdcache_offset);
+					offsets.arena_offset, offsets.ins_counter_offset, offsets.rdcache_offset);
 
 				if (options.verbose_loader) {
 					printf("libriscv: Found embedded translation for hash %08X, %u/%u mappings\n",
@@ -340,13 +394,20 @@ int CPU<W>::load_translation(const MachineOptions<W>& options,
 		}
 	}
 	bool must_compile = dylib == nullptr;
+	if (dylib != nullptr) {
+		translation_cache_touch(filebuffer);
+		cache_stats.hits++;
+	}
 
 	// JIT-compilation with libtcc is secondary to high-performance
 	// pre-compiled translations. If no embedded translation is found,
 	// and no shared library is found we may JIT-compile the translation.
 	if constexpr (libtcc_enabled) {
-		if (must_compile)
+		if (must_compile) {
+			// Tiered translation stores the optimized shared object here
+			if (filename) *filename = std::string(filebuffer);
 			return 1;
+		}
 	}
 
 #ifndef _MSC_VER
@@ -524,12 +585,8 @@ if constexpr (SCAN_FOR_GP) {
 		}
 	}
 
-	for (address_t pc = basepc; pc < endbasepc && icounter < options.translate_instr_max; )
-	{
-		const auto block = pc;
-		std::size_t block_insns = 0;
-
-		for (; pc < endbasepc; ) {
+	auto find_block_end = [&] (address_t pc) -> address_t {
+		for (std::size_t block_insns = 0; pc < endbasepc; ) {
 			const rv32i_instruction instruction
 				= read_instruction(exec.exec_data(), pc, endbasepc);
 			if constexpr (compressed_enabled)
@@ -543,11 +600,68 @@ if constexpr (SCAN_FOR_GP) {
 				break;
 			}
 		}
+		return pc;
+	};
+
+	// Profile-guided translation: Only blocks that were executed
+	// are translated, hottest first. Cold code stays interpreted.
+	const bool profile_guided = !options.translator_block_profile.empty();
+	struct HotBlock {
+		address_t begin;
+		address_t end;
+		uint64_t  executions;
+	};
+	std::vector<HotBlock> hot_blocks;
+	if (profile_guided) {
+		std::vector<std::pair<address_t, uint32_t>> profile;
+		for (const auto& entry : options.translator_block_profile) {
+			if (entry.first >= basepc && entry.first < endbasepc && entry.second != 0) {
+				profile.push_back(entry);
+				// The interpreter enters translated code at profiled block heads
+				global_jump_locations.insert(entry.first);
+			}
+		}
+		std::sort(profile.begin(), profile.end());
+
+		auto it = profile.begin();
+		for (address_t pc = basepc; pc < endbasepc && it != profile.end(); )
+		{
+			const address_t block_end = find_block_end(pc);
+			uint64_t executions = 0;
+			for (; it != profile.end() && it->first < block_end; ++it)
+				executions += it->second;
+			if (executions > 0)
+				hot_blocks.push_back({pc, block_end, executions});
+			pc = block_end;
+		}
+		std::stable_sort(hot_blocks.begin(), hot_blocks.end(),
+			[] (const HotBlock& a, const HotBlock& b) { return a.executions > b.executions; });
+		if (verbose) {
+			printf("libriscv: Block profile has %zu hot blocks in segment 0x%lX -> 0x%lX\n",
+				hot_blocks.size(), (long)basepc, (long)endbasepc);
+		}
+	}
+	size_t next_hot_block = 0;
+
+	for (address_t pc = basepc; icounter < options.translate_instr_max; )
+	{
+		address_t block, block_end;
+		if (profile_guided) {
+			if (next_hot_block >= hot_blocks.size())
+				break;
+			block = hot_blocks[next_hot_block].begin;
+			block_end = hot_blocks[next_hot_block].end;
+			next_hot_block++;
+		} else {
+			if (pc >= endbasepc)
+				break;
+			block = pc;
+			block_end = find_block_end(pc);
+		}
 
-		auto block_end = pc;
 		std::unordered_set<address_t> jump_locations;
 		std::vector<rv32i_instruction> block_instructions;
-		block_instructions.reserve(block_insns);
+		block_instructions.reserve((block_end - block) / 4);
 
 		// Find jump locations inside block
 		for (pc = block; pc < block_end; ) {
@@ -650,8 +764,10 @@ if constexpr (SCAN_FOR_GP) {
 				options.translate_use_register_caching,
 				options.translate_use_syscall_clobbering_optimization,
 				options.translate_automatic_nbit_address_space,
+				machine().memory.uses_guard_paged_arena(),
 				options.translate_use_virtual_paging_fallback,
 				options.translate_unsafe_remove_checks,
+				options.track_dirty_pages,
 				std::move(jump_locations),
 				std::move(single_return_locations),
 				nullptr, // blocks
@@ -682,9 +798,11 @@ if constexpr (SCAN_FOR_GP) {
 	extern const std::string bintr_code;
 	output.code = std::make_shared<std::string>(bintr_code);
 
+	output.block_offsets.reserve(blocks.size());
 	for (auto& block : blocks)
 	{
 		block.blocks = &blocks;
+		output.block_offsets.push_back(output.code->size());
 		auto result = emit(*output.code, block);
 
 		for (auto& mapping : result) {
@@ -857,10 +975,157 @@ EXTERN_C __attribute__((used, visibility("default"))) void libriscv_init_with_ca
 	}
 }
 
+// Split the emitted blocks into translation units that can be compiled
+// concurrently. Each unit gets its own copy of the shared header, and the
+// last unit holds the mapping tables and the init function for all units.
+template <int W>
+static std::vector<std::string> split_translation_units(const TransOutput<W>& output, unsigned units)
+{
+	const std::string& code = *output.code;
+	const size_t header_end = output.block_offsets.at(0);
+	const size_t target_size = (code.size() - header_end) / units + 1;
+	const std::string_view header(code.data(), header_end);
+
+	std::vector<std::string> result;
+	for (size_t i = 0; i < output.block_offsets.size(); )
+	{
+		// Group consecutive blocks until the unit is big enough
+		const size_t begin = output.block_offsets[i];
+		size_t end = code.size();
+		for (i++; i < output.block_offsets.size(); i++) {
+			if (output.block_offsets[i] - begin >= target_size) {
+				end = output.block_offsets[i];
+				break;
+			}
+		}
+		std::string unit = "#define TRANSLATION_UNIT init_unit" + std::to_string(result.size()) + "\n";
+		unit.reserve(unit.size() + header.size() + (end - begin));
+		unit += header;
+		unit.append(code, begin, end - begin);
+		result.push_back(std::move(unit));
+	}
+
+	// The final unit references the block functions of all other units
+	std::string footer = "#define TRANSLATION_UNIT init_unit_footer\n";
+	footer += header;
+	std::unordered_set<std::string> declared;
+	for (const auto& mapping : output.mappings) {
+		if (declared.insert(mapping.symbol).second)
+			footer += "BINTR_FUNC ReturnValues " + mapping.symbol + "(CPU*, uint64_t, uint64_t, addr_t);\n";
+	}
+	for (size_t i = 0; i < result.size(); i++) {
+		footer += "INTERNAL void init_unit" + std::to_string(i) + "(struct CallbackTable*, int32_t, int32_t, int32_t);\n";
+	}
+	footer += output.footer;
+	footer += "extern VISIBLE void init(struct CallbackTable* table, int32_t arena_off, int32_t ins_counter_off, int32_t rdcache_off) {\n";
+	for (size_t i = 0; i < result.size(); i++) {
+		footer += "\tinit_unit" + std::to_string(i) + "(table, arena_off, ins_counter_off, rdcache_off);\n";
+	}
+	footer += "}\n";
+	result.push_back(std::move(footer));
+	return result;
+}
+
+template <int W>
+static unsigned translation_unit_count(const MachineOptions<W>& options, const TransOutput<W>& output)
+{
+	if (output.block_offsets.empty())
+		return 1;
+	unsigned units = options.translate_compile_units;
+	if (units == 0) {
+		// Each unit repeats the header, so avoid splitting small translations
+		static constexpr size_t MIN_UNIT_SIZE = 256 * 1024;
+		const size_t code_size = output.code->size() - output.block_offsets[0];
+		const size_t max_units = code_size / MIN_UNIT_SIZE;
+		units = std::max(1u, std::min(std::thread::hardware_concurrency(), unsigned(std::min(max_units, size_t(256)))));
+	}
+	return std::min(units, unsigned(output.block_offsets.size()));
+}
+
+// Process-wide cache of libtcc translations, which outlives the execute
+// segments (and machines) that compiled them. Each execute segment using
+// a translation holds a reference to it, and the cache holds a reference
+// to the most recently used translations.
+template <int W>
+struct SharedTranslationCache
+{
+	struct Key {
+		uint32_t hash;
+		address_type<W> begin;
+		address_type<W> end;
+		unsigned blocks_max;
+		unsigned instr_max;
+		bool operator==(const Key&) const noexcept = default;
+	};
+	struct KeyHash {
+		size_t operator()(const Key& key) const noexcept {
+			return key.hash ^ std::hash<uint64_t>{}(uint64_t(key.begin) << 32 ^ uint64_t(key.end));
+		}
+	};
+	using Entry = std::pair<Key, std::shared_ptr<void>>;
+
+	std::shared_ptr<void> get(const Key& key)
+	{
+		std::scoped_lock lock(m_mutex);
+		auto it = m_entries.find(key);
+		if (it == m_entries.end())
+			return nullptr;
+		// Most recently used translations are at the front
+		m_lru.splice(m_lru.begin(), m_lru, it->second);
+		return it->second->second;
+	}
+	void insert(const Key& key, std::shared_ptr<void> translation, size_t capacity)
+	{
+		std::scoped_lock lock(m_mutex);
+		auto it = m_entries.find(key);
+		if (it != m_entries.end()) {
+			m_lru.erase(it->second);
+			m_entries.erase(it);
+		}
+		m_lru.emplace_front(key, std::move(translation));
+		m_entries.emplace(key, m_lru.begin());
+		while (m_lru.size() > capacity) {
+			m_entries.erase(m_lru.back().first);
+			m_lru.pop_back();
+		}
+	}
+
+private:
+	std::mutex m_mutex;
+	std::list<Entry> m_lru;
+	std::unordered_map<Key, typename std::list<Entry>::iterator, KeyHash> m_entries;
+};
+template <int W>
+static SharedTranslationCache<W> shared_translation_cache;
+
+template <int W>
+static typename SharedTranslationCache<W>::Key shared_translation_key(const MachineOptions<W>& options, const DecodedExecuteSegment<W>& exec)
+{
+	return { exec.translation_hash(), exec.exec_begin(), exec.exec_end(),
+		options.translate_blocks_max, options.translate_instr_max };
+}
+
 template <int W>
 void CPU<W>::try_translate(const MachineOptions<W>& options, const std::string& filename,
 	std::shared_ptr<DecodedExecuteSegment<W>>& shared_segment) const
 {
+#ifdef RISCV_LIBTCC
+	// Re-use libtcc translations from destroyed execute segments
+	if (options.libtcc_code_cache_size > 0 && options.translate_invoke_compiler && options.cross_compile.empty())
+	{
+		auto translation = shared_translation_cache<W>.get(shared_translation_key(options, *shared_segment));
+		if (translation != nullptr) {
+			void* dylib = translation.get();
+			shared_segment->set_shared_translation(std::move(translation));
+			activate_dylib(options, *shared_segment, dylib, machine(), true, false);
+			if (options.verbose_loader) {
+				printf("libriscv: Re-using shared libtcc translation with hash %08X\n",
+					shared_segment->translation_hash());
+			}
+			return;
+		}
+	}
+#endif
 	// Check if compiling new translations is enabled
 	if (!options.translate_invoke_compiler) {
 		// Check if there are any embeddable code options
@@ -881,21 +1146,34 @@ void CPU<W>::try_translate(const MachineOptions<W>& options, const std::string&
 	output.t0 = t0;
 
 	output.defines = create_defines_for(machine(), options);
+	// Tiered translation: libtcc output goes live immediately, and the
+	// same code is then compiled with the system compiler in the background.
+	const bool tiered = libtcc_enabled
+		&& options.translate_tiered
+		&& options.translate_invoke_compiler
+		&& options.translate_background_callback != nullptr
+		&& !filename.empty();
 	// Live-patching is enabled if the user has provided a callback,
 	// and the program is big enough for live patching to be useful.
 	// This is a heuristic, but it should work well enough.
-	const bool live_patch =
-		options.translate_background_callback != nullptr
+	const bool live_patch = !tiered
+		&& options.translate_background_callback != nullptr
 		&& shared_segment->size_bytes() >= 24000;
 
 	// Compilation step
 	std::function<void()> compilation_step =
-	[this, options, output = std::move(output), filename, live_patch, shared_segment = shared_segment] () mutable
+	[this, options, output = std::move(output), filename, tiered, live_patch, shared_segment = shared_segment] () mutable
 	{
 		try {
 			auto* exec = shared_segment.get();
 
 			this->binary_translate(options, *exec, output);
+			// A block profile may leave nothing to translate
+			if (output.mappings.empty()) {
+				if (live_patch)
+					exec->set_background_compiling(false);
+				return;
+			}
 
 			//printf("*** Compiling translation from 0x%lX to 0x%lX ***\n",
 			//	long(shared_segment->exec_begin()), long(shared_segment->exec_end()));
@@ -911,7 +1189,7 @@ void CPU<W>::try_translate(const MachineOptions<W>& options, const std::string&
 
 			void* dylib = nullptr;
 			// Final shared library loadable code w/footer
-			const std::string shared_library_code = *output.code + output.footer;
+			std::string shared_library_code = *output.code + output.footer;
 
 			TIME_POINT(t9);
 			// If translate_invoke_compiler is disabled, do not compile
@@ -928,9 +1206,14 @@ void CPU<W>::try_translate(const MachineOptions<W>& options, const std::string&
 						fprintf(stderr, "libriscv: Failed to write libtcc output to file\n");
 					}
 				}
+				const auto tc0 = std::chrono::steady_clock::now();
 				dylib = libtcc_compile(shared_library_code, W, output.defines, "");
+				cache_stats.misses++;
+				cache_stats.compile_time_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+					std::chrono::steady_clock::now() - tc0).count();
 			} else if (options.translate_invoke_compiler) {
 				extern void* compile(const std::string&, int arch, const std::string& cflags, const std::string&);
+				extern void* compile_units(const std::vector<std::string>&, int arch, const std::string& cflags, const std::string&);
 				extern bool mingw_compile(const std::string&, int arch, const std::string& cflags, const std::string&, const MachineTranslationCrossOptions&);
 				const std::string cflags = defines_to_string(output.defines);
 
@@ -938,7 +1221,34 @@ void CPU<W>::try_translate(const MachineOptions<W>& options, const std::string&
 				if (exec->is_binary_translated()) {
 					dylib = exec->binary_translation_so();
 				} else {
-					dylib = compile(shared_library_code, W, cflags, filename);
+					TranslationCacheLock cache_lock { options.translation_cache, filename };
+					if (cache_lock.fd >= 0)
+						dylib = dlopen(filename.c_str(), RTLD_LAZY);
+
+					if (dylib != nullptr) {
+						translation_cache_touch(filename);
+						cache_stats.hits++;
+					} else {
+						const auto tc0 = std::chrono::steady_clock::now();
+						if (const unsigned units = translation_unit_count(options, output); units > 1) {
+							if (options.verbose_loader) {
+								printf("libriscv: Compiling translation as %u translation units\n", units);
+							}
+							dylib = compile_units(split_translation_units(output, units), W, cflags, filename);
+						} else {
+							dylib = compile(shared_library_code, W, cflags, filename);
+						}
+						cache_stats.misses++;
+						cache_stats.compile_time_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+							std::chrono::steady_clock::now() - tc0).count();
+
+						if (dylib != nullptr && options.translation_cache && options.translation_cache_max_bytes != 0) {
+							const auto [files, bytes] = translation_cache_evict(options.translation_prefix,
+								options.translation_suffix, options.translation_cache_max_bytes, filename);
+							cache_stats.evicted_files += files;
+							cache_stats.evicted_bytes += bytes;
+						}
+					}
 				}
 
 				// Optionally produce cross-compiled binaries
@@ -966,6 +1276,19 @@ void CPU<W>::try_translate(const MachineOptions<W>& options, const std::string&
 			if (dylib != nullptr) {
 				if (!exec->is_binary_translated()) {
 					activate_dylib(options, *exec, dylib, machine(), libtcc_enabled, live_patch);
+#ifdef RISCV_LIBTCC
+					// Share the libtcc translation with future execute segments
+					if (options.libtcc_code_cache_size > 0 && options.cross_compile.empty()
+						&& exec->binary_translation_so() == dylib)
+					{
+						std::shared_ptr<void> translation(dylib, [] (void* dylib) {
+							dylib_close(dylib, true);
+						});
+						exec->set_shared_translation(translation);
+						shared_translation_cache<W>.insert(shared_translation_key(options, *exec),
+							std::move(translation), options.libtcc_code_cache_size);
+					}
+#endif
 				}
 
 				if constexpr (!libtcc_enabled) {
@@ -976,6 +1299,55 @@ void CPU<W>::try_translate(const MachineOptions<W>& options, const std::string&
 				}
 			}
 
+			if constexpr (libtcc_enabled) {
+				if (tiered && dylib != nullptr && exec->is_binary_translated() && exec->is_libtcc()) {
+					// Second tier: Compile the same code with the system compiler, in
+					// the background, and swap in the optimized functions when ready.
+					// The mappings and handlers are emitted in the same order.
+					std::function<void()> optimizing_step =
+					[options, code = std::move(shared_library_code), cflags = defines_to_string(output.defines), filename,
+					 shared_segment, offsets = translation_offsets(machine())] ()
+					{
+						auto* exec = shared_segment.get();
+						try {
+							TIME_POINT(t13);
+							extern void* compile(const std::string&, int arch, const std::string& cflags, const std::string&);
+							// compile() publishes the shared object by renaming it into
+							// place, and the lock keeps other processes from compiling it too
+							TranslationCacheLock cache_lock { options.translation_cache, filename };
+							void* optimized = nullptr;
+							if (cache_lock.fd >= 0)
+								optimized = dlopen(filename.c_str(), RTLD_LAZY);
+							if (optimized != nullptr)
+								translation_cache_touch(filename);
+							else
+								optimized = compile(code, W, cflags, filename);
+							if (optimized != nullptr) {
+								const bool swapped = swap_in_dylib(*exec, optimized, offsets);
+								if (options.translate_timing) {
+									TIME_POINT(t14);
+									printf(">> Tiered compilation took %.2f ms (%s)\n",
+										nanodiff(t13, t14) / 1e6, swapped ? "swapped in" : "mismatch");
+								}
+								if (!options.translation_cache) {
+									// Delete the shared object if it is unwanted
+									unlink(filename.c_str());
+								}
+							} else if (options.verbose_loader) {
+								fprintf(stderr, "libriscv: Tiered compilation failed, keeping libtcc translation\n");
+							}
+						} catch (const std::exception& e) {
+							if (options.verbose_loader) {
+								fprintf(stderr, "libriscv: Tiered compilation failed: %s\n", e.what());
+							}
+						}
+						exec->set_background_compiling(false);
+					};
+					exec->set_background_compiling(true);
+					options.translate_background_callback(optimizing_step);
+				}
+			}
+
 			if (options.translate_timing) {
 				TIME_POINT(t12);
 				printf(">> Binary translation totals %.2f ms\n", nanodiff(output.t0, t12) / 1e6);
@@ -1012,7 +1384,7 @@ void CPU<W>::activate_dylib(const MachineOptions<W>& options, DecodedExecuteSegm
 {
 	TIME_POINT(t11);
 
-	if (!initialize_translated_segment(exec, dylib, machine, is_libtcc))
+	if (!initialize_translated_segment(exec, dylib, translation_offsets(machine), is_libtcc))
 	{
 		if constexpr (!libtcc_enabled) {
 			// only warn when translation is not already disabled
@@ -1020,10 +1392,11 @@ void CPU<W>::activate_dylib(const MachineOptions<W>& options, DecodedExecuteSegm
 				fprintf(stderr, "libriscv: Could not find dylib init function\n");
 			}
 		}
-		if (dylib != nullptr) {
+		if (dylib != nullptr && !exec.is_translation_shared(dylib)) {
 			dylib_close(dylib, is_libtcc);
 		}
 		exec.set_binary_translated(nullptr, false);
+		exec.set_shared_translation(nullptr);
 		exec.set_background_compiling(false);
 		return;
 	}
@@ -1035,8 +1408,10 @@ void CPU<W>::activate_dylib(const MachineOptions<W>& options, DecodedExecuteSegm
 	const auto* handlers = (const bintr_block_func<W> *)dylib_lookup(dylib, "unique_mappings", is_libtcc);
 
 	if (no_mappings == nullptr || mappings == nullptr || *no_mappings > 500000UL) {
-		dylib_close(dylib, is_libtcc);
+		if (!exec.is_translation_shared(dylib))
+			dylib_close(dylib, is_libtcc);
 		exec.set_binary_translated(nullptr, false);
+		exec.set_shared_translation(nullptr);
 		throw MachineException(INVALID_PROGRAM, "Invalid mappings in binary translation program");
 	}
 
@@ -1068,11 +1443,17 @@ void CPU<W>::activate_dylib(const MachineOptions<W>& options, DecodedExecuteSegm
 	static constexpr bool enable_live_patching = true;
 
 	// Create N+1 mappings, where the last one is a catch-all for invalid mappings
-	auto& exec_mappings = exec.create_mappings(unique_mappings + 1);
-	std::copy(handlers, handlers + unique_mappings, exec_mappings.begin());
-	exec.set_mapping(unique_mappings, [] (CPU<W>&, uint64_t, uint64_t, address_t) -> bintr_block_returns<W> {
-		throw MachineException(INVALID_PROGRAM, "Translation mapping outside execute area");
-	});
+	// With tiered translation, there is a second set of N+1 mappings for the
+	// optimized handlers, so that they can be swapped in without resizing.
+	const unsigned mapping_sets = (is_libtcc && options.translate_tiered) ? 2 : 1;
+	auto& exec_mappings = exec.create_mappings(mapping_sets * (unique_mappings + 1));
+	for (unsigned set = 0; set < mapping_sets; set++) {
+		const unsigned base = set * (unique_mappings + 1);
+		std::copy(handlers, handlers + unique_mappings, exec_mappings.begin() + base);
+		exec.set_mapping(base + unique_mappings, [] (CPU<W>&, uint64_t, uint64_t, address_t) -> bintr_block_returns<W> {
+			throw MachineException(INVALID_PROGRAM, "Translation mapping outside execute area");
+		});
+	}
 
 	// Apply mappings to decoder cache
 	// NOTE: It is possible to optimize this by applying from the end towards the beginning
@@ -1091,6 +1472,7 @@ void CPU<W>::activate_dylib(const MachineOptions<W>& options, DecodedExecuteSegm
 					// NOTE: If we don't use the patched decoder here, entries
 					// will trample each other in the patched decoder cache.
 					auto& entry = decoder_entry_at(patched_decoder, addr);
+					DecoderData<W>::unfuse_at(patched_decoder, exec.exec_begin(), addr);
 					// If the entry is already the last one in the block,
 					// we can skip the processing entirely.
 					if (entry.block_bytes() == 0) {
@@ -1200,12 +1582,14 @@ void CPU<W>::activate_dylib(const MachineOptions<W>& options, DecodedExecuteSegm
 				} else {
 					// Normal block-end hint that will be transformed into a translation
 					// bytecode if it passes a few more checks, later.
+					DecoderData<W>::unfuse_at(exec.decoder_cache(), exec.exec_begin(), addr);
 					auto& entry = decoder_entry_at(exec.decoder_cache(), addr);
 					entry.set_bytecode(RV32I_BC_TRANSLATOR);
 					entry.set_invalid_handler();
 					entry.instr = mapping_index;
 				}
 			} else {
+				DecoderData<W>::unfuse_at(exec.decoder_cache(), exec.exec_begin(), addr);
 				auto& entry = decoder_entry_at(exec.decoder_cache(), addr);
 				entry.set_bytecode(0x0); /* Invalid opcode */
 			}
@@ -1537,7 +1921,28 @@ CallbackTable<W> create_bintr_callback_table(DecodedExecuteSegment<W>&)
 }
 
 template <int W>
-bool CPU<W>::initialize_translated_segment(DecodedExecuteSegment<W>& exec, void* dylib, const Machine<W>& machine, bool is_libtcc)
+TransOffsets CPU<W>::translation_offsets(const Machine<W>& machine)
+{
+	auto counters = const_cast<Machine<W>&> (machine).get_counters();
+	// Translated code expects the max counter right after the instruction counter
+	const uintptr_t ins_counter_offset = uintptr_t(&counters.first) - uintptr_t(&machine);
+	const uintptr_t max_counter_offset = uintptr_t(&counters.second) - uintptr_t(&machine);
+	if (ins_counter_offset + sizeof(uint64_t) != max_counter_offset) {
+		throw MachineException(INVALID_PROGRAM, "Invalid counter offsets in emulator");
+	}
+	TransOffsets offsets;
+	offsets.ins_counter_offset = ins_counter_offset;
+	offsets.arena_offset = uintptr_t(&machine.memory.memory_arena_ptr_ref()) - uintptr_t(&machine);
+#ifdef RISCV_VIRTUAL_PAGING
+	offsets.rdcache_offset = uintptr_t(&machine.memory.rdcache()) - uintptr_t(&machine);
+#else
+	offsets.rdcache_offset = 0;
+#endif
+	return offsets;
+}
+
+template <int W>
+bool CPU<W>::initialize_translated_segment(DecodedExecuteSegment<W>& exec, void* dylib, const TransOffsets& offsets, bool is_libtcc)
 {
 	// NOTE: At some point this must be able to duplicate the dylib
 	// in order to be able to share execute segments across machines.
@@ -1548,23 +1953,66 @@ bool CPU<W>::initialize_translated_segment(DecodedExecuteSegment<W>& exec, void*
 	}
 
 	// Map the API callback table
-	auto counters = const_cast<Machine<W>&> (machine).get_counters();
 	auto func = (binary_translation_init_func<W>) ptr;
+	func(create_bintr_callback_table<W>(exec),
+		offsets.arena_offset, offsets.ins_counter_offset, offsets.rdcache_offset);
 
-	const int32_t ins_counter_offset = uintptr_t(&counters.first) - uintptr_t(&machine);
-	const int32_t max_counter_offset = uintptr_t(&counters.second) - uintptr_t(&machine);
-	if (ins_counter_offset + sizeof(uint64_t) != max_counter_offset) {
-		throw MachineException(INVALID_PROGRAM, "Invalid counter offsets in emulator");
+	return true;
+}
+
+template <int W>
+bool CPU<W>::swap_in_dylib(DecodedExecuteSegment<W>& exec, void* dylib, const TransOffsets& offsets)
+{
+	// The optimized dylib was compiled from the same code as the active
+	// libtcc translation, so its unique handlers must line up exactly.
+	const uint32_t* no_handlers = (const uint32_t *)dylib_lookup(dylib, "no_handlers", false);
+	const auto* handlers = (const bintr_block_func<W> *)dylib_lookup(dylib, "unique_mappings", false);
+	if (no_handlers == nullptr || handlers == nullptr
+		|| 2 * (size_t(*no_handlers) + 1) != exec.translator_mappings()
+		|| exec.patched_decoder_cache() != nullptr
+		|| !initialize_translated_segment(exec, dylib, offsets, false))
+	{
+		dylib_close(dylib, false);
+		return false;
 	}
-	const int32_t arena_offset = uintptr_t(&machine.memory.memory_arena_ptr_ref()) - uintptr_t(&machine);
-#ifdef RISCV_VIRTUAL_PAGING
-	const int32_t rdcache_offset = uintptr_t(&machine.memory.rdcache()) - uintptr_t(&machine);
+	exec.set_tiered_translation(dylib);
+
+	// The second set of mappings is not referenced by any decoder entry yet
+	const unsigned optimized = *no_handlers + 1;
+	for (unsigned i = 0; i < *no_handlers; i++) {
+		if (handlers[i] != nullptr)
+			exec.set_mapping(optimized + i, handlers[i]);
+	}
+
+	// Build a patched decoder cache where every translation refers to the
+	// optimized handlers, and live-patch the current one to switch over to it.
+	// The libtcc code remains loaded, as it may still be executing, until the
+	// segment is destroyed.
+#ifdef __cpp_lib_smart_ptr_for_overwrite // C++20 feature
+	auto patched_decoder_cache = std::make_unique_for_overwrite<DecoderData<W>[]>(exec.decoder_cache_size());
 #else
-	const int32_t rdcache_offset = 0;
+	auto patched_decoder_cache = std::make_unique<DecoderData<W>[]>(exec.decoder_cache_size());
 #endif
+	std::memcpy(patched_decoder_cache.get(), exec.decoder_cache_base(), exec.decoder_cache_size() * sizeof(DecoderData<W>));
+	std::vector<DecoderData<W>*> livepatch_bintr;
+	for (size_t i = 0; i < exec.decoder_cache_size(); i++) {
+		auto& entry = patched_decoder_cache[i];
+		if (entry.get_bytecode() == RV32I_BC_TRANSLATOR && entry.instr < optimized) {
+			entry.instr += optimized;
+			livepatch_bintr.push_back(&exec.decoder_cache_base()[i]);
+		}
+	}
+	auto* patched_decoder = patched_decoder_cache.get() - exec.exec_begin() / DecoderData<W>::DIVISOR;
+	exec.set_patched_decoder_cache(std::move(patched_decoder_cache), patched_decoder);
+	exec.set_decoder(patched_decoder);
 
-	func(create_bintr_callback_table<W>(exec), arena_offset, ins_counter_offset, rdcache_offset);
-
+	// Memory fence to ensure that the patched decoder is visible to all threads
+#ifndef __COSMOCC__
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+#endif
+	for (auto* dd : livepatch_bintr) {
+		dd->set_atomic_bytecode_and_handler(RV32I_BC_LIVEPATCH, 0);
+	}
 	return true;
 }
 
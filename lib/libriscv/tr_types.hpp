@@ -14,6 +14,8 @@ namespace riscv
 		std::unordered_map<std::string, std::string> defines;
 		timespec t0;
 		std::shared_ptr<std::string> code;
+		// Where each emitted block begins in code, after the shared header
+		std::vector<size_t> block_offsets;
 		std::string footer;
 		std::vector<TransMapping<W>> mappings;
 	};
@@ -34,8 +36,10 @@ namespace riscv
 		bool use_register_caching;
 		bool use_syscall_clobbering_optimization;
 		bool use_automatic_nbit_address_space;
+		bool use_guard_paged_arena;
 		bool use_virtual_paging_fallback;
 		bool unsafe_remove_checks;
+		bool track_dirty_pages;
 		std::unordered_set<address_type<W>> jump_locations;
 		std::unordered_map<address_type<W>, address_type<W>> single_return_locations;
 		// Pointer to all the other blocks (including current)
@@ -49,4 +53,8 @@ namespace riscv
 		address_type<W> arena_roend;
 		address_type<W> arena_size;
 	};
+
+	// Expands a compressed instruction into its 32-bit form, when one exists
+	template <int W>
+	rv32i_instruction rvc_expand(rv32i_instruction instr);
 }
@@ -96,6 +96,14 @@ namespace riscv
 	template <int W>
 	struct TransOutput;
 
+	// Offsets into a machine that translated code uses,
+	// which are the same for every machine of the same width
+	struct TransOffsets {
+		int32_t arena_offset;
+		int32_t ins_counter_offset;
+		int32_t rdcache_offset;
+	};
+
 	template <int W>
 	struct TransMapping {
 		address_type<W> addr;
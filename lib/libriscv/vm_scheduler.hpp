@@ -0,0 +1,332 @@
+#pragma once
+#include "machine.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace riscv
+{
+	/**
+	 * A VM scheduler runs many machines on a pool of host threads.
+	 *
+	 * Machines are time-sliced by instruction quanta: Each slice resumes
+	 * a machine for at most `quantum` instructions, after which it is put
+	 * back into the queue of the thread that ran it. Every thread has its
+	 * own queue, and a thread that runs out of work steals from the others.
+	 * A machine is only ever run by one thread at a time, but it may move
+	 * between threads from one slice to the next.
+	 *
+	 * 1. Initialization:
+	 * riscv::VMScheduler<RISCV64> scheduler({ .quantum = 500'000 },
+	 * 	[] (auto& task) { ... task.machine.return_value() ... });
+	 *
+	 * 2. Submit machines (that are ready to simulate):
+	 * auto task = scheduler.submit(machine, priority, deadline);
+	 *
+	 * 3. Wait for all machines to complete:
+	 * scheduler.wait();
+	 *
+	 * Higher priorities always run first. Among equal priorities the
+	 * earliest deadline runs first, and otherwise machines take turns.
+	 * A machine that is still running when its deadline passes is not
+	 * resumed again, and completes with Status::DeadlineExceeded.
+	 *
+	 * Machines that stop on a pending asynchronous system call (see
+	 * FileDescriptors::async_syscalls) complete with Status::Waiting.
+	 * The embedder waits for the pending FDs, and then submits the
+	 * machine again.
+	 *
+	 * Submitted machines must not be used by anyone else until they have
+	 * completed. The completion callback is called from a scheduler thread.
+	 * Destroying the scheduler finishes the slices that are running, and
+	 * leaves everything else in the queues with Status::Queued.
+	**/
+	template <int W>
+	struct VMScheduler
+	{
+		using clock = std::chrono::steady_clock;
+
+		enum class Status {
+			Queued,
+			Finished,          // The machine stopped normally
+			Waiting,           // The machine stopped on a pending system call
+			OutOfInstructions, // The instruction budget was used up
+			DeadlineExceeded,
+			Failed,            // The machine threw an exception
+		};
+
+		struct Task {
+			Task(Machine<W>& m, int prio, clock::time_point dl, uint64_t max, void* user)
+				: machine(m), priority(prio), deadline(dl), max_instructions(max), userdata(user) {}
+
+			Machine<W>& machine;
+			const int priority;
+			const clock::time_point deadline;
+			const uint64_t max_instructions;
+			void* const userdata;
+
+			// The result, valid once the task has completed
+			Status status = Status::Queued;
+			std::exception_ptr exception = nullptr;
+
+			// CPU accounting: The instructions executed and the host time
+			// spent running this machine, over how many time slices
+			uint64_t instructions = 0;
+			uint64_t slices = 0;
+			std::chrono::nanoseconds cpu_time {0};
+
+		private:
+			uint64_t sequence = 0;
+			friend struct VMScheduler;
+		};
+		using completion_t = std::function<void(Task&)>;
+
+		struct Options {
+			// Host threads, or 0 for one per hardware thread
+			unsigned threads = 0;
+			// Instructions per time slice
+			uint64_t quantum = 1'000'000;
+		};
+
+		VMScheduler(Options options = {}, completion_t on_completion = nullptr);
+		~VMScheduler();
+
+		/// @brief Queue a machine for execution, starting from its current PC.
+		/// @param machine The machine to run.
+		/// @param priority Higher priorities are always scheduled first.
+		/// @param deadline The machine is not resumed after this point in time.
+		/// @param max_instructions The instruction budget across all slices.
+		/// @param userdata Passed on to the completion callback through the task.
+		/// @return The task, which holds the result once the machine has completed.
+		std::shared_ptr<Task> submit(Machine<W>& machine, int priority = 0,
+			clock::time_point deadline = clock::time_point::max(),
+			uint64_t max_instructions = UINT64_MAX, void* userdata = nullptr);
+
+		/// @brief Block until every submitted machine has completed.
+		void wait();
+
+		unsigned threads() const noexcept { return m_workers.size(); }
+		uint64_t quantum() const noexcept { return m_quantum; }
+		/// @brief The number of times a thread took a machine from another
+		/// thread's queue.
+		uint64_t steals() const noexcept { return m_steals.load(std::memory_order_relaxed); }
+
+	private:
+		struct Later {
+			bool operator() (const std::shared_ptr<Task>& a, const std::shared_ptr<Task>& b) const noexcept {
+				if (a->priority != b->priority) return a->priority < b->priority;
+				if (a->deadline != b->deadline) return a->deadline > b->deadline;
+				return a->sequence > b->sequence;
+			}
+		};
+		struct Queue {
+			std::mutex mtx;
+			std::priority_queue<std::shared_ptr<Task>, std::vector<std::shared_ptr<Task>>, Later> tasks;
+		};
+
+		void push(unsigned id, std::shared_ptr<Task> task);
+		std::shared_ptr<Task> pop(unsigned id);
+		bool run_slice(Task& task);
+		void complete(Task& task, Status status);
+		void worker(unsigned id);
+
+		const uint64_t m_quantum;
+		completion_t m_on_completion;
+		std::vector<std::unique_ptr<Queue>> m_queues;
+		std::vector<std::thread> m_workers;
+
+		std::mutex m_mtx;
+		std::condition_variable m_work_cond;
+		std::condition_variable m_idle_cond;
+		size_t m_queued = 0;    // Machines in the queues
+		size_t m_in_flight = 0; // Machines submitted and not yet completed
+		bool m_stop = false;
+
+		std::atomic<uint64_t> m_sequence = 0;
+		std::atomic<unsigned> m_next_queue = 0;
+		std::atomic<uint64_t> m_steals = 0;
+	};
+
+	template <int W>
+	inline VMScheduler<W>::VMScheduler(Options options, completion_t on_completion)
+		: m_quantum(options.quantum > 0 ? options.quantum : 1),
+		  m_on_completion(std::move(on_completion))
+	{
+		unsigned threads = options.threads;
+		if (threads == 0)
+			threads = std::max(1u, std::thread::hardware_concurrency());
+
+		for (unsigned i = 0; i < threads; i++)
+			m_queues.push_back(std::make_unique<Queue>());
+		for (unsigned i = 0; i < threads; i++)
+			m_workers.emplace_back(&VMScheduler::worker, this, i);
+	}
+
+	template <int W>
+	inline VMScheduler<W>::~VMScheduler()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mtx);
+			m_stop = true;
+		}
+		m_work_cond.notify_all();
+		for (auto& thread : m_workers)
+			thread.join();
+	}
+
+	template <int W>
+	inline std::shared_ptr<typename VMScheduler<W>::Task>
+	VMScheduler<W>::submit(Machine<W>& machine, int priority,
+		clock::time_point deadline, uint64_t max_instructions, void* userdata)
+	{
+		auto task = std::make_shared<Task>(machine, priority, deadline, max_instructions, userdata);
+		{
+			std::lock_guard<std::mutex> lock(m_mtx);
+			m_in_flight++;
+		}
+		const unsigned id = m_next_queue.fetch_add(1, std::memory_order_relaxed) % m_queues.size();
+		this->push(id, task);
+		return task;
+	}
+
+	template <int W>
+	inline void VMScheduler<W>::wait()
+	{
+		std::unique_lock<std::mutex> lock(m_mtx);
+		m_idle_cond.wait(lock, [this] { return m_in_flight == 0; });
+	}
+
+	template <int W>
+	inline void VMScheduler<W>::push(unsigned id, std::shared_ptr<Task> task)
+	{
+		task->status = Status::Queued;
+		task->sequence = m_sequence.fetch_add(1, std::memory_order_relaxed);
+		// Count the machine before it becomes visible, so that a worker
+		// popping it right away never decrements the count below zero
+		{
+			std::lock_guard<std::mutex> lock(m_mtx);
+			m_queued++;
+		}
+		{
+			std::lock_guard<std::mutex> lock(m_queues[id]->mtx);
+			m_queues[id]->tasks.push(std::move(task));
+		}
+		m_work_cond.notify_one();
+	}
+
+	template <int W>
+	inline std::shared_ptr<typename VMScheduler<W>::Task> VMScheduler<W>::pop(unsigned id)
+	{
+		std::shared_ptr<Task> task;
+		while (!task) {
+			// Our own queue first, unless another queue has a machine with
+			// a higher priority. With an empty queue we steal from the others.
+			unsigned victim = m_queues.size();
+			int priority = 0;
+			for (unsigned i = 0; i < m_queues.size(); i++) {
+				const unsigned q = (id + i) % m_queues.size();
+				std::lock_guard<std::mutex> lock(m_queues[q]->mtx);
+				auto& tasks = m_queues[q]->tasks;
+				if (!tasks.empty() && (victim == m_queues.size() || tasks.top()->priority > priority)) {
+					victim = q;
+					priority = tasks.top()->priority;
+				}
+			}
+			if (victim == m_queues.size())
+				return nullptr;
+
+			std::lock_guard<std::mutex> lock(m_queues[victim]->mtx);
+			auto& tasks = m_queues[victim]->tasks;
+			if (!tasks.empty()) {
+				task = tasks.top();
+				tasks.pop();
+				if (victim != id)
+					m_steals.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+		{
+			std::lock_guard<std::mutex> lock(m_mtx);
+			m_queued--;
+		}
+		return task;
+	}
+
+	template <int W>
+	inline bool VMScheduler<W>::run_slice(Task& task)
+	{
+		auto& machine = task.machine;
+		const auto t0 = clock::now();
+		if (t0 >= task.deadline) {
+			complete(task, Status::DeadlineExceeded);
+			return false;
+		}
+		const uint64_t slice = std::min(m_quantum, task.max_instructions - task.instructions);
+		const uint64_t counter = machine.instruction_counter();
+		Status status;
+		try {
+			if (machine.template resume<false>(slice)) {
+				if (machine.has_file_descriptors() && machine.fds().has_pending_wait())
+					status = Status::Waiting;
+				else
+					status = Status::Finished;
+			} else {
+				status = Status::Queued;
+			}
+		} catch (...) {
+			task.exception = std::current_exception();
+			status = Status::Failed;
+		}
+		task.instructions += machine.instruction_counter() - counter;
+		task.slices++;
+		task.cpu_time += clock::now() - t0;
+
+		if (status == Status::Queued) {
+			if (task.instructions < task.max_instructions)
+				return true;
+			status = Status::OutOfInstructions;
+		}
+		complete(task, status);
+		return false;
+	}
+
+	template <int W>
+	inline void VMScheduler<W>::complete(Task& task, Status status)
+	{
+		task.status = status;
+		if (m_on_completion)
+			m_on_completion(task);
+		{
+			std::lock_guard<std::mutex> lock(m_mtx);
+			m_in_flight--;
+		}
+		m_idle_cond.notify_all();
+	}
+
+	template <int W>
+	inline void VMScheduler<W>::worker(unsigned id)
+	{
+		while (true)
+		{
+			{
+				std::unique_lock<std::mutex> lock(m_mtx);
+				m_work_cond.wait(lock, [this] { return m_stop || m_queued > 0; });
+				if (m_stop)
+					return;
+			}
+			if (auto task = this->pop(id)) {
+				// Preempted machines go back into our own queue
+				if (this->run_slice(*task))
+					this->push(id, std::move(task));
+			}
+		}
+	}
+
+} // riscv
@@ -149,17 +149,8 @@ static void syscall_read(Machine<W> &machine) {
 	SYSPRINT("SYSCALL read, addr: 0x%lX, len: %zu\n", (long) address, len);
 	// We have special stdin handling
 	if (fd == 0) {
-		// Arbitrary maximum read length
-		if (len > 1024 * 1024 * 16) {
-			machine.set_result(-ENOMEM);
-			return;
-		}
-		auto buffer = std::unique_ptr<char[]>(new char[len]);
-		long result = machine.stdin_read(buffer.get(), len);
-		if (result > 0) {
-			machine.copy_to_guest(address, buffer.get(), result);
-		}
-		machine.set_result(result);
+		// Stdin is read directly into guest memory
+		machine.set_result(machine.stdin_read_into(address, len));
 		return;
 	} else if (machine.has_file_descriptors()) {
 		const auto real_fd = machine.fds().get(fd);
@@ -200,11 +191,9 @@ static void syscall_write(Machine<W> &machine) {
 	if (vfd == 1 || vfd == 2) {
 		// Zero-copy retrieval of buffers (16 fragments)
 		riscv::vBuffer buffers[16];
-		size_t cnt =
+		const size_t cnt =
 				machine.memory.gather_buffers_from_range(16, buffers, address, len);
-		for (size_t i = 0; i < cnt; i++) {
-			machine.print(buffers[i].ptr, buffers[i].len);
-		}
+		machine.printv(buffers, cnt);
 		machine.set_result(len);
 		return;
 	} else if (machine.has_file_descriptors() && machine.fds().permit_write(vfd)) {
@@ -267,11 +256,9 @@ static void syscall_writev(Machine<W> &machine) {
 			auto len_g = (size_t) iov.iov_len;
 			/* Zero-copy retrieval of buffers */
 			riscv::vBuffer buffers[4];
-			size_t cnt =
+			const size_t cnt =
 					machine.memory.gather_buffers_from_range(4, buffers, src_g, len_g);
-			for (size_t i = 0; i < cnt; i++) {
-				machine.print(buffers[i].ptr, buffers[i].len);
-			}
+			machine.printv(buffers, cnt);
 			res += len_g;
 		}
 		machine.set_result(res);
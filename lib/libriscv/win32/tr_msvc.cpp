@@ -1,6 +1,7 @@
 #include "../common.hpp"
 
 #include <cstring>
+#include <vector>
 #include "dlfcn.h"
 
 namespace riscv
@@ -15,6 +16,39 @@ namespace riscv
 		return nullptr;
 	}
 
+	void* compile_units(const std::vector<std::string>& units, int arch, const std::string& cflags, const std::string& outfile)
+	{
+		(void)units;
+		(void)arch;
+		(void)cflags;
+		(void)outfile;
+
+		return nullptr;
+	}
+
+	std::string compile_command(int arch, const std::string& cflags)
+	{
+		(void)arch;
+
+		return cflags;
+	}
+
+	int translation_cache_lock(const std::string&)
+	{
+		return -1;
+	}
+	void translation_cache_unlock(int)
+	{
+	}
+	void translation_cache_touch(const std::string&)
+	{
+	}
+	std::pair<uint64_t, uint64_t> translation_cache_evict(const std::string&,
+		const std::string&, uint64_t, const std::string&)
+	{
+		return {0, 0};
+	}
+
 	bool
 	mingw_compile(const std::string& code, int arch, const std::string& cflags,
 		const std::string& outfile, const MachineTranslationCrossOptions& cross_options)
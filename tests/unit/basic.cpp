@@ -2,6 +2,9 @@
 #include <catch2/matchers/catch_matchers_string.hpp>
 
 #include <libriscv/machine.hpp>
+#include <libriscv/decoder_cache.hpp>
+#include <filesystem>
+#include <thread>
 extern std::vector<uint8_t> build_and_load(const std::string& code,
 	const std::string& args = "-O2 -static", bool cpp = false);
 static const uint64_t MAX_MEMORY = 8ul << 20; /* 8MB */
@@ -151,6 +154,98 @@ TEST_CASE("Catch output from write system call", "[Output]")
 	REQUIRE(state.output_is_hello_world);
 }
 
+TEST_CASE("Stream stdin to stdout with scatter-gather callbacks", "[Output]")
+{
+	struct State {
+		std::string input;
+		size_t pos = 0;
+		std::string output;
+		size_t calls = 0;
+	} state;
+	for (int i = 0; i < 300000; i++)
+		state.input.push_back('a' + i % 26);
+
+	const auto binary = build_and_load(R"M(
+	extern long read(int, void*, unsigned long);
+	extern long write(int, const void*, unsigned long);
+	static char buffer[64 * 1024];
+	int main() {
+		long total = 0;
+		long len;
+		while ((len = read(0, buffer, sizeof(buffer))) > 0) {
+			write(1, buffer, len);
+			total += len;
+		}
+		return total == 300000 ? 666 : 1;
+	})M");
+
+	riscv::Machine<RISCV64> machine { binary, { .memory_max = MAX_MEMORY } };
+	machine.setup_linux_syscalls(false, false);
+	machine.setup_linux(
+		{"basic"},
+		{"LC_TYPE=C", "LC_ALL=C", "USER=root"});
+
+	machine.set_userdata(&state);
+	// The buffers point directly into guest memory
+	machine.set_stdin_readv([] (const auto& m, const riscv::vBuffer* buffers, size_t cnt) -> long {
+		auto* state = m.template get_userdata<State> ();
+		state->calls++;
+		long total = 0;
+		for (size_t i = 0; i < cnt; i++) {
+			const size_t len = std::min(buffers[i].len, state->input.size() - state->pos);
+			std::memcpy(buffers[i].ptr, &state->input[state->pos], len);
+			state->pos += len;
+			total += len;
+		}
+		return total;
+	});
+	machine.set_printv([] (const auto& m, const riscv::vBuffer* buffers, size_t cnt) {
+		auto* state = m.template get_userdata<State> ();
+		state->calls++;
+		for (size_t i = 0; i < cnt; i++)
+			state->output.append(buffers[i].ptr, buffers[i].len);
+	});
+	// The regular printer is not used when there is a scatter-gather printer
+	machine.set_printer([] (const auto&, const char*, size_t) {
+		REQUIRE(false);
+	});
+	machine.simulate(MAX_INSTRUCTIONS);
+
+	REQUIRE(machine.return_value<int>() == 666);
+	REQUIRE(state.output == state.input);
+	// One call per read and write: Five reads of data, one at EOF and five writes
+	REQUIRE(state.calls == 5 + 1 + 5);
+
+	// A read near the end of the arena is a short read
+	state.input = std::string(4096, 'x');
+	state.pos = 0;
+	const auto arena_end = machine.memory.memory_arena_size();
+	REQUIRE(machine.stdin_read_into(arena_end - 100, 4096) == 100);
+	REQUIRE(machine.memory.read<uint8_t>(arena_end - 1) == 'x');
+
+	// Without scatter-gather stdin, the regular stdin reads into each buffer
+	riscv::Machine<RISCV64> fallback { binary, { .memory_max = MAX_MEMORY } };
+	fallback.setup_linux_syscalls(false, false);
+	fallback.setup_linux({"basic"}, {"LC_TYPE=C", "LC_ALL=C", "USER=root"});
+	state.pos = 0;
+	state.output.clear();
+	fallback.set_userdata(&state);
+	fallback.set_stdin([] (const auto& m, char* data, size_t size) -> long {
+		auto* state = m.template get_userdata<State> ();
+		const size_t len = std::min(size, state->input.size() - state->pos);
+		std::memcpy(data, &state->input[state->pos], len);
+		state->pos += len;
+		return len;
+	});
+	fallback.set_printer([] (const auto& m, const char* data, size_t size) {
+		m.template get_userdata<State> ()->output.append(data, size);
+	});
+	fallback.simulate(MAX_INSTRUCTIONS);
+
+	REQUIRE(fallback.return_value<int>() == 666);
+	REQUIRE(state.output == state.input);
+}
+
 TEST_CASE("Calculate fib(50)", "[Compute]")
 {
 	const auto binary = build_and_load(R"M(
@@ -227,3 +322,669 @@ TEST_CASE("Count using EBREAK", "[Compute]")
 	else
 		REQUIRE(machine.return_value<long>() == 46368L);
 }
+
+TEST_CASE("Compact decoder cache decodes pages on demand", "[Compute]")
+{
+	const auto binary = build_and_load(R"M(
+	#include <stdlib.h>
+	long fib(long n, long acc, long prev)
+	{
+		if (n < 1)
+			return acc;
+		else
+			return fib(n - 1, prev + acc, acc);
+	}
+	int main(int argc, char** argv) {
+		const long n = atoi(argv[1]);
+		return fib(n, 0, 1);
+	})M");
+
+	auto run = [&] (bool compact) {
+		riscv::MachineOptions<RISCV64> options {
+			.memory_max = MAX_MEMORY,
+			.use_shared_execute_segments = false,
+			.compact_decoder_cache = compact,
+		};
+#ifdef RISCV_BINARY_TRANSLATION
+		options.translate_enabled = false;
+#endif
+		riscv::Machine<RISCV64> machine { binary, options };
+		machine.setup_linux_syscalls(false, false);
+		machine.setup_linux(
+			{"basic", "50"},
+			{"LC_TYPE=C", "LC_ALL=C", "USER=root"});
+		machine.simulate(MAX_INSTRUCTIONS);
+
+		REQUIRE(machine.return_value<long>() == -298632863);
+		const auto& exec = machine.cpu.current_execute_segment();
+		REQUIRE(exec.is_compact() == compact);
+		return std::make_pair(machine.instruction_counter(), exec.decoded_pages());
+	};
+	const auto [eager_icount, eager_pages] = run(false);
+	const auto [compact_icount, compact_pages] = run(true);
+
+	// Blocks are split at page boundaries, but each instruction is counted once
+	REQUIRE(compact_icount == eager_icount);
+	// Only the pages that were executed got decoded
+	REQUIRE(compact_pages > 0);
+	REQUIRE(compact_pages < eager_pages);
+}
+
+TEST_CASE("Large execute segments are decoded on demand", "[Compute]")
+{
+	const auto binary = build_and_load(R"M(
+	int main() {
+		return 666;
+	})M");
+
+	riscv::MachineOptions<RISCV64> options {
+		.memory_max = MAX_MEMORY,
+		.use_shared_execute_segments = false,
+		.compact_decoder_cache_threshold = 1, // Every segment is large
+	};
+#ifdef RISCV_BINARY_TRANSLATION
+	options.translate_enabled = false;
+	options.translate_enable_embedded = false;
+#endif
+	riscv::Machine<RISCV64> machine { binary, options };
+	// Nothing is decoded before the first instruction
+	REQUIRE(machine.cpu.current_execute_segment().decoded_pages() == 0);
+
+	machine.setup_linux_syscalls(false, false);
+	machine.setup_linux(
+		{"basic"},
+		{"LC_TYPE=C", "LC_ALL=C", "USER=root"});
+	machine.simulate(MAX_INSTRUCTIONS);
+
+	REQUIRE(machine.return_value<int>() == 666);
+	REQUIRE(machine.cpu.current_execute_segment().decoded_pages() > 0);
+
+#ifdef RISCV_BINARY_TRANSLATION
+	// Segments that get translated are still decoded up front
+	options.translate_enabled = true;
+	riscv::Machine<RISCV64> translated { binary, options };
+	const auto& exec = translated.cpu.current_execute_segment();
+	if (exec.is_binary_translated()) {
+		options.compact_decoder_cache_threshold = 0;
+		riscv::Machine<RISCV64> eager { binary, options };
+		REQUIRE(exec.decoded_pages() == eager.cpu.current_execute_segment().decoded_pages());
+	}
+#endif
+}
+
+TEST_CASE("Decoding on many threads produces the same decoder cache", "[Compute]")
+{
+	const auto binary = build_and_load(R"M(
+	int main() {
+		return 666;
+	})M");
+
+	riscv::MachineOptions<RISCV64> options {
+		.memory_max = MAX_MEMORY,
+		.use_shared_execute_segments = false,
+		.compact_decoder_cache_threshold = 0,
+		.decoder_cache_threads = 1,
+	};
+#ifdef RISCV_BINARY_TRANSLATION
+	options.translate_enabled = false;
+#endif
+	riscv::Machine<RISCV64> serial { binary, options };
+	options.decoder_cache_threads = 7;
+	riscv::Machine<RISCV64> threaded { binary, options };
+
+	const auto& exec1 = serial.cpu.current_execute_segment();
+	const auto& exec2 = threaded.cpu.current_execute_segment();
+	REQUIRE(exec1.exec_begin() == exec2.exec_begin());
+	REQUIRE(exec1.exec_end() == exec2.exec_end());
+	static constexpr unsigned DIVISOR = DecoderData<RISCV64>::DIVISOR;
+	size_t mismatches = 0;
+	for (uint64_t pc = exec1.exec_begin(); pc <= exec1.exec_end(); pc += DIVISOR) {
+		const auto& entry1 = exec1.decoder_cache()[pc / DIVISOR];
+		const auto& entry2 = exec2.decoder_cache()[pc / DIVISOR];
+		if (entry1.get_bytecode() != entry2.get_bytecode()
+			|| entry1.block_bytes() != entry2.block_bytes()
+			|| entry1.instruction_count() != entry2.instruction_count())
+			mismatches++;
+	}
+	REQUIRE(mismatches == 0);
+
+	threaded.setup_linux_syscalls(false, false);
+	threaded.setup_linux(
+		{"basic"},
+		{"LC_TYPE=C", "LC_ALL=C", "USER=root"});
+	threaded.simulate(MAX_INSTRUCTIONS);
+
+	REQUIRE(threaded.return_value<int>() == 666);
+}
+
+#ifdef __linux__
+TEST_CASE("Decoder caches are mapped from files", "[Compute]")
+{
+	const auto binary = build_and_load(R"M(
+	int main() {
+		return 666;
+	})M");
+	char dir[] = "/tmp/libriscv-decoder-XXXXXX";
+	REQUIRE(mkdtemp(dir) != nullptr);
+
+	auto run = [&] {
+		riscv::MachineOptions<RISCV64> options {
+			.memory_max = MAX_MEMORY,
+			.use_shared_execute_segments = false,
+			.decoder_cache_prefix = std::string(dir) + "/decoder-",
+		};
+#ifdef RISCV_BINARY_TRANSLATION
+		options.translate_enabled = false;
+		options.translate_enable_embedded = false;
+#endif
+		riscv::Machine<RISCV64> machine { binary, options };
+		machine.setup_linux_syscalls(false, false);
+		machine.setup_linux(
+			{"basic"},
+			{"LC_TYPE=C", "LC_ALL=C", "USER=root"});
+		machine.simulate(MAX_INSTRUCTIONS);
+
+		REQUIRE(machine.return_value<int>() == 666);
+		const auto& exec = machine.cpu.current_execute_segment();
+		return std::make_pair(exec.is_decoder_cache_mapped(), machine.instruction_counter());
+	};
+	// The first machine decodes and stores the decoder cache
+	const auto [stored_mapped, stored_icount] = run();
+	// The second machine maps it instead of decoding
+	const auto [mapped, icount] = run();
+	std::filesystem::remove_all(dir);
+
+	REQUIRE(!stored_mapped);
+	REQUIRE(mapped);
+	REQUIRE(icount == stored_icount);
+}
+#endif
+
+#ifdef RISCV_BINARY_TRANSLATION
+#ifdef RISCV_BLOCK_PROFILE
+TEST_CASE("Profile-guided binary translation", "[Compute]")
+{
+	const auto binary = build_and_load(R"M(
+	__attribute__((noinline, used))
+	int hot_loop(int n) {
+		int sum = 0;
+		for (int i = 0; i < n; i++)
+			sum += i ^ (sum >> 3);
+		return sum;
+	}
+	int main() {
+		return hot_loop(10000) & 0xFF;
+	})M");
+
+	// Record a block profile using the interpreter
+	riscv::Machine<RISCV64> profiling { binary, {
+		.memory_max = MAX_MEMORY,
+		.translate_enabled = false,
+		.record_block_profile = true,
+	} };
+	profiling.setup_linux_syscalls();
+	profiling.setup_linux({"profile"}, {"LC_TYPE=C", "LC_ALL=C", "USER=root"});
+	profiling.simulate(MAX_INSTRUCTIONS);
+	const int expected = profiling.return_value<int>();
+
+	const auto profile = profiling.memory.gather_block_profile();
+	REQUIRE(!profile.empty());
+	for (size_t i = 1; i < profile.size(); i++)
+		REQUIRE(profile[i-1].second >= profile[i].second);
+	// The loop was entered once per iteration
+	const auto hot_loop = profiling.address_of("hot_loop");
+	bool found_loop = false;
+	for (const auto& [addr, count] : profile) {
+		if (addr >= hot_loop && addr < hot_loop + 0x100 && count >= 9999)
+			found_loop = true;
+	}
+	REQUIRE(found_loop);
+
+	// Translate only the blocks that were executed
+	riscv::Machine<RISCV64> machine { binary, {
+		.memory_max = MAX_MEMORY,
+		.translator_block_profile = profile,
+	} };
+	machine.setup_linux_syscalls();
+	machine.setup_linux({"profile"}, {"LC_TYPE=C", "LC_ALL=C", "USER=root"});
+	machine.simulate(MAX_INSTRUCTIONS);
+	REQUIRE(machine.return_value<int>() == expected);
+}
+#endif
+
+TEST_CASE("Binary translation split into translation units", "[Compute]")
+{
+	const auto binary = build_and_load(R"M(
+	__attribute__((noinline, used))
+	int hot_loop(int n) {
+		int sum = 0;
+		for (int i = 0; i < n; i++)
+			sum += i ^ (sum >> 3);
+		return sum;
+	}
+	int main() {
+		return hot_loop(10000) & 0xFF;
+	})M");
+
+	riscv::Machine<RISCV64> interpreted { binary, {
+		.memory_max = MAX_MEMORY,
+		.translate_enabled = false,
+	} };
+	interpreted.setup_linux_syscalls();
+	interpreted.setup_linux({"units"}, {"LC_TYPE=C", "LC_ALL=C", "USER=root"});
+	interpreted.simulate(MAX_INSTRUCTIONS);
+
+	// Block functions call each other across units
+	riscv::Machine<RISCV64> machine { binary, {
+		.memory_max = MAX_MEMORY,
+		.translation_cache = false,
+		.translate_compile_units = 4,
+	} };
+	REQUIRE(machine.cpu.current_execute_segment().is_binary_translated());
+	machine.setup_linux_syscalls();
+	machine.setup_linux({"units"}, {"LC_TYPE=C", "LC_ALL=C", "USER=root"});
+	machine.simulate(MAX_INSTRUCTIONS);
+	REQUIRE(machine.return_value<int>() == interpreted.return_value<int>());
+}
+
+#ifndef RISCV_LIBTCC
+TEST_CASE("Translation cache hits and misses", "[Compute]")
+{
+	const auto binary = build_and_load(R"M(
+	int main() {
+		return 666;
+	})M");
+	const riscv::MachineOptions<RISCV64> options {
+		.memory_max = MAX_MEMORY,
+		.use_shared_execute_segments = false, // Each machine loads its translation
+		.translation_prefix = "/tmp/rvbintr-cachetest-",
+	};
+
+	riscv::reset_translation_cache_stats();
+	riscv::Machine<RISCV64> first { binary, options };
+	REQUIRE(first.cpu.current_execute_segment().is_binary_translated());
+	const auto stats1 = riscv::translation_cache_stats();
+	// A previous run may have left the translation in the cache
+	REQUIRE(stats1.hits + stats1.misses == 1);
+
+	riscv::Machine<RISCV64> second { binary, options };
+	const auto stats2 = riscv::translation_cache_stats();
+	REQUIRE(stats2.hits == stats1.hits + 1);
+	REQUIRE(stats2.misses == stats1.misses);
+
+	second.setup_linux_syscalls();
+	second.setup_linux({"cache"}, {"LC_TYPE=C", "LC_ALL=C", "USER=root"});
+	second.simulate(MAX_INSTRUCTIONS);
+	REQUIRE(second.return_value<int>() == 666);
+}
+
+TEST_CASE("Translation cache evicts the least recently used files", "[Compute]")
+{
+	namespace fs = std::filesystem;
+	const auto binary = build_and_load(R"M(
+	int main() {
+		return 666;
+	})M");
+	const fs::path directory = "/tmp/rvbintr-evicttest";
+	fs::remove_all(directory);
+	fs::create_directories(directory);
+
+	// Stale translations, their lock files and an unrelated file
+	auto create = [&] (const std::string& name, size_t size, int age) {
+		const fs::path path = directory / name;
+		std::vector<char> data(size, 'x');
+		FILE* f = fopen(path.c_str(), "wb");
+		REQUIRE(f != nullptr);
+		fwrite(data.data(), 1, data.size(), f);
+		fclose(f);
+		fs::last_write_time(path, fs::file_time_type::clock::now() - std::chrono::hours(age));
+		return path;
+	};
+	const auto oldest = create("cache-0000000A.so", 4000, 3);
+	const auto older  = create("cache-0000000B.so", 3000, 2);
+	const auto recent = create("cache-0000000C.so", 2000, 1);
+	const auto lock   = create("cache-0000000A.so.lock", 0, 3);
+	const auto other  = create("other-0000000D.so", 8000, 4);
+
+	// Compile the translation once outside of the cache to learn its size
+	uint64_t translation_size = 0;
+	{
+		riscv::Machine<RISCV64> probe { binary, {
+			.memory_max = MAX_MEMORY,
+			.use_shared_execute_segments = false,
+			.translation_prefix = (directory / "probe-").string(),
+			.translation_suffix = ".so",
+		} };
+		for (auto& entry : fs::directory_iterator(directory)) {
+			if (entry.path().filename().string().starts_with("probe-")
+				&& entry.path().extension() == ".so")
+				translation_size = entry.file_size();
+		}
+		REQUIRE(translation_size != 0);
+	}
+
+	riscv::reset_translation_cache_stats();
+	riscv::Machine<RISCV64> machine { binary, {
+		.memory_max = MAX_MEMORY,
+		.use_shared_execute_segments = false,
+		.translation_cache_max_bytes = fs::file_size(recent) + translation_size,
+		.translation_prefix = (directory / "cache-").string(),
+		.translation_suffix = ".so",
+	} };
+	REQUIRE(machine.cpu.current_execute_segment().is_binary_translated());
+
+	// The new translation is kept, and the oldest files make room for it
+	const auto stats = riscv::translation_cache_stats();
+	REQUIRE(stats.misses == 1);
+	REQUIRE(!fs::exists(oldest));
+	REQUIRE(!fs::exists(older));
+	REQUIRE(fs::exists(recent));
+	REQUIRE(stats.evicted_files == 2);
+	REQUIRE(stats.evicted_bytes == 7000);
+	// Lock files may be in use by other processes
+	REQUIRE(fs::exists(lock));
+	// Files with another prefix are not part of the cache
+	REQUIRE(fs::exists(other));
+
+	machine.setup_linux_syscalls();
+	machine.setup_linux({"evict"}, {"LC_TYPE=C", "LC_ALL=C", "USER=root"});
+	machine.simulate(MAX_INSTRUCTIONS);
+	REQUIRE(machine.return_value<int>() == 666);
+	fs::remove_all(directory);
+}
+#endif
+#endif
+
+#if defined(RISCV_BINARY_TRANSLATION) && defined(RISCV_LIBTCC)
+TEST_CASE("Tiered binary translation", "[Compute]")
+{
+	const auto binary = build_and_load(R"M(
+	__attribute__((noinline, used))
+	int hot_loop(int n) {
+		int sum = 0;
+		for (int i = 0; i < n; i++)
+			sum += i ^ (sum >> 3);
+		return sum;
+	}
+	int main() {
+		return hot_loop(10000) & 0xFF;
+	})M");
+
+	// The libtcc translation is active when the machine is created,
+	// while the optimizing compilation runs in the background
+	std::vector<std::thread> compilers;
+	riscv::Machine<RISCV64> machine { binary, {
+		.memory_max = MAX_MEMORY,
+		.translation_cache = false,
+		.translate_background_callback = [&] (auto& compilation_step) {
+			compilers.emplace_back(std::move(compilation_step));
+		},
+		.translate_tiered = true,
+	} };
+	REQUIRE(compilers.size() == 1);
+	machine.setup_linux_syscalls();
+	machine.setup_linux({"tiered"}, {"LC_TYPE=C", "LC_ALL=C", "USER=root"});
+	auto& exec = machine.cpu.current_execute_segment();
+	REQUIRE(exec.is_binary_translated());
+	REQUIRE(exec.is_libtcc());
+
+	// Execution may begin (and finish) before the swap
+	machine.simulate(MAX_INSTRUCTIONS);
+	const int expected = machine.return_value<int>();
+
+	for (auto& thread : compilers)
+		thread.join();
+	REQUIRE(exec.tiered_translation_so() != nullptr);
+
+	// Run again using the optimized translation
+	REQUIRE((machine.vmcall("hot_loop", 10000) & 0xFF) == expected);
+}
+#endif
+
+#if defined(RISCV_BINARY_TRANSLATION) && defined(RISCV_LIBTCC)
+TEST_CASE("Shared libtcc translations outlive machines", "[Compute]")
+{
+	const auto binary = build_and_load(R"M(
+	int main() {
+		return 666;
+	})M");
+	const riscv::MachineOptions<RISCV64> options {
+		.memory_max = MAX_MEMORY,
+		.use_shared_execute_segments = false,
+	};
+
+	void* translation = nullptr;
+	{
+		riscv::Machine<RISCV64> machine { binary, options };
+		REQUIRE(machine.cpu.current_execute_segment().is_binary_translated());
+		translation = machine.cpu.current_execute_segment().binary_translation_so();
+	}
+	// The execute segment is gone, but the translation is re-used
+	riscv::Machine<RISCV64> machine { binary, options };
+	REQUIRE(machine.cpu.current_execute_segment().binary_translation_so() == translation);
+
+	machine.setup_linux_syscalls();
+	machine.setup_linux({"shared"}, {"LC_TYPE=C", "LC_ALL=C", "USER=root"});
+	machine.simulate(MAX_INSTRUCTIONS);
+	REQUIRE(machine.return_value<int>() == 666);
+}
+#endif
+
+#if defined(RISCV_BINARY_TRANSLATION) && defined(__x86_64__) && !defined(_WIN32)
+TEST_CASE("Native x86-64 binary translation", "[Compute]")
+{
+	const auto binary = build_and_load(R"M(
+	static unsigned long table[64];
+	__attribute__((noinline, used))
+	long hot_loop(int n) {
+		long sum = 0;
+		for (int i = 0; i < n; i++) {
+			table[i & 63] += i * 3;
+			sum += (long)table[(i * 7) & 63] >> (i & 7);
+			if (sum < 0) sum = -sum;
+		}
+		return sum;
+	}
+	int main(int argc, char** argv) {
+		if (argc > 1) // Protection fault in translated code
+			*(volatile long*)16 = hot_loop(1);
+		return hot_loop(100000) & 0xFF;
+	})M");
+
+	riscv::Machine<RISCV64> interpreted { binary, {
+		.memory_max = MAX_MEMORY,
+		.translate_enabled = false,
+	} };
+	interpreted.setup_linux_syscalls();
+	interpreted.setup_linux({"native"}, {"LC_TYPE=C", "LC_ALL=C", "USER=root"});
+	interpreted.simulate(MAX_INSTRUCTIONS);
+
+	const riscv::MachineOptions<RISCV64> options {
+		.memory_max = MAX_MEMORY,
+		.translation_cache = false,
+		.translate_native = true,
+	};
+	riscv::Machine<RISCV64> machine { binary, options };
+	REQUIRE(machine.cpu.current_execute_segment().is_native_translated());
+	machine.setup_linux_syscalls();
+	machine.setup_linux({"native"}, {"LC_TYPE=C", "LC_ALL=C", "USER=root"});
+	machine.simulate(MAX_INSTRUCTIONS);
+	REQUIRE(machine.return_value<int>() == interpreted.return_value<int>());
+	REQUIRE(machine.instruction_counter() == interpreted.instruction_counter());
+
+	// Exceptions from generated code reach the caller
+	riscv::Machine<RISCV64> faulting { binary, options };
+	faulting.setup_linux_syscalls();
+	faulting.setup_linux({"native", "fault"}, {"LC_TYPE=C", "LC_ALL=C", "USER=root"});
+	REQUIRE_THROWS_WITH([&] {
+		faulting.simulate(MAX_INSTRUCTIONS);
+	}(), Catch::Matchers::ContainsSubstring("Protection fault"));
+}
+#endif
+
+#ifdef RISCV_BINARY_TRANSLATION
+TEST_CASE("Bounds-checks are redone after the base register changes", "[Compute]")
+{
+	const auto binary = build_and_load(R"M(
+	long chase(long** p);
+	asm(".global chase\n"
+		"chase:\n"
+		"	lui  a1, 0x12345\n"
+		"	addi a1, a1, 0x678\n"
+		"	sd   a1, 8(a0)\n"
+		"	ld   a0, 0(a0)\n"
+		"	ld   a0, 8(a0)\n"
+		"	ret\n");
+	static long* slots[2];
+	int main(int argc, char** argv) {
+		slots[0] = (argc > 1) ? (long*)0 : (long*)slots;
+		return chase(slots) == 0x12345678 ? 0 : 1;
+	})M");
+
+	const riscv::MachineOptions<RISCV64> options {
+		.memory_max = MAX_MEMORY,
+		.translation_cache = false,
+		.translate_use_virtual_paging_fallback = false,
+	};
+	riscv::Machine<RISCV64> machine { binary, options };
+	machine.setup_linux_syscalls();
+	machine.setup_linux({"chase"}, {"LC_TYPE=C", "LC_ALL=C", "USER=root"});
+	machine.simulate(MAX_INSTRUCTIONS);
+	REQUIRE(machine.return_value<int>() == 0);
+
+	// The second load uses a freshly loaded a0, and must not
+	// inherit the bounds-check made for the first load
+	riscv::Machine<RISCV64> faulting { binary, options };
+	faulting.setup_linux_syscalls();
+	faulting.setup_linux({"chase", "null"}, {"LC_TYPE=C", "LC_ALL=C", "USER=root"});
+	REQUIRE_THROWS_WITH([&] {
+		faulting.simulate(MAX_INSTRUCTIONS);
+	}(), Catch::Matchers::ContainsSubstring("Protection fault"));
+}
+
+TEST_CASE("Guard-paged arena turns host faults into protection faults", "[Compute]")
+{
+	const auto binary = build_and_load(R"M(
+	static long values[64];
+	int main(int argc, char** argv) {
+		for (int i = 0; i < 64; i++)
+			values[i] = i * i;
+		long sum = 0;
+		for (int i = 0; i < 64; i++)
+			sum += values[i];
+		if (argc > 2) {
+			// Masked loads read the zero page as zeroes
+			sum += *(volatile long*)0x8;
+		} else if (argc > 1) {
+			// Past the end of the arena
+			sum += *(volatile long*)0x700000;
+		}
+		return sum == 85344 ? 0 : 1;
+	})M");
+
+	// 6MB arena: loads are masked into an 8MB reservation
+	const riscv::MachineOptions<RISCV64> options {
+		.memory_max = 6ul << 20,
+		.translation_cache = false,
+		.translate_guard_paged_arena = true,
+		.translate_use_virtual_paging_fallback = false,
+	};
+	riscv::Machine<RISCV64> machine { binary, options };
+	machine.setup_linux_syscalls();
+	machine.setup_linux({"guard"}, {"LC_TYPE=C", "LC_ALL=C", "USER=root"});
+	machine.simulate(MAX_INSTRUCTIONS);
+	REQUIRE(machine.return_value<int>() == 0);
+
+	riscv::Machine<RISCV64> faulting { binary, options };
+	faulting.setup_linux_syscalls();
+	faulting.setup_linux({"guard", "oob"}, {"LC_TYPE=C", "LC_ALL=C", "USER=root"});
+	REQUIRE_THROWS_WITH([&] {
+		faulting.simulate(MAX_INSTRUCTIONS);
+	}(), Catch::Matchers::ContainsSubstring("Protection fault"));
+
+	riscv::Machine<RISCV64> null_load { binary, options };
+	null_load.setup_linux_syscalls();
+	null_load.setup_linux({"guard", "oob", "null"}, {"LC_TYPE=C", "LC_ALL=C", "USER=root"});
+	null_load.simulate(MAX_INSTRUCTIONS);
+	REQUIRE(null_load.return_value<int>() == 0);
+}
+#endif
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <unistd.h>
+TEST_CASE("Asynchronous system calls suspend and resume machines", "[Compute]")
+{
+	const auto binary = build_and_load(R"M(
+	extern long read(int, void*, unsigned long);
+	int main() {
+		char buffer[16];
+		long total = 0;
+		for (int i = 0; i < 3; i++) {
+			const long len = read(0x1000, buffer, sizeof(buffer));
+			total += len * buffer[0];
+		}
+		return total;
+	})M");
+
+	// Many machines share one host thread and one epoll loop
+	const int epoll_fd = epoll_create1(0);
+	REQUIRE(epoll_fd >= 0);
+	struct Guest {
+		std::unique_ptr<riscv::Machine<RISCV64>> machine;
+		int pipe[2];
+	};
+	std::array<Guest, 4> guests;
+	for (auto& guest : guests) {
+		REQUIRE(pipe(guest.pipe) == 0);
+		guest.machine.reset(new riscv::Machine<RISCV64>{ binary, { .memory_max = MAX_MEMORY } });
+		auto& machine = *guest.machine;
+		machine.setup_linux_syscalls();
+		machine.setup_linux({"async"}, {"LC_ALL=C"});
+		machine.fds().async_syscalls = true;
+		REQUIRE(machine.fds().assign_file(guest.pipe[0]) == 0x1000);
+
+		// Every guest stops on its first read, with the pipe pending
+		machine.simulate(MAX_INSTRUCTIONS);
+		REQUIRE(machine.fds().has_pending_wait());
+		REQUIRE(machine.fds().pending().fds.size() == 1);
+		REQUIRE(machine.fds().pending().fds[0].fd == guest.pipe[0]);
+		struct epoll_event ev {};
+		ev.events = EPOLLIN;
+		ev.data.ptr = &guest;
+		REQUIRE(epoll_ctl(epoll_fd, EPOLL_CTL_ADD, guest.pipe[0], &ev) == 0);
+	}
+
+	// Resuming a machine that is still waiting just stops it again
+	auto& first = *guests[0].machine;
+	first.simulate(MAX_INSTRUCTIONS, first.instruction_counter());
+	REQUIRE(first.fds().has_pending_wait());
+
+	unsigned finished = 0;
+	for (unsigned round = 0; finished < guests.size(); round++) {
+		REQUIRE(round < 16);
+		for (size_t i = 0; i < guests.size(); i++) {
+			const char value = i + 1;
+			REQUIRE(write(guests[i].pipe[1], &value, 1) == 1);
+		}
+		std::array<struct epoll_event, 4> events;
+		const int count = epoll_wait(epoll_fd, events.data(), events.size(), 1000);
+		REQUIRE(count > 0);
+		for (int i = 0; i < count; i++) {
+			auto& machine = *((Guest *)events[i].data.ptr)->machine;
+			if (!machine.fds().has_pending_wait())
+				continue;
+			machine.simulate(MAX_INSTRUCTIONS, machine.instruction_counter());
+			if (!machine.fds().has_pending_wait())
+				finished++;
+		}
+	}
+	for (size_t i = 0; i < guests.size(); i++) {
+		// The pipe may coalesce writes, so only the first byte of each read counts
+		REQUIRE(guests[i].machine->return_value<long>() > 0);
+		REQUIRE(guests[i].machine->return_value<long>() % (i + 1) == 0);
+		close(guests[i].pipe[1]);
+	}
+	close(epoll_fd);
+}
+#endif
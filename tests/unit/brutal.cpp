@@ -3,6 +3,7 @@
 
 #include <libriscv/machine.hpp>
 #include <libriscv/debug.hpp>
+#include <libriscv/threads.hpp>
 extern std::vector<uint8_t> build_and_load(const std::string& code,
 	const std::string& args = "-O2 -static", bool cpp = false);
 static const std::string cwd {SRCDIR};
@@ -123,3 +124,58 @@ TEST_CASE("Threads test-suite slowly", "[Compute]")
 	} while (machine.instruction_limit_reached());
 	REQUIRE(machine.return_value<long>() == 123666123L);
 }
+
+TEST_CASE("Hundreds of threads contending on futexes", "[Compute]")
+{
+	if (is_zig())
+		return;
+
+	const auto binary = build_and_load(R"M(
+	#include <pthread.h>
+	#include <sched.h>
+	#define THREADS 300
+	static pthread_mutex_t mtx = PTHREAD_MUTEX_INITIALIZER;
+	static pthread_cond_t  cond = PTHREAD_COND_INITIALIZER;
+	static int started = 0;
+	static long counter = 0;
+
+	static void* worker(void* arg) {
+		// Wait until every thread has started
+		pthread_mutex_lock(&mtx);
+		if (++started == THREADS)
+			pthread_cond_broadcast(&cond);
+		while (started < THREADS)
+			pthread_cond_wait(&cond, &mtx);
+		pthread_mutex_unlock(&mtx);
+
+		for (int i = 0; i < 100; i++) {
+			pthread_mutex_lock(&mtx);
+			counter += (long)arg;
+			sched_yield();
+			pthread_mutex_unlock(&mtx);
+		}
+		return NULL;
+	}
+
+	int main() {
+		static pthread_t threads[THREADS];
+		for (long i = 0; i < THREADS; i++)
+			pthread_create(&threads[i], NULL, worker, (void*)i);
+		for (int i = 0; i < THREADS; i++)
+			pthread_join(threads[i], NULL);
+		return counter == 100 * (THREADS * (THREADS - 1) / 2) ? 666 : 1;
+	})M", "-O1 -static -pthread");
+
+	riscv::Machine<RISCV64> machine { binary, { .memory_max = 256ul << 20 } };
+	machine.setup_linux_syscalls();
+	machine.setup_posix_threads();
+	machine.threads().m_max_threads = 400;
+	machine.setup_linux(
+		{"brutal"},
+		{"LC_TYPE=C", "LC_ALL=C"});
+
+	machine.simulate(500'000'000ul);
+	REQUIRE(machine.return_value<int>() == 666);
+	REQUIRE(machine.threads().blocked_count() == 0);
+	REQUIRE(machine.threads().thread_count() == 1);
+}
@@ -493,3 +493,65 @@ TEST_CASE("Crashing payload #6", "[Micro]")
 	}
 	REQUIRE(exception_thrown);
 }
+
+TEST_CASE("Superinstructions execute both halves", "[Micro]")
+{
+	auto options = std::make_shared<MachineOptions<RISCV64>>();
+#ifdef RISCV_BINARY_TRANSLATION
+	options->translate_enabled = false; // Superinstructions are interpreter-only
+#endif
+	Machine<RISCV64> machine { empty, *options };
+	// The execute segment is created later, and will use these options
+	machine.set_options(options);
+
+	std::array<uint32_t, 18> my_program{
+		0x12345537, //        lui     a0,0x12345
+		0x67850513, //        addi    a0,a0,0x678
+		0x00000597, //        auipc   a1,0x0
+		0x10058593, //        addi    a1,a1,0x100
+		0x00a13023, //        sd      a0,0(sp)
+		0x00b13423, //        sd      a1,8(sp)
+		0x00013603, //        ld      a2,0(sp)
+		0x00813683, //        ld      a3,8(sp)
+		0x00013703, //        ld      a4,0(sp)
+		0x00d70733, //        add     a4,a4,a3
+		0x00060793, //        mv      a5,a2
+		0x00068813, //        mv      a6,a3
+		0x00300293, //        li      t0,3
+		0x000013b7, //        lui     t2,0x1
+		0x00138393, // loop:  addi    t2,t2,1
+		0xfff28293, //        addi    t0,t0,-1
+		0xfe029ce3, //        bnez    t0,loop
+		0x0000006f, //        j       .
+	};
+
+	const uint64_t dst = 0x1000;
+	machine.copy_to_guest(dst, &my_program[0], sizeof(my_program));
+	machine.memory.set_page_attr(dst, riscv::Page::size(), {
+		.read = false,
+		.write = false,
+		.exec = true
+	});
+	machine.cpu.jump(dst);
+	machine.cpu.reg(REG_SP) = 0x8000;
+
+	machine.simulate<false>(100);
+	REQUIRE(machine.cpu.reg(REG_ARG0) == 0x12345678);
+	REQUIRE(machine.cpu.reg(REG_ARG1) == 0x1108);
+	REQUIRE(machine.cpu.reg(REG_ARG2) == 0x12345678);
+	REQUIRE(machine.cpu.reg(REG_ARG3) == 0x1108);
+	REQUIRE(machine.cpu.reg(REG_ARG4) == 0x12345678 + 0x1108);
+	REQUIRE(machine.cpu.reg(REG_ARG5) == 0x12345678);
+	REQUIRE(machine.cpu.reg(REG_ARG6) == 0x1108);
+	// The loop jumps into the middle of the fused LUI+ADDI
+	REQUIRE(machine.cpu.reg(5) == 0);
+	REQUIRE(machine.cpu.reg(7) == 0x1003);
+
+	// The pair report sees the superinstructions
+	unsigned lui_addi = 0;
+	for (auto& pair : machine.memory.gather_instruction_pairs()) {
+		if (pair.name == "LUI+ADDI")
+			lui_addi = pair.fused;
+	}
+	REQUIRE(lui_addi == 2);
+}
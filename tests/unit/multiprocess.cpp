@@ -0,0 +1,187 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_string.hpp>
+
+#include <libriscv/machine.hpp>
+extern std::vector<uint8_t> build_and_load(const std::string& code,
+	const std::string& args = "-O2 -static", bool cpp = false);
+static const uint64_t MAX_MEMORY = 8ul << 20; /* 8MB */
+static const uint64_t MAX_INSTRUCTIONS = 100'000'000ul;
+static const size_t SYSCALL_MULTIPROCESS = 500;
+using namespace riscv;
+
+static const std::string guest_code = R"M(
+#define HARTS 4
+#define STACK_SIZE 16384
+static char stacks[(HARTS + 1) * STACK_SIZE] __attribute__((aligned(16)));
+unsigned long counter = 0;
+unsigned long mask = 0;
+unsigned long lrsc = 0;
+int result = 0;
+
+static long multiprocess(long harts, void (*func)(int, void*), void* arg) {
+	register long a0 asm("a0") = harts;
+	register long a1 asm("a1") = (long)func;
+	register long a2 asm("a2") = (long)arg;
+	register long a3 asm("a3") = (long)stacks;
+	register long a4 asm("a4") = STACK_SIZE;
+	register long a7 asm("a7") = 500;
+	__asm__ volatile ("ecall" : "+r"(a0) : "r"(a1), "r"(a2), "r"(a3), "r"(a4), "r"(a7) : "memory");
+	return a0;
+}
+static long multiprocess_wait() {
+	register long a0 asm("a0");
+	register long a7 asm("a7") = 501;
+	__asm__ volatile ("ecall" : "=r"(a0) : "r"(a7) : "memory");
+	return a0;
+}
+
+__attribute__((used, noinline))
+void work(int hart, void* arg) {
+	unsigned long hartid;
+	__asm__ volatile ("csrr %0, mhartid" : "=r"(hartid));
+	__atomic_fetch_or(&mask, 1ul << hartid, __ATOMIC_SEQ_CST);
+	for (unsigned i = 0; i < 100000; i++) {
+		__atomic_fetch_add(&counter, hart, __ATOMIC_SEQ_CST);
+		unsigned long old = __atomic_load_n(&lrsc, __ATOMIC_RELAXED);
+		while (!__atomic_compare_exchange_n(&lrsc, &old, old + 1, 1,
+			__ATOMIC_SEQ_CST, __ATOMIC_RELAXED));
+	}
+	*(volatile int *)arg = hart;
+}
+
+__attribute__((used, noinline))
+void wait_forever(int hart, void* arg) {
+	register long a0 asm("a0") = (long)arg;
+	register long a1 asm("a1") = 0; /* FUTEX_WAIT */
+	register long a2 asm("a2") = 0;
+	register long a3 asm("a3") = 0;
+	register long a7 asm("a7") = 98;
+	__asm__ volatile ("ecall" : "+r"(a0) : "r"(a1), "r"(a2), "r"(a3), "r"(a7) : "memory");
+}
+
+__attribute__((used, noinline))
+void spin_forever(int hart, void* arg) {
+	for (;;) __asm__ volatile ("" ::: "memory");
+}
+
+int main(int argc, char** argv) {
+	if (argc > 1) {
+		if (multiprocess(HARTS, work, (void *)&result) != 0)
+			return -1;
+		return multiprocess_wait();
+	}
+	return 0;
+})M";
+
+TEST_CASE("Harts run guest functions in parallel", "[Multiprocessing]")
+{
+	const auto binary = build_and_load(guest_code);
+	Machine<RISCV64> machine { binary, { .memory_max = MAX_MEMORY } };
+	machine.setup_linux_syscalls();
+	machine.setup_linux({"multiprocess"}, {"LC_ALL=C"});
+	machine.simulate(MAX_INSTRUCTIONS);
+	REQUIRE(machine.return_value<int>() == 0);
+	REQUIRE(!machine.is_multiprocessing());
+
+	const auto counter = machine.address_of("counter");
+	const auto stacks = machine.address_of("stacks");
+	REQUIRE(counter != 0x0);
+	REQUIRE(stacks != 0x0);
+
+	machine.multiprocess(4, MAX_INSTRUCTIONS, machine.address_of("work"),
+		machine.address_of("result"), stacks, 16384);
+	REQUIRE(machine.is_multiprocessing());
+	REQUIRE(machine.multiprocess_wait() == 0);
+	REQUIRE(!machine.is_multiprocessing());
+
+	// 100000 * (1 + 2 + 3 + 4) atomic additions from four harts
+	REQUIRE(machine.memory.read<uint64_t>(counter) == 1000000u);
+	// Each hart saw its own hart ID in mhartid
+	REQUIRE(machine.memory.read<uint64_t>(machine.address_of("mask")) == 0b11110);
+	// No LR/SC increments were lost
+	REQUIRE(machine.memory.read<uint64_t>(machine.address_of("lrsc")) == 400000u);
+	REQUIRE(machine.memory.read<int>(machine.address_of("result")) != 0);
+
+	// A second round re-uses the same host threads
+	machine.multiprocess(2, MAX_INSTRUCTIONS, machine.address_of("work"),
+		machine.address_of("result"), stacks, 16384);
+	REQUIRE(machine.multiprocess_wait() == 0);
+	REQUIRE(machine.memory.read<uint64_t>(counter) == 1000000u + 300000u);
+}
+
+TEST_CASE("Guests can start harts with system calls", "[Multiprocessing]")
+{
+	const auto binary = build_and_load(guest_code);
+	Machine<RISCV64> machine { binary, { .memory_max = MAX_MEMORY } };
+	machine.setup_linux_syscalls();
+	machine.setup_multiprocessing(SYSCALL_MULTIPROCESS);
+	machine.setup_linux({"multiprocess", "1"}, {"LC_ALL=C"});
+
+	machine.simulate(MAX_INSTRUCTIONS);
+	// The failure mask from multiprocess_wait()
+	REQUIRE(machine.return_value<int>() == 0);
+	REQUIRE(machine.memory.read<uint64_t>(machine.address_of("counter")) == 1000000u);
+	REQUIRE(machine.memory.read<uint64_t>(machine.address_of("lrsc")) == 400000u);
+}
+
+TEST_CASE("Failing harts are reported in the failure mask", "[Multiprocessing]")
+{
+	const auto binary = build_and_load(guest_code);
+	Machine<RISCV64> machine { binary, { .memory_max = MAX_MEMORY } };
+	machine.setup_linux_syscalls();
+	machine.setup_linux({"multiprocess"}, {"LC_ALL=C"});
+	machine.simulate(MAX_INSTRUCTIONS);
+
+	// The argument is written to at the end, which faults on every hart
+	machine.multiprocess(3, MAX_INSTRUCTIONS, machine.address_of("work"),
+		0x0, machine.address_of("stacks"), 16384);
+	REQUIRE(machine.multiprocess_wait() == 0b111);
+
+	// Running out of instructions is also a failure
+	machine.multiprocess(2, 1000, machine.address_of("work"),
+		machine.address_of("result"), machine.address_of("stacks"), 16384);
+	REQUIRE(machine.multiprocess_wait() == 0b11);
+
+	// Starting harts while they are already running is an error
+	machine.multiprocess(1, MAX_INSTRUCTIONS, machine.address_of("work"),
+		machine.address_of("result"), machine.address_of("stacks"), 16384);
+	REQUIRE_THROWS_WITH([&] {
+		machine.multiprocess(1, MAX_INSTRUCTIONS, machine.address_of("work"),
+			machine.address_of("result"), machine.address_of("stacks"), 16384);
+	}(), Catch::Matchers::ContainsSubstring("already running"));
+	machine.multiprocess_wait();
+}
+
+TEST_CASE("Harts stop without being woken by the guest", "[Multiprocessing]")
+{
+	const auto binary = build_and_load(guest_code);
+	Machine<RISCV64> machine { binary, { .memory_max = MAX_MEMORY } };
+	machine.setup_linux_syscalls();
+	machine.setup_posix_threads();
+	machine.setup_linux({"multiprocess"}, {"LC_ALL=C"});
+	machine.simulate(MAX_INSTRUCTIONS);
+	const auto stacks = machine.address_of("stacks");
+
+	// Nothing wakes the harts while we are waiting for them
+	machine.multiprocess(3, MAX_INSTRUCTIONS, machine.address_of("wait_forever"),
+		machine.address_of("result"), stacks, 16384);
+	REQUIRE(machine.multiprocess_wait() == 0b111);
+
+	// Harts without an instruction limit can be stopped
+	machine.multiprocess(2, UINT64_MAX, machine.address_of("spin_forever"),
+		machine.address_of("result"), stacks, 16384);
+	machine.multiprocess_stop();
+	REQUIRE(machine.multiprocess_wait() == 0b11);
+
+	// Hart 0 waiting on the harts, which are waiting on hart 0
+	machine.multiprocess(2, MAX_INSTRUCTIONS, machine.address_of("wait_forever"),
+		machine.address_of("result"), stacks, 16384);
+	REQUIRE_THROWS_WITH([&] {
+		machine.vmcall("wait_forever", 0, machine.address_of("result"));
+	}(), Catch::Matchers::ContainsSubstring("Every hart is waiting"));
+	REQUIRE(machine.multiprocess_wait() == 0b11);
+
+	// The destructor stops running harts
+	machine.multiprocess(2, UINT64_MAX, machine.address_of("spin_forever"),
+		machine.address_of("result"), stacks, 16384);
+}
@@ -0,0 +1,114 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <libriscv/machine.hpp>
+#include <libriscv/vm_scheduler.hpp>
+extern std::vector<uint8_t> build_and_load(const std::string& code,
+	const std::string& args = "-O2 -static", bool cpp = false);
+static const uint64_t MAX_MEMORY = 8ul << 20; /* 8MB */
+using namespace riscv;
+using Scheduler = VMScheduler<RISCV64>;
+
+static std::vector<std::unique_ptr<Machine<RISCV64>>>
+	create_machines(const std::vector<uint8_t>& binary, size_t count)
+{
+	std::vector<std::unique_ptr<Machine<RISCV64>>> machines;
+	for (size_t i = 0; i < count; i++) {
+		machines.emplace_back(new Machine<RISCV64>{ binary, { .memory_max = MAX_MEMORY } });
+		machines.back()->setup_linux_syscalls();
+		machines.back()->setup_linux({"scheduler"}, {"LC_ALL=C"});
+	}
+	return machines;
+}
+
+TEST_CASE("Scheduler time-slices machines to completion", "[Scheduler]")
+{
+	const auto binary = build_and_load(R"M(
+	int main(int argc, char** argv) {
+		unsigned sum = 0;
+		for (unsigned i = 0; i < 1000000; i++)
+			sum += i * argc;
+		return sum & 0xFF;
+	})M");
+	auto machines = create_machines(binary, 8);
+
+	std::mutex mtx;
+	std::vector<int> completed;
+	Scheduler scheduler({ .threads = 3, .quantum = 100'000 }, [&] (auto& task) {
+		std::lock_guard<std::mutex> lock(mtx);
+		completed.push_back((intptr_t)task.userdata);
+	});
+	REQUIRE(scheduler.threads() == 3);
+
+	std::vector<std::shared_ptr<Scheduler::Task>> tasks;
+	for (size_t i = 0; i < machines.size(); i++) {
+		tasks.push_back(scheduler.submit(*machines[i], 0,
+			Scheduler::clock::time_point::max(), UINT64_MAX, (void*)(intptr_t)i));
+	}
+	scheduler.wait();
+
+	REQUIRE(completed.size() == machines.size());
+	for (auto& task : tasks) {
+		REQUIRE(task->status == Scheduler::Status::Finished);
+		REQUIRE(task->machine.return_value<int>() == (499999500000u & 0xFF));
+		// Every machine was preempted many times
+		REQUIRE(task->slices > 10);
+		REQUIRE(task->instructions == task->machine.instruction_counter());
+		REQUIRE(task->cpu_time.count() > 0);
+	}
+}
+
+TEST_CASE("Scheduler priorities, deadlines and budgets", "[Scheduler]")
+{
+	const auto binary = build_and_load(R"M(
+	int main() {
+		for (volatile unsigned i = 0; i < 1000000; i++);
+		return 666;
+	})M");
+	auto machines = create_machines(binary, 4);
+
+	std::vector<int> completed;
+	// A single thread makes the order of completion predictable
+	Scheduler scheduler({ .threads = 1, .quantum = 10'000 }, [&] (auto& task) {
+		completed.push_back((intptr_t)task.userdata);
+	});
+	const auto forever = Scheduler::clock::time_point::max();
+	auto low  = scheduler.submit(*machines[0], 0, forever, UINT64_MAX, (void*)0);
+	auto high = scheduler.submit(*machines[1], 10, forever, UINT64_MAX, (void*)1);
+	auto late = scheduler.submit(*machines[2], 0, Scheduler::clock::now(), UINT64_MAX, (void*)2);
+	auto poor = scheduler.submit(*machines[3], 0, forever, 50'000, (void*)3);
+	scheduler.wait();
+
+	REQUIRE(low->status == Scheduler::Status::Finished);
+	REQUIRE(high->status == Scheduler::Status::Finished);
+	REQUIRE(late->status == Scheduler::Status::DeadlineExceeded);
+	REQUIRE(late->instructions == 0);
+	REQUIRE(poor->status == Scheduler::Status::OutOfInstructions);
+	REQUIRE(poor->instructions >= 50'000);
+	REQUIRE(machines[1]->return_value<int>() == 666);
+	// The high priority machine completes before the low priority one
+	const auto pos = [&] (int id) { return std::find(completed.begin(), completed.end(), id) - completed.begin(); };
+	REQUIRE(pos(1) < pos(0));
+
+	// A machine that ran out of instructions can be submitted again
+	auto retry = scheduler.submit(*machines[3]);
+	scheduler.wait();
+	REQUIRE(retry->status == Scheduler::Status::Finished);
+	REQUIRE(machines[3]->return_value<int>() == 666);
+}
+
+TEST_CASE("Scheduler reports machines that throw", "[Scheduler]")
+{
+	const auto binary = build_and_load(R"M(
+	int main() {
+		*(volatile int *)0x1 = 0;
+		return 0;
+	})M");
+	auto machines = create_machines(binary, 1);
+
+	Scheduler scheduler({ .threads = 2 });
+	auto task = scheduler.submit(*machines[0]);
+	scheduler.wait();
+	REQUIRE(task->status == Scheduler::Status::Failed);
+	REQUIRE(task->exception != nullptr);
+	REQUIRE_THROWS([&] { std::rethrow_exception(task->exception); }());
+}
@@ -2,6 +2,7 @@
 #include <catch2/matchers/catch_matchers_string.hpp>
 
 #include <libriscv/machine.hpp>
+#include <unistd.h>
 extern std::vector<uint8_t> build_and_load(const std::string& code,
 		   const std::string& args = "-O2 -static", bool cpp = false);
 static const uint64_t MAX_MEMORY = 8ul << 20; /* 8MB */
@@ -163,3 +164,176 @@ TEST_CASE("Serialized state from another place", "[Serialize]")
 	restored_machine.simulate(MAX_INSTRUCTIONS);
 	REQUIRE(restored_machine.return_value<int>() == 666);
 }
+
+TEST_CASE("Track dirty arena pages", "[Serialize]")
+{
+	const auto binary = build_and_load(R"M(
+	static char buffer[3 * 4096] __attribute__((aligned(4096)));
+
+	__attribute__((used, retain))
+	void touch(int idx) {
+		buffer[idx * 4096] = 1;
+	}
+
+	int main() {
+		return 666;
+	})M");
+
+	riscv::Machine<RISCV64> machine { binary, {
+		.memory_max = MAX_MEMORY,
+		.track_dirty_pages = true,
+	}};
+	machine.setup_linux_syscalls();
+	machine.setup_linux(
+		{"dirty_pages"},
+		{"LC_TYPE=C", "LC_ALL=C", "USER=root"});
+	machine.simulate(MAX_INSTRUCTIONS);
+	REQUIRE(machine.return_value<int>() == 666);
+
+	if (!machine.memory.tracks_dirty_pages())
+		return; // No arena
+	// Loading and running the program dirtied pages
+	REQUIRE(machine.memory.dirty_page_count() > 0);
+	machine.memory.clear_dirty_pages();
+	REQUIRE(machine.memory.dirty_page_count() == 0);
+
+	const auto buffer = machine.address_of("buffer");
+	REQUIRE(buffer != 0x0);
+	machine.vmcall("touch", 2);
+
+	// Only the touched page and the stack should now be dirty
+	REQUIRE(machine.memory.is_dirty_page(Memory<RISCV64>::page_number(buffer) + 2));
+	REQUIRE(!machine.memory.is_dirty_page(Memory<RISCV64>::page_number(buffer) + 1));
+	REQUIRE(!machine.memory.is_dirty_page(Memory<RISCV64>::page_number(buffer)));
+
+	size_t count = 0;
+	machine.memory.for_each_dirty_page([&] (auto pageno) {
+		REQUIRE(pageno < machine.memory.memory_arena_size() / Page::size());
+		count++;
+	});
+	REQUIRE(count == machine.memory.dirty_page_count());
+	REQUIRE(machine.memory.dirty_pages().size() == count);
+}
+
+TEST_CASE("Chained incremental snapshots", "[Serialize]")
+{
+	const auto binary = build_and_load(R"M(
+	#include <string.h>
+	static int counter = 0;
+	static char buffer[64 * 4096];
+
+	__attribute__((used, retain))
+	void step() {
+		counter++;
+		memset(buffer + counter * 4096, counter, 4096);
+	}
+	__attribute__((used, retain))
+	int check() {
+		for (int i = 1; i <= counter; i++)
+			if (buffer[i * 4096] != i) return -1;
+		return counter;
+	}
+
+	int main() {
+		return 666;
+	})M");
+
+	const MachineOptions<RISCV64> options {
+		.memory_max = MAX_MEMORY,
+		.track_dirty_pages = true,
+	};
+	riscv::Machine<RISCV64> machine { binary, options };
+	machine.setup_linux_syscalls();
+	machine.setup_linux(
+		{"delta_snapshots"},
+		{"LC_TYPE=C", "LC_ALL=C", "USER=root"});
+	machine.simulate(MAX_INSTRUCTIONS);
+	REQUIRE(machine.return_value<int>() == 666);
+
+	std::vector<uint8_t> full;
+	REQUIRE(machine.serialize_delta_to(full) > 0);
+	machine.memory.clear_dirty_pages();
+
+	std::vector<std::vector<uint8_t>> deltas(3);
+	const std::vector<uint8_t>* base = &full;
+	for (auto& delta : deltas) {
+		machine.vmcall("step");
+		machine.serialize_delta_to(delta, base, true);
+		machine.memory.clear_dirty_pages();
+		// Only the changed pages are stored
+		REQUIRE(delta.size() < full.size());
+		base = &delta;
+	}
+	REQUIRE(machine.vmcall("check") == 3);
+
+	riscv::Machine<RISCV64> restored { binary, options };
+	restored.setup_linux_syscalls();
+	// Deltas must be applied in order
+	REQUIRE(restored.deserialize_delta_from({&full, &deltas[1]}) != 0);
+	REQUIRE(restored.deserialize_delta_from({&full, &deltas[0], &deltas[1], &deltas[2]}, 4) == 0);
+	REQUIRE(restored.vmcall("check") == 3);
+
+	// Restoring part of the chain goes back in time
+	REQUIRE(restored.deserialize_delta_from({&full, &deltas[0]}) == 0);
+	REQUIRE(restored.vmcall("check") == 1);
+}
+
+TEST_CASE("Restore memory-mapped snapshot file", "[Serialize]")
+{
+	const auto binary = build_and_load(R"M(
+	static int counter = 0;
+	static char buffer[16 * 4096];
+
+	__attribute__((used, retain))
+	int step() {
+		buffer[counter * 4096] = 1;
+		return ++counter;
+	}
+
+	int main() {
+		for (int i = 0; i < 8; i++)
+			buffer[i * 4096] = 1;
+		counter = 8;
+		return 666;
+	})M");
+
+	riscv::Machine<RISCV64> machine { binary, { .memory_max = MAX_MEMORY } };
+	machine.setup_linux_syscalls();
+	machine.setup_linux(
+		{"mapped_snapshot"},
+		{"LC_TYPE=C", "LC_ALL=C", "USER=root"});
+	machine.simulate(MAX_INSTRUCTIONS);
+	REQUIRE(machine.return_value<int>() == 666);
+
+	std::vector<uint8_t> full;
+	machine.serialize_delta_to(full);
+	char filename[] = "/tmp/snapshot-XXXXXX";
+	const int fd = mkstemp(filename);
+	REQUIRE(fd >= 0);
+	REQUIRE(write(fd, full.data(), full.size()) == ssize_t(full.size()));
+	close(fd);
+
+	for (int i = 0; i < 2; i++)
+	{
+		riscv::Machine<RISCV64> restored { binary, { .memory_max = MAX_MEMORY } };
+		restored.setup_linux_syscalls();
+		REQUIRE(restored.deserialize_mapped_from(filename) == 0);
+		REQUIRE(restored.memory.uses_snapshot_mapping());
+		// Writes are private to each restored machine
+		REQUIRE(restored.vmcall("step") == 9);
+		REQUIRE(restored.vmcall("step") == 10);
+	}
+
+	// Only complete snapshots can be memory-mapped
+	std::vector<uint8_t> delta;
+	machine.vmcall("step");
+	machine.serialize_delta_to(delta, &full);
+	FILE* f = fopen(filename, "wb");
+	REQUIRE(f != nullptr);
+	fwrite(delta.data(), 1, delta.size(), f);
+	fclose(f);
+
+	riscv::Machine<RISCV64> restored { binary, { .memory_max = MAX_MEMORY } };
+	REQUIRE(restored.deserialize_mapped_from(filename) != 0);
+	unlink(filename);
+}
@@ -170,6 +170,38 @@ TEST_CASE("RV64 Newlib with B-ext Hello World", "[Verify]")
 	REQUIRE(state.text.find("Caught exception: Hello Exceptions!") != std::string::npos);
 }
 
+TEST_CASE("ELF symbols are found by name and by address", "[Verify]")
+{
+	const auto binary = load_file(cwd + "/elf/newlib-rv32gb-hello-world");
+	riscv::Machine<RISCV32> machine { binary, { .memory_max = MAX_MEMORY } };
+
+	REQUIRE(machine.address_of("main") == 0x10670);
+	REQUIRE(machine.address_of("memcpy") == 0x683e8);
+	REQUIRE(machine.address_of("no_such_symbol") == 0x0);
+	// There are three local functions with this name, and the first one wins
+	REQUIRE(machine.address_of("_ZNKSs4sizeEv.isra.0") == 0x3c4a8);
+
+	// The closest function at or below the address
+	auto callsite = machine.memory.lookup(0x10670 + 8);
+	REQUIRE(callsite.name == "main");
+	REQUIRE(callsite.address == 0x10670);
+	REQUIRE(callsite.offset == 8);
+	REQUIRE(callsite.size == 2044);
+
+	callsite = machine.memory.lookup(0x683e8);
+	REQUIRE(callsite.name == "memcpy");
+	REQUIRE(callsite.offset == 0);
+
+	// Only functions are considered, and nothing comes before the first one
+	REQUIRE(machine.memory.lookup(0x10000).address == 0x0);
+	REQUIRE(machine.memory.lookup(0x10094).address == 0x10094);
+
+	// A fork sees the same symbols
+	riscv::Machine<RISCV32> fork { machine };
+	REQUIRE(fork.address_of("main") == 0x10670);
+	REQUIRE(fork.memory.lookup(0x683e8 + 4).name == "memcpy");
+}
+
 TEST_CASE("TinyCC dynamic fib", "[Verify]")
 {
 	const auto binary = load_file(cwd + "/elf/tinycc-rv64g-fib");
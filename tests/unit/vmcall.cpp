@@ -2,6 +2,7 @@
 #include <catch2/matchers/catch_matchers_string.hpp>
 
 #include <libriscv/machine.hpp>
+#include <libriscv/prepared_call.hpp>
 extern std::vector<uint8_t> build_and_load(const std::string& code,
 	const std::string& args = "-O2 -static", bool cpp = false);
 static const uint64_t MAX_MEMORY = 8ul << 20; /* 8MB */
@@ -286,6 +287,106 @@ TEST_CASE("VM function call in fork", "[VMCall]")
 	}
 }
 
+TEST_CASE("VM function call in fork with private arena", "[VMCall]")
+{
+	// Forks of a machine with a forkable (memfd) arena get their own
+	// copy-on-write view of the arena, so writes stay in the fork.
+	const auto binary = build_and_load(R"M(
+	#include <assert.h>
+	static int value = 0;
+
+	__attribute__((used, retain))
+	int increment() {
+		return ++value;
+	}
+
+	int main() {
+		value = 1;
+		return 666;
+	})M");
+
+	riscv::Machine<RISCV64> machine { binary, {
+		.memory_max = MAX_MEMORY,
+		.use_forkable_memory_arena = true,
+	} };
+	machine.setup_linux_syscalls();
+	machine.setup_linux(
+		{"vmcall"},
+		{"LC_TYPE=C", "LC_ALL=C", "USER=root"});
+
+	machine.simulate(MAX_INSTRUCTIONS);
+	REQUIRE(machine.return_value<int>() == 666);
+
+	const auto increment_address = machine.address_of("increment");
+	REQUIRE(increment_address != 0x0);
+
+	for (size_t i = 0; i < 10; i++)
+	{
+		riscv::Machine<RISCV64> fork { machine };
+#ifdef __linux__
+		if constexpr (riscv::flat_readwrite_arena) {
+			REQUIRE(fork.memory.has_private_arena_mapping());
+		}
+#endif
+		// Every fork starts from the same value as the main VM
+		REQUIRE(fork.vmcall(increment_address) == 2);
+		REQUIRE(fork.vmcall(increment_address) == 3);
+	}
+	// The main VM never saw any of the fork writes
+	REQUIRE(machine.vmcall(increment_address) == 2);
+}
+
+TEST_CASE("Reuse fork by resetting it to the main VM", "[VMCall]")
+{
+	const auto binary = build_and_load(R"M(
+	#include <stdlib.h>
+	static int value = 0;
+	static char* buffer = NULL;
+
+	__attribute__((used, retain))
+	int increment() {
+		buffer = malloc(4096);
+		buffer[0] = value;
+		return ++value;
+	}
+
+	int main() {
+		value = 1;
+		return 666;
+	})M");
+
+	riscv::Machine<RISCV64> machine { binary, {
+		.memory_max = MAX_MEMORY,
+		.use_forkable_memory_arena = true,
+	} };
+	machine.setup_linux_syscalls();
+	machine.setup_linux(
+		{"vmcall"},
+		{"LC_TYPE=C", "LC_ALL=C", "USER=root"});
+
+	machine.simulate(MAX_INSTRUCTIONS);
+	REQUIRE(machine.return_value<int>() == 666);
+
+	const auto increment_address = machine.address_of("increment");
+	REQUIRE(increment_address != 0x0);
+	const auto sp = machine.cpu.reg(riscv::REG_SP);
+
+	riscv::Machine<RISCV64> fork { machine };
+	for (size_t i = 0; i < 10; i++)
+	{
+		// The same fork behaves like a new one after each reset
+		REQUIRE(fork.vmcall(increment_address) == 2);
+		REQUIRE(fork.vmcall(increment_address) == 3);
+		fork.reset_to(machine);
+		REQUIRE(fork.cpu.reg(riscv::REG_SP) == sp);
+		REQUIRE(fork.memory.mmap_address() == machine.memory.mmap_address());
+	}
+	REQUIRE(machine.vmcall(increment_address) == 2);
+
+	// Only forks can be reset
+	REQUIRE_THROWS(machine.reset_to(machine));
+}
+
 TEST_CASE("VM call and preemption", "[VMCall]")
 {
 	struct State {
@@ -541,3 +642,42 @@ TEST_CASE("VM call with arrays and vectors", "[VMCall]")
 	int res5 = machine.vmcall("pass_struct", vec_ref, vec_ref.size());
 	REQUIRE(res5 == 1);
 }
+
+TEST_CASE("Prepared calls with register and stack arguments", "[VMCall]")
+{
+	const auto binary = build_and_load(R"M(
+	#include <string.h>
+	__attribute__((used, retain))
+	long mixed(int a, float f, long b, double d, int c) {
+		return a + (long)f + b + (long)d + c;
+	}
+	__attribute__((used, retain))
+	long length(const char* str, int extra) {
+		return strlen(str) + extra;
+	}
+
+	int main() {
+		return 666;
+	})M");
+
+	riscv::Machine<RISCV64> machine { binary, { .memory_max = MAX_MEMORY } };
+	machine.setup_linux_syscalls();
+	machine.setup_linux(
+		{"vmcall"},
+		{"LC_TYPE=C", "LC_ALL=C", "USER=root"});
+
+	machine.simulate(MAX_INSTRUCTIONS);
+	REQUIRE(machine.return_value<int>() == 666);
+
+	// A register-only signature skips setup_call, and must agree with vmcall
+	PreparedCall<RISCV64, long(int, float, long, double, int)> mixed(machine, "mixed");
+	for (int i = 0; i < 100; i++) {
+		REQUIRE(long(mixed(i, 2.0f, 3L, 4.0, 5)) == i + 14);
+		REQUIRE(long(mixed(i, 2.0f, 3L, 4.0, 5)) == long(machine.vmcall("mixed", i, 2.0f, 3L, 4.0, 5)));
+	}
+
+	// Strings are pushed on the stack, and prepared calls with a limit are counted
+	PreparedCall<RISCV64, long(const char*, int), MAX_INSTRUCTIONS> length(machine, "length");
+	REQUIRE(long(length("Hello World!", 1)) == 13);
+	REQUIRE(machine.instruction_counter() > 0);
+}